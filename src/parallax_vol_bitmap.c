@@ -0,0 +1,310 @@
+#include "parallax_vol_bitmap.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+/*Whether the bitmaps are unknown, the number of elements of the tile and of the bins that follow*/
+#define PARH5B_HEADER_SIZE (3 * sizeof(uint32_t))
+#define PARH5B_UNKNOWN 1U
+/**
+ * WAH words: a literal word holds the next 31 bits of the bitmap, a fill
+ * word (top bit set) a run of groups of 31 bits that are all zero, or all
+ * one if its second bit is set, with the number of groups in the other 30.
+ */
+#define PARH5B_GROUP_BITS 31U
+#define PARH5B_LITERAL_MASK ((1U << PARH5B_GROUP_BITS) - 1)
+#define PARH5B_FILL_WORD (1U << 31)
+#define PARH5B_FILL_ONES (1U << 30)
+#define PARH5B_MAX_RUN (PARH5B_FILL_ONES - 1)
+#define PARH5B_BITSET_WORDS(NUM_BITS) (((NUM_BITS) + 63) / 64)
+
+struct parh5B_index {
+	enum parh5S_elem_type elem_type;
+	double lower;
+	double upper;
+	double scale; /*maps the distance of an element from lower to its bin*/
+	uint32_t num_bins; /*in [lower, upper], bin 0 is below and bin num_bins + 1 above*/
+};
+
+static inline uint32_t parh5B_bin_of(const struct parh5B_index *index, double elem)
+{
+	if (elem < index->lower)
+		return 0;
+	if (elem > index->upper)
+		return index->num_bins + 1;
+	uint32_t bin = (elem - index->lower) * index->scale;
+	return 1 + (bin < index->num_bins ? bin : index->num_bins - 1);
+}
+
+typedef double (*parh5B_get_fn)(const char *elem);
+typedef void (*parh5B_bin_fn)(const struct parh5B_index *index, const char *tile_buf, uint32_t num_elems,
+			      uint64_t *bitsets);
+
+/*Bins the elements of a tile into a bitset per bin, each of PARH5B_BITSET_WORDS(num_elems) words*/
+#define PARH5B_DEFINE_TYPE(TYPE, SUFFIX)                                                                    \
+	static double parh5B_get_##SUFFIX(const char *elem)                                                 \
+	{                                                                                                   \
+		TYPE value;                                                                                 \
+		memcpy(&value, elem, sizeof(value));                                                        \
+		return (double)value;                                                                       \
+	}                                                                                                   \
+	static void parh5B_bin_##SUFFIX(const struct parh5B_index *index, const char *tile_buf,             \
+					uint32_t num_elems, uint64_t *bitsets)                              \
+	{                                                                                                   \
+		uint32_t bitset_words = PARH5B_BITSET_WORDS(num_elems);                                     \
+		for (uint32_t i = 0; i < num_elems; i++) {                                                  \
+			double elem = parh5B_get_##SUFFIX(&tile_buf[i * sizeof(TYPE)]);                     \
+			if (isnan(elem))                                                                    \
+				continue;                                                                   \
+			bitsets[parh5B_bin_of(index, elem) * bitset_words + i / 64] |= 1UL << (i % 64);     \
+		}                                                                                           \
+	}
+
+PARH5B_DEFINE_TYPE(int8_t, int8)
+PARH5B_DEFINE_TYPE(uint8_t, uint8)
+PARH5B_DEFINE_TYPE(int16_t, int16)
+PARH5B_DEFINE_TYPE(uint16_t, uint16)
+PARH5B_DEFINE_TYPE(int32_t, int32)
+PARH5B_DEFINE_TYPE(uint32_t, uint32)
+PARH5B_DEFINE_TYPE(int64_t, int64)
+PARH5B_DEFINE_TYPE(uint64_t, uint64)
+PARH5B_DEFINE_TYPE(float, float)
+PARH5B_DEFINE_TYPE(double, double)
+
+static const parh5B_get_fn parh5B_get_fns[] = {
+	[PARH5S_INT8] = parh5B_get_int8,     [PARH5S_UINT8] = parh5B_get_uint8,	  [PARH5S_INT16] = parh5B_get_int16,
+	[PARH5S_UINT16] = parh5B_get_uint16, [PARH5S_INT32] = parh5B_get_int32,	  [PARH5S_UINT32] = parh5B_get_uint32,
+	[PARH5S_INT64] = parh5B_get_int64,   [PARH5S_UINT64] = parh5B_get_uint64, [PARH5S_FLOAT] = parh5B_get_float,
+	[PARH5S_DOUBLE] = parh5B_get_double,
+};
+
+static const parh5B_bin_fn parh5B_bin_fns[] = {
+	[PARH5S_INT8] = parh5B_bin_int8,     [PARH5S_UINT8] = parh5B_bin_uint8,	  [PARH5S_INT16] = parh5B_bin_int16,
+	[PARH5S_UINT16] = parh5B_bin_uint16, [PARH5S_INT32] = parh5B_bin_int32,	  [PARH5S_UINT32] = parh5B_bin_uint32,
+	[PARH5S_INT64] = parh5B_bin_int64,   [PARH5S_UINT64] = parh5B_bin_uint64, [PARH5S_FLOAT] = parh5B_bin_float,
+	[PARH5S_DOUBLE] = parh5B_bin_double,
+};
+
+parh5B_index_t parh5B_create_index(enum parh5S_elem_type elem_type, double lower, double upper, uint32_t num_bins)
+{
+	if (PARH5S_NONE == elem_type || elem_type > PARH5S_DOUBLE)
+		return NULL;
+	parh5B_index_t index = calloc(1UL, sizeof(*index));
+	index->elem_type = elem_type;
+	index->lower = lower;
+	index->upper = upper;
+	/*An empty range has a single value, it is the only bin*/
+	index->num_bins = num_bins && upper > lower ? num_bins : 1;
+	index->scale = upper > lower ? index->num_bins / (upper - lower) : 0;
+	return index;
+}
+
+void parh5B_destroy_index(parh5B_index_t index)
+{
+	free(index);
+}
+
+double parh5B_get_elem(enum parh5S_elem_type elem_type, const char *elem)
+{
+	return parh5B_get_fns[elem_type](elem);
+}
+
+/**
+ * @brief Returns the group of 31 bits of a bitset of num_bits bits that
+ * starts at first_bit, the bits past num_bits are zero.
+ */
+static uint32_t parh5B_get_group(const uint64_t *bitset, uint32_t num_bits, uint32_t first_bit)
+{
+	uint32_t word = first_bit / 64;
+	uint32_t shift = first_bit % 64;
+	uint64_t group = bitset[word] >> shift;
+	if (shift + PARH5B_GROUP_BITS > 64 && word + 1 < PARH5B_BITSET_WORDS(num_bits))
+		group |= bitset[word + 1] << (64 - shift);
+	return group & PARH5B_LITERAL_MASK;
+}
+
+/**
+ * @brief WAH compresses a bitset into words, which has room for a word per
+ * group of 31 bits.
+ * @return the number of words
+ */
+static uint32_t parh5B_wah_encode(const uint64_t *bitset, uint32_t num_bits, uint32_t *words)
+{
+	uint32_t num_words = 0;
+	for (uint32_t first_bit = 0; first_bit < num_bits; first_bit += PARH5B_GROUP_BITS) {
+		uint32_t group = parh5B_get_group(bitset, num_bits, first_bit);
+		bool whole = num_bits - first_bit >= PARH5B_GROUP_BITS;
+		uint32_t fill = 0;
+		if (0 == group)
+			fill = PARH5B_FILL_WORD;
+		else if (whole && PARH5B_LITERAL_MASK == group)
+			fill = PARH5B_FILL_WORD | PARH5B_FILL_ONES;
+		if (0 == fill) {
+			words[num_words++] = group;
+			continue;
+		}
+		uint32_t *last = num_words ? &words[num_words - 1] : NULL;
+		if (last && (*last & ~PARH5B_MAX_RUN) == fill && (*last & PARH5B_MAX_RUN) < PARH5B_MAX_RUN)
+			(*last)++;
+		else
+			words[num_words++] = fill | 1;
+	}
+	return num_words;
+}
+
+/**
+ * @brief Sets in bitset the bits a WAH compressed bitmap sets. Words that
+ * run past num_bits, which only a corrupted bitmap has, are cut short.
+ */
+static void parh5B_wah_decode(const char *words, uint32_t num_words, uint32_t num_bits, uint64_t *bitset)
+{
+	uint64_t first_bit = 0;
+	for (uint32_t i = 0; i < num_words && first_bit < num_bits; i++) {
+		uint32_t word;
+		memcpy(&word, &words[i * sizeof(word)], sizeof(word));
+		if (!(word & PARH5B_FILL_WORD)) {
+			for (; word; word &= word - 1) {
+				uint64_t bit = first_bit + __builtin_ctz(word);
+				if (bit < num_bits)
+					bitset[bit / 64] |= 1UL << (bit % 64);
+			}
+			first_bit += PARH5B_GROUP_BITS;
+			continue;
+		}
+		uint64_t end_bit = first_bit + (uint64_t)(word & PARH5B_MAX_RUN) * PARH5B_GROUP_BITS;
+		for (uint64_t bit = first_bit; (word & PARH5B_FILL_ONES) && bit < end_bit && bit < num_bits; bit++)
+			bitset[bit / 64] |= 1UL << (bit % 64);
+		first_bit = end_bit;
+	}
+}
+
+char *parh5B_encode_tile(parh5B_index_t index, const char *tile_buf, uint32_t num_elems, uint32_t *value_size)
+{
+	uint32_t total_bins = index->num_bins + 2;
+	uint32_t bitset_words = PARH5B_BITSET_WORDS(num_elems);
+	uint64_t *bitsets = calloc((size_t)total_bins * bitset_words, sizeof(*bitsets));
+	parh5B_bin_fns[index->elem_type](index, tile_buf, num_elems, bitsets);
+
+	uint32_t max_words = (num_elems + PARH5B_GROUP_BITS - 1) / PARH5B_GROUP_BITS;
+	uint32_t *words = malloc(max_words * sizeof(*words) + 1UL);
+	uint32_t num_present = 0;
+	for (uint32_t bin = 0; bin < total_bins; bin++) {
+		for (uint32_t i = 0; i < bitset_words; i++) {
+			if (bitsets[bin * bitset_words + i]) {
+				num_present++;
+				break;
+			}
+		}
+	}
+	/*Every bitmap is at most a word per group*/
+	char *value = malloc(PARH5B_HEADER_SIZE + num_present * (2 * sizeof(uint32_t) + max_words * sizeof(*words)));
+	uint32_t header[] = { 0, num_elems, num_present };
+	memcpy(value, header, sizeof(header));
+	uint32_t idx = PARH5B_HEADER_SIZE;
+	for (uint32_t bin = 0; num_present && bin < total_bins; bin++) {
+		uint32_t num_words = parh5B_wah_encode(&bitsets[bin * bitset_words], num_elems, words);
+		/*A bin without elements is a single fill word of zeros*/
+		if (1 == num_words && PARH5B_FILL_WORD == (words[0] & ~PARH5B_MAX_RUN))
+			continue;
+		memcpy(&value[idx], &bin, sizeof(bin));
+		memcpy(&value[idx + sizeof(bin)], &num_words, sizeof(num_words));
+		idx += 2 * sizeof(uint32_t);
+		memcpy(&value[idx], words, num_words * sizeof(*words));
+		idx += num_words * sizeof(*words);
+	}
+	free(words);
+	free(bitsets);
+	*value_size = idx;
+	return value;
+}
+
+char *parh5B_encode_unknown(uint32_t *value_size)
+{
+	uint32_t header[] = { PARH5B_UNKNOWN, 0, 0 };
+	char *value = malloc(sizeof(header));
+	memcpy(value, header, sizeof(header));
+	*value_size = sizeof(header);
+	return value;
+}
+
+/**
+ * @brief Returns the next bitmap of a value, its bin and WAH words.
+ * @param [in,out] pos where the bitmap starts, then where the next one does
+ * @return false past the last bitmap or if the value is cut short
+ */
+static bool parh5B_next_bitmap(const char *value, uint32_t value_size, uint32_t *pos, uint32_t *bin,
+			       uint32_t *num_words, const char **words)
+{
+	if (*pos + 2 * sizeof(uint32_t) > value_size)
+		return false;
+	memcpy(bin, &value[*pos], sizeof(*bin));
+	memcpy(num_words, &value[*pos + sizeof(*bin)], sizeof(*num_words));
+	*pos += 2 * sizeof(uint32_t);
+	if (*num_words > (value_size - *pos) / sizeof(uint32_t))
+		return false;
+	*words = &value[*pos];
+	*pos += *num_words * sizeof(uint32_t);
+	return true;
+}
+
+/**
+ * @brief Returns false if the bitmaps of a value are unknown, or do not
+ * describe a tile of num_elems elements.
+ */
+static bool parh5B_check_value(const char *value, uint32_t value_size, uint32_t num_elems)
+{
+	uint32_t header[3];
+	if (value_size < PARH5B_HEADER_SIZE)
+		return false;
+	memcpy(header, value, sizeof(header));
+	return !(header[0] & PARH5B_UNKNOWN) && header[1] == num_elems;
+}
+
+bool parh5B_tile_may_match(parh5B_index_t index, const char *value, uint32_t value_size, double lower,
+			   double upper)
+{
+	uint32_t header[3] = { PARH5B_UNKNOWN };
+	if (value_size >= PARH5B_HEADER_SIZE)
+		memcpy(header, value, sizeof(header));
+	if (header[0] & PARH5B_UNKNOWN)
+		return true;
+	if (!(lower <= upper))
+		return false;
+	uint32_t first_bin = parh5B_bin_of(index, lower);
+	uint32_t last_bin = parh5B_bin_of(index, upper);
+	uint32_t pos = PARH5B_HEADER_SIZE;
+	uint32_t bin = 0;
+	uint32_t num_words = 0;
+	const char *words = NULL;
+	while (parh5B_next_bitmap(value, value_size, &pos, &bin, &num_words, &words)) {
+		if (bin >= first_bin && bin <= last_bin)
+			return true;
+	}
+	return false;
+}
+
+bool parh5B_match_tile(parh5B_index_t index, const char *value, uint32_t value_size, double lower, double upper,
+		       bool bins_exact, uint32_t num_elems, uint64_t *hits, uint64_t *candidates)
+{
+	if (!parh5B_check_value(value, value_size, num_elems))
+		return false;
+	if (!(lower <= upper))
+		return true;
+	/**
+	 * Bins are monotone in the elements: the elements of a bin between the
+	 * ones of lower and upper are in range, the ones of the bins outside are
+	 * not, the ones of the bins of lower and upper may be.
+	 */
+	uint32_t first_bin = parh5B_bin_of(index, lower);
+	uint32_t last_bin = parh5B_bin_of(index, upper);
+	uint32_t pos = PARH5B_HEADER_SIZE;
+	uint32_t bin = 0;
+	uint32_t num_words = 0;
+	const char *words = NULL;
+	while (parh5B_next_bitmap(value, value_size, &pos, &bin, &num_words, &words)) {
+		if (bin < first_bin || bin > last_bin)
+			continue;
+		bool hit = bins_exact && bin > first_bin && bin < last_bin;
+		parh5B_wah_decode(words, num_words, num_elems, hit ? hits : candidates);
+	}
+	return true;
+}
@@ -0,0 +1,62 @@
+#ifndef PARALLAX_VOL_BITMAP_H
+#define PARALLAX_VOL_BITMAP_H
+#include "parallax_vol_zone_map.h"
+#include <stdbool.h>
+#include <stdint.h>
+typedef struct parh5B_index *parh5B_index_t;
+
+/**
+ * @brief Creates the bins of a bitmap index: num_bins bins of equal width
+ * that split [lower, upper], the last one includes upper, and two more for
+ * the elements below lower and above upper. NaNs fall in no bin.
+ * @param [in] elem_type the type of the elements the index bins
+ */
+parh5B_index_t parh5B_create_index(enum parh5S_elem_type elem_type, double lower, double upper, uint32_t num_bins);
+
+/**
+ * @brief Frees the index, index may be NULL.
+ */
+void parh5B_destroy_index(parh5B_index_t index);
+
+/**
+ * @brief Builds the bitmaps of a tile: for every bin that holds elements of
+ * the tile, a WAH compressed bitmap with a bit per element of the tile,
+ * set for the elements in the bin.
+ * @param [out] value_size the size of the returned value
+ * @return the bitmaps as one value, free() it
+ */
+char *parh5B_encode_tile(parh5B_index_t index, const char *tile_buf, uint32_t num_elems, uint32_t *value_size);
+
+/**
+ * @brief Returns the value of a tile whose bitmaps are unknown, e.g. one
+ * that got delta records, free() it. Queries test all its elements.
+ */
+char *parh5B_encode_unknown(uint32_t *value_size);
+
+/**
+ * @brief Returns false if no element of the tile whose bitmaps value holds
+ * is in [lower, upper], true if some may be. It only reads the bin ids.
+ */
+bool parh5B_tile_may_match(parh5B_index_t index, const char *value, uint32_t value_size, double lower,
+			   double upper);
+
+/**
+ * @brief Sets in hits the bits of the elements of a tile that are in
+ * [lower, upper] and in candidates the bits of the ones that may be: the
+ * elements of the bins that hold lower or upper, whose values have to be
+ * tested. Both have a bit per element of the tile, the caller zeroes them.
+ * @param [in] bins_exact false if the bins describe the elements only
+ * approximately, e.g. lossy tiles, then all elements of the bins that
+ * overlap the range are candidates
+ * @param [in] num_elems the number of elements of the tile
+ * @return false if the bitmaps of the tile are unknown, then every element
+ * is a candidate and the bitsets are left alone
+ */
+bool parh5B_match_tile(parh5B_index_t index, const char *value, uint32_t value_size, double lower, double upper,
+		       bool bins_exact, uint32_t num_elems, uint64_t *hits, uint64_t *candidates);
+
+/**
+ * @brief Returns the element elem, of type elem_type, as a double.
+ */
+double parh5B_get_elem(enum parh5S_elem_type elem_type, const char *elem);
+#endif
@@ -25,6 +25,7 @@
 #include "parallax_vol_links.h"
 #include "parallax_vol_metrics.h"
 #include "parallax_vol_object.h"
+#include "parallax_vol_request.h"
 #include <H5PLextern.h>
 #include <assert.h>
 #include <bits/pthreadtypes.h>
@@ -78,12 +79,14 @@ herr_t parh5_initialize(hid_t vipl_id)
 		log_debug("Formatted volume: %s SUCCESSFULLY", parh5_volume);
 	}
 
+	parh5D_register_optional_ops();
 	log_debug("Initialized parallax plugin using Parallax volume: %s", parh5_volume);
 	return PARH5_SUCCESS;
 }
 
 herr_t parh5_terminate(void)
 {
+	parh5D_unregister_optional_ops();
 	free(connector);
 	connector = NULL;
 	log_debug("Closed parallax plugin");
@@ -102,7 +105,7 @@ static const H5VL_class_t parallax_class_g = {
 	PARALLAX_VOL_CONNECTOR_VALUE, /* value                    */
 	PARALLAX_VOL_CONNECTOR_NAME, /* name                     */
 	0, /* version                  */
-	0, /* capability flags         */
+	H5VL_CAP_FLAG_ASYNC, /* capability flags         */
 	parh5_initialize, /* initialize               */
 	parh5_terminate, /* terminate                */
 	{
@@ -196,12 +199,12 @@ static const H5VL_class_t parallax_class_g = {
 	},
 	{
 		/* request_cls */
-		NULL, /* wait         */
-		NULL, /* notify       */
-		NULL, /* cancel       */
+		parh5R_wait, /* wait         */
+		parh5R_notify, /* notify       */
+		parh5R_cancel, /* cancel       */
 		NULL, /* specific     */
 		NULL, /* optional     */
-		NULL /* free         */
+		parh5R_free /* free         */
 	},
 	{
 		/* blob_cls */
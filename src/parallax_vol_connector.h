@@ -35,6 +35,148 @@
 #define PARH5_USE_FILE_LOCKING "use_file_locking"
 #define PARH5_IGNORE_DISABLED_FILE_LOCKS "ignore_disabled_file_locks"
 
+/**
+ * Order of the tiles of a dataset in Parallax's key space. Applications pick
+ * it at creation time by inserting this property (an int holding a
+ * parh5_tile_order value) in the dataset creation property list.
+ */
+#define PARH5_TILE_ORDER "parh5_tile_order"
+enum parh5_tile_order { PARH5_TILE_ORDER_ROW_MAJOR = 0, PARH5_TILE_ORDER_MORTON };
+
+/**
+ * Turns on delta updates for a dataset. Writes that cover part of a tile
+ * that is not cached are stored as small delta records without reading the
+ * tile, reads merge the records over the tile. The property (an unsigned int
+ * in the dataset creation property list) is the number of delta records a
+ * tile accumulates before a read folds them back into it, 0 turns delta
+ * updates off.
+ */
+#define PARH5_DELTA_UPDATES "parh5_delta_updates"
+
+/**
+ * Stores the tiles of a float or double dataset lossy: every element reads
+ * back within this absolute error of the value written, and smooth data
+ * takes a fraction of the space. The property (a double in the dataset
+ * creation property list) is the error bound, 0 keeps tiles exact. It is
+ * ignored for datasets of other types. A tile that is read, partly
+ * overwritten and stored again is quantized anew, its untouched elements
+ * from the values read.
+ */
+#define PARH5_LOSSY_ERROR_BOUND "parh5_lossy_error_bound"
+
+/**
+ * Keeps a zone map, the minimum, maximum, sum and NaN count of its
+ * elements, for every stored tile of a dataset of native integers or floats,
+ * so that range queries (see PARH5_QUERY_TILES_OP) skip tiles and
+ * aggregations (see PARH5_AGGREGATE_OP) reduce them without reading them.
+ * Applications turn it on at creation time by inserting this property (an
+ * unsigned int, nonzero turns it on) in the dataset creation property list.
+ */
+#define PARH5_ZONE_MAPS "parh5_zone_maps"
+
+/**
+ * Keeps a bitmap value index for every stored tile of a dataset of native
+ * integers or floats: its elements are binned into num_bins bins of equal
+ * width over [lower, upper], plus a bin below and one above, and every bin
+ * that holds elements of the tile gets a WAH compressed bitmap of them.
+ * Element queries (see PARH5_QUERY_ELEMENTS_OP) read only the tiles whose
+ * bitmaps may match, and test only the elements of the bins the bounds of
+ * the query fall in. Applications turn it on at creation time by inserting
+ * this property (a struct parh5_bitmap_index) in the dataset creation
+ * property list.
+ */
+#define PARH5_BITMAP_INDEX "parh5_bitmap_index"
+struct parh5_bitmap_index {
+	double lower;
+	double upper; /*inclusive, the last bin ends at it*/
+	uint32_t num_bins; /*0 turns the index off*/
+};
+
+/**
+ * Dataset optional operation that lists the tiles of a dataset that may
+ * hold values in [lower, upper]. Applications look its op_type up with
+ * H5VLfind_opt_operation(H5VL_SUBCLS_DATASET, PARH5_QUERY_TILES_OP, ...) and
+ * run it with H5VLdataset_optional_op, with a struct
+ * parh5_query_tiles_args as the args of the operation. Tiles whose zone map
+ * excludes the range are left out; every tile is listed for datasets without
+ * zone maps. Reading the listed tiles and testing their elements gives the
+ * exact answer.
+ */
+#define PARH5_QUERY_TILES_OP "parallax_vol_connector.query_tiles"
+struct parh5_query_tiles_args {
+	double lower; /*in*/
+	double upper; /*in, inclusive*/
+	size_t num_tiles; /*out*/
+	hsize_t *tile_starts; /*out, the coordinates of the first element of each tile, rank per tile, free() it*/
+	hsize_t tile_dims[H5S_MAX_RANK]; /*out, the shape of the tiles, edge tiles end at the dataset bounds*/
+};
+
+/**
+ * Dataset optional operation that reduces the elements of a hyperslab of a
+ * dataset of native integers or floats to their count, sum, minimum,
+ * maximum, mean and, optionally, histogram, without reading them into the
+ * application. It is looked up and run like PARH5_QUERY_TILES_OP, with a
+ * struct parh5_aggregate_args as the args of the operation. The tiles of
+ * the hyperslab stream through the reduction one at a time; tiles the
+ * hyperslab covers whole are reduced from their zone map, where the
+ * dataset keeps one, without reading them. Elements are reduced as
+ * doubles, NaNs are counted apart and left out of the rest.
+ */
+#define PARH5_AGGREGATE_OP "parallax_vol_connector.aggregate"
+struct parh5_aggregate_args {
+	hid_t file_space_id; /*in, the selection to reduce, a hyperslab or H5S_ALL*/
+	double hist_lower; /*in, the range the histogram bins split evenly*/
+	double hist_upper; /*in, inclusive, elements outside the range fall in no bin*/
+	size_t num_bins; /*in, 0 for no histogram*/
+	uint64_t *histogram; /*in, num_bins counters the elements of each bin are added to*/
+	uint64_t count; /*out, the selected elements that are not NaN*/
+	uint64_t null_count; /*out, the selected NaN elements*/
+	double sum; /*out*/
+	double min; /*out, NaN if count is 0, as are max and mean*/
+	double max; /*out*/
+	double mean; /*out*/
+};
+
+/**
+ * Dataset optional operation that finds the elements of a dataset of native
+ * integers or floats that are in [lower, upper]. It is looked up and run
+ * like PARH5_QUERY_TILES_OP, with a struct parh5_query_elements_args as the
+ * args of the operation. It returns the coordinates of the matching
+ * elements, in tile order and row-major within a tile, and optionally their
+ * values. Datasets with a bitmap index (see PARH5_BITMAP_INDEX) answer it
+ * from their bitmaps and the tiles they point to, datasets without one
+ * test every stored tile.
+ */
+#define PARH5_QUERY_ELEMENTS_OP "parallax_vol_connector.query_elements"
+struct parh5_query_elements_args {
+	double lower; /*in*/
+	double upper; /*in, inclusive*/
+	unsigned int read_values; /*in, nonzero returns the values of the matching elements too*/
+	size_t num_elems; /*out*/
+	hsize_t *coords; /*out, the coordinates of each matching element, rank per element, free() it*/
+	void *values; /*out, in the type of the dataset, NULL unless read_values, free() it*/
+};
+
+/**
+ * Number of threads the reads and writes of a file spread their tiles over,
+ * the application thread included. Applications set it by inserting this
+ * property (an unsigned int) in the file access property list, or through
+ * the PARH5_TRANSFER_THREADS environment variable. The property takes
+ * precedence, transfers stay on the application thread if neither is set.
+ */
+#define PARH5_TRANSFER_THREADS "parh5_transfer_threads"
+#define PARALLAX_TRANSFER_THREADS_ENV_VAR "PARH5_TRANSFER_THREADS"
+
+/**
+ * Lets writes return before the tiles they evicted are stored. A write
+ * hands the dirty tiles it evicts to the put stage of the tile cache and by
+ * default waits for their puts; with this property (an unsigned int,
+ * nonzero turns it on) in the data transfer property list it returns as
+ * soon as the last tile is assembled. Flush and close still wait for all
+ * puts.
+ */
+#define PARH5_BUFFERED_WRITES "parh5_buffered_writes"
+
 #define METRICS_ENABLE
 
 // typedef enum { PARH5_FILE = 1, PARH5_GROUP = 2, PARH5_DATASET = 3 } parh5_object_e;
@@ -0,0 +1,202 @@
+#include "parallax_vol_convert.h"
+#include <H5Ppublic.h>
+#include <H5Tpublic.h>
+#include <log.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+/*H5Tconvert works in place, elements are converted in batches of this many through a scratch buffer*/
+#define PARH5C_BATCH_ELEMS 4096UL
+
+typedef void (*parh5C_kernel)(const char *src, char *dst, size_t num_elems);
+
+struct parh5C_converter {
+	hid_t src_type_id;
+	hid_t dst_type_id;
+	size_t src_size;
+	size_t dst_size;
+	parh5C_kernel kernel; /*NULL for the pairs H5Tconvert handles*/
+	char *conv_buf; /*H5Tconvert scratch, a batch of the larger of the two types*/
+	char *bkg_buf; /*compound destinations, the fields the source does not have*/
+};
+
+/*The loops below are simple enough for the compiler to vectorize*/
+
+static void parh5C_int32_to_int64(const char *src, char *dst, size_t num_elems)
+{
+	const int32_t *restrict in = (const int32_t *)src;
+	int64_t *restrict out = (int64_t *)dst;
+	for (size_t i = 0; i < num_elems; i++)
+		out[i] = in[i];
+}
+
+static void parh5C_int64_to_int32(const char *src, char *dst, size_t num_elems)
+{
+	const int64_t *restrict in = (const int64_t *)src;
+	int32_t *restrict out = (int32_t *)dst;
+	/*Out of range values saturate like the HDF5 conversions do by default*/
+	for (size_t i = 0; i < num_elems; i++)
+		out[i] = in[i] > INT32_MAX ? INT32_MAX : in[i] < INT32_MIN ? INT32_MIN : (int32_t)in[i];
+}
+
+static void parh5C_float_to_double(const char *src, char *dst, size_t num_elems)
+{
+	const float *restrict in = (const float *)src;
+	double *restrict out = (double *)dst;
+	for (size_t i = 0; i < num_elems; i++)
+		out[i] = in[i];
+}
+
+static void parh5C_double_to_float(const char *src, char *dst, size_t num_elems)
+{
+	const double *restrict in = (const double *)src;
+	float *restrict out = (float *)dst;
+	for (size_t i = 0; i < num_elems; i++)
+		out[i] = (float)in[i];
+}
+
+static void parh5C_swap16(const char *src, char *dst, size_t num_elems)
+{
+	const uint16_t *restrict in = (const uint16_t *)src;
+	uint16_t *restrict out = (uint16_t *)dst;
+	for (size_t i = 0; i < num_elems; i++)
+		out[i] = __builtin_bswap16(in[i]);
+}
+
+static void parh5C_swap32(const char *src, char *dst, size_t num_elems)
+{
+	const uint32_t *restrict in = (const uint32_t *)src;
+	uint32_t *restrict out = (uint32_t *)dst;
+	for (size_t i = 0; i < num_elems; i++)
+		out[i] = __builtin_bswap32(in[i]);
+}
+
+static void parh5C_swap64(const char *src, char *dst, size_t num_elems)
+{
+	const uint64_t *restrict in = (const uint64_t *)src;
+	uint64_t *restrict out = (uint64_t *)dst;
+	for (size_t i = 0; i < num_elems; i++)
+		out[i] = __builtin_bswap64(in[i]);
+}
+
+/**
+ * @brief Returns the byte swap kernel if the two types are the same integer
+ * or floating point type in opposite byte orders.
+ */
+static parh5C_kernel parh5C_find_swap_kernel(hid_t src_type_id, hid_t dst_type_id)
+{
+	H5T_class_t class_id = H5Tget_class(src_type_id);
+	if ((H5T_INTEGER != class_id && H5T_FLOAT != class_id) || class_id != H5Tget_class(dst_type_id))
+		return NULL;
+	H5T_order_t dst_order = H5Tget_order(dst_type_id);
+	if (H5Tget_order(src_type_id) == dst_order || (H5T_ORDER_LE != dst_order && H5T_ORDER_BE != dst_order))
+		return NULL;
+
+	hid_t swapped_type_id = H5Tcopy(src_type_id);
+	H5Tset_order(swapped_type_id, dst_order);
+	bool swap_only = H5Tequal(swapped_type_id, dst_type_id) > 0;
+	H5Tclose(swapped_type_id);
+	if (!swap_only)
+		return NULL;
+
+	switch (H5Tget_size(src_type_id)) {
+	case sizeof(uint16_t):
+		return parh5C_swap16;
+	case sizeof(uint32_t):
+		return parh5C_swap32;
+	case sizeof(uint64_t):
+		return parh5C_swap64;
+	default:
+		return NULL;
+	}
+}
+
+static parh5C_kernel parh5C_find_kernel(hid_t src_type_id, hid_t dst_type_id)
+{
+	struct {
+		hid_t src_type_id;
+		hid_t dst_type_id;
+		parh5C_kernel kernel;
+	} kernels[] = { { H5T_NATIVE_INT32, H5T_NATIVE_INT64, parh5C_int32_to_int64 },
+			{ H5T_NATIVE_INT64, H5T_NATIVE_INT32, parh5C_int64_to_int32 },
+			{ H5T_NATIVE_FLOAT, H5T_NATIVE_DOUBLE, parh5C_float_to_double },
+			{ H5T_NATIVE_DOUBLE, H5T_NATIVE_FLOAT, parh5C_double_to_float } };
+
+	for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+		if (H5Tequal(src_type_id, kernels[i].src_type_id) > 0 && H5Tequal(dst_type_id, kernels[i].dst_type_id) > 0)
+			return kernels[i].kernel;
+	}
+	return parh5C_find_swap_kernel(src_type_id, dst_type_id);
+}
+
+parh5C_converter_t parh5C_create_converter(hid_t src_type_id, hid_t dst_type_id)
+{
+	H5T_cdata_t *cdata = NULL;
+	if (NULL == H5Tfind(src_type_id, dst_type_id, &cdata)) {
+		log_warn("No conversion path between the datatypes");
+		return NULL;
+	}
+
+	parh5C_converter_t conv = calloc(1UL, sizeof(*conv));
+	conv->src_type_id = H5Tcopy(src_type_id);
+	conv->dst_type_id = H5Tcopy(dst_type_id);
+	conv->src_size = H5Tget_size(src_type_id);
+	conv->dst_size = H5Tget_size(dst_type_id);
+	conv->kernel = parh5C_find_kernel(src_type_id, dst_type_id);
+	if (NULL == conv->kernel) {
+		size_t max_size = conv->src_size > conv->dst_size ? conv->src_size : conv->dst_size;
+		conv->conv_buf = calloc(PARH5C_BATCH_ELEMS, max_size);
+		if (H5T_COMPOUND == H5Tget_class(dst_type_id))
+			conv->bkg_buf = calloc(PARH5C_BATCH_ELEMS, conv->dst_size);
+	}
+	return conv;
+}
+
+void parh5C_convert(parh5C_converter_t conv, const char *src, char *dst, size_t num_elems)
+{
+	if (conv->kernel) {
+		conv->kernel(src, dst, num_elems);
+		return;
+	}
+
+	for (size_t done = 0; done < num_elems; done += PARH5C_BATCH_ELEMS) {
+		size_t batch = num_elems - done < PARH5C_BATCH_ELEMS ? num_elems - done : PARH5C_BATCH_ELEMS;
+		memcpy(conv->conv_buf, &src[done * conv->src_size], batch * conv->src_size);
+		if (conv->bkg_buf)
+			memcpy(conv->bkg_buf, &dst[done * conv->dst_size], batch * conv->dst_size);
+		if (H5Tconvert(conv->src_type_id, conv->dst_type_id, batch, conv->conv_buf, conv->bkg_buf, H5P_DEFAULT) <
+		    0) {
+			log_fatal("Failed to convert %lu elements", batch);
+			_exit(EXIT_FAILURE);
+		}
+		memcpy(&dst[done * conv->dst_size], conv->conv_buf, batch * conv->dst_size);
+	}
+}
+
+bool parh5C_is_thread_safe(parh5C_converter_t conv)
+{
+	return NULL != conv->kernel;
+}
+
+size_t parh5C_get_src_size(parh5C_converter_t conv)
+{
+	return conv->src_size;
+}
+
+size_t parh5C_get_dst_size(parh5C_converter_t conv)
+{
+	return conv->dst_size;
+}
+
+void parh5C_destroy_converter(parh5C_converter_t conv)
+{
+	if (NULL == conv)
+		return;
+	H5Tclose(conv->src_type_id);
+	H5Tclose(conv->dst_type_id);
+	free(conv->conv_buf);
+	free(conv->bkg_buf);
+	free(conv);
+}
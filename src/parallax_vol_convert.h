@@ -0,0 +1,41 @@
+#ifndef PARALLAX_VOL_CONVERT_H
+#define PARALLAX_VOL_CONVERT_H
+#include <H5Ipublic.h>
+#include <stdbool.h>
+#include <stddef.h>
+typedef struct parh5C_converter *parh5C_converter_t;
+
+/**
+ * @brief Creates a converter from one datatype to another. The common
+ * numeric pairs (int32 and int64, float and double, both ways) and byte
+ * order swaps of integers and floats have loops of their own, every other
+ * pair goes through H5Tconvert in batches.
+ * @param [in] src_type_id the type of the elements to convert
+ * @param [in] dst_type_id the type to convert them to
+ * @return the converter, NULL if HDF5 cannot convert between the types
+ */
+parh5C_converter_t parh5C_create_converter(hid_t src_type_id, hid_t dst_type_id);
+
+/**
+ * @brief Converts num_elems consecutive elements of src into dst. The
+ * buffers must not overlap.
+ */
+void parh5C_convert(parh5C_converter_t conv, const char *src, char *dst, size_t num_elems);
+
+/**
+ * @brief Returns true if several threads may convert with conv at the same
+ * time. The loops of the common pairs may, H5Tconvert calls go through the
+ * HDF5 library and a shared scratch buffer and stay on the application
+ * thread.
+ */
+bool parh5C_is_thread_safe(parh5C_converter_t conv);
+
+size_t parh5C_get_src_size(parh5C_converter_t conv);
+
+size_t parh5C_get_dst_size(parh5C_converter_t conv);
+
+/**
+ * @brief Frees the converter, conv may be NULL.
+ */
+void parh5C_destroy_converter(parh5C_converter_t conv);
+#endif
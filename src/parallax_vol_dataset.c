@@ -3,14 +3,20 @@
 #include "H5Spublic.h"
 #include "H5Tpublic.h"
 #include "H5public.h"
+#include "parallax_vol_bitmap.h"
 #include "parallax_vol_connector.h"
+#include "parallax_vol_convert.h"
 #include "parallax_vol_file.h"
+#include "parallax_vol_filter.h"
 #include "parallax_vol_group.h"
 #include "parallax_vol_inode.h"
 #include "parallax_vol_tile_cache.h"
+#include "parallax_vol_transfer.h"
+#include "parallax_vol_zone_map.h"
 #include <H5Spublic.h>
 #include <assert.h>
 #include <log.h>
+#include <math.h>
 #include <parallax/parallax.h>
 #include <signal.h>
 #include <stdint.h>
@@ -22,9 +28,13 @@
 #include "parallax_vol_metrics.h"
 #endif
 
-#define PARH5D_MAX_DIMENSIONS 5
 #define PARH5D_CONTIGUOUS_TILE_SIZE 1024
-#define PARH5D_CHUNKED_TILE_SIZE 64
+#define PARH5D_TILE_ID_BITS 64
+/*Tiles a zone map scan collects room for at first*/
+#define PARH5D_MIN_QUERY_TILES 64UL
+/*Elements an element query returns room for at first*/
+#define PARH5D_MIN_QUERY_ELEMS 1024UL
+#define PARH5D_MIN(X, Y) ((X) < (Y) ? (X) : (Y))
 
 #define PARH5D_PAR_CHECK_ERROR(X)                                 \
 	if (X) {                                                  \
@@ -38,8 +48,23 @@ struct parh5D_dataset {
 	parh5F_file_t file; /*Where does this dataset belongs*/
 	hid_t space_id; /*info about the space*/
 	hid_t type_id; /*info about its schema*/
+	uint32_t elem_size; /*the size of type_id, set once so transfers do not ask HDF5 per element*/
 	hid_t dcpl_id; /*dataset creation property list*/
 	uint32_t tile_size_in_elems;
+	uint32_t tile_rank; /*0 until the tile shape is set*/
+	uint32_t tile_order; /*enum parh5_tile_order*/
+	uint32_t delta_threshold; /*0 if partial writes rewrite the whole tile*/
+	double error_bound; /*of the lossy tiles of float datasets, 0 if tiles are exact*/
+	uint32_t zone_maps; /*nonzero if stored tiles keep a zone map, see PARH5_ZONE_MAPS*/
+	enum parh5S_elem_type zone_type; /*of the zone maps, PARH5S_NONE without them*/
+	struct parh5_bitmap_index bitmap; /*the bins of the bitmap index, see PARH5_BITMAP_INDEX*/
+	parh5B_index_t bitmap_index; /*NULL if the dataset keeps no bitmap index*/
+	hsize_t tile_dims[PARH5D_MAX_DIMENSIONS]; /*the shape of each tile*/
+	hsize_t dims[PARH5D_MAX_DIMENSIONS]; /*the shape of the dataset*/
+	hsize_t tiles_per_dim[PARH5D_MAX_DIMENSIONS];
+	struct parh5X_plans *plans; /*NULL until the first transfer that can be planned*/
+	char *fill_tile; /*a tile of fill values, NULL if the fill value is zero*/
+	parh5Z_pipeline_t pipeline; /*the lossy codec and the filters of the dcpl, NULL if it has neither*/
 	/**
 	 * Parallax handles datasets that applications request to store them
 	 * contiguous in the following manner
@@ -48,22 +73,87 @@ struct parh5D_dataset {
 };
 
 /**
- * @brief Returns tile metadata to access a storage element.
- * @param dataset [in] pointer to the dataset object
- * @param storage_elem_id id of the storage element
- * @return a parh5D_tile object
+ * @brief Splits the row-major id of a dataset element into its coordinates.
  */
-static struct parh5T_tile parh5D_map_id2tile(parh5D_dataset_t dataset, hsize_t storage_elem_id)
+static inline void parh5D_id2coords(parh5D_dataset_t dataset, hsize_t storage_elem_id, hsize_t coords[])
 {
-	struct parh5T_tile tile_uuid = {
-		.uuid.dset_id = parh5I_get_inode_num(dataset->inode),
-		// .uuid.tile_id = storage_elem_id - (storage_elem_id % dataset->tile_size_in_elems),
-		.uuid.tile_id = storage_elem_id / dataset->tile_size_in_elems,
-		.offt_in_tile = (storage_elem_id % dataset->tile_size_in_elems) * H5Tget_size(dataset->type_id)
-	};
+	for (int dim = dataset->tile_rank - 1; dim >= 0; dim--) {
+		coords[dim] = storage_elem_id % dataset->dims[dim];
+		storage_elem_id /= dataset->dims[dim];
+	}
+}
+
+uint64_t parh5D_get_tile_id(parh5D_dataset_t dataset, const hsize_t tile_coords[])
+{
+	uint64_t tile_id = 0;
+	if (PARH5_TILE_ORDER_MORTON == dataset->tile_order) {
+		uint32_t rank = dataset->tile_rank;
+		for (uint32_t bit = 0; bit < PARH5D_TILE_ID_BITS / rank; bit++) {
+			for (uint32_t dim = 0; dim < rank; dim++)
+				tile_id |= ((tile_coords[dim] >> bit) & 1UL) << (bit * rank + rank - 1 - dim);
+		}
+		return tile_id;
+	}
+	for (uint32_t dim = 0; dim < dataset->tile_rank; dim++)
+		tile_id = tile_id * dataset->tiles_per_dim[dim] + tile_coords[dim];
+	return tile_id;
+}
+
+void parh5D_get_tile_coords(parh5D_dataset_t dataset, uint64_t tile_id, hsize_t tile_coords[])
+{
+	uint32_t rank = dataset->tile_rank;
+	if (PARH5_TILE_ORDER_MORTON == dataset->tile_order) {
+		for (uint32_t dim = 0; dim < rank; dim++)
+			tile_coords[dim] = 0;
+		for (uint32_t bit = 0; bit < PARH5D_TILE_ID_BITS / rank; bit++) {
+			for (uint32_t dim = 0; dim < rank; dim++)
+				tile_coords[dim] |= ((tile_id >> (bit * rank + rank - 1 - dim)) & 1UL) << bit;
+		}
+		return;
+	}
+	for (int dim = rank - 1; dim >= 0; dim--) {
+		tile_coords[dim] = tile_id % dataset->tiles_per_dim[dim];
+		tile_id /= dataset->tiles_per_dim[dim];
+	}
+}
+
+struct parh5T_tile parh5D_map_id2tile(parh5D_dataset_t dataset, hsize_t storage_elem_id)
+{
+	hsize_t coords[PARH5D_MAX_DIMENSIONS];
+	parh5D_id2coords(dataset, storage_elem_id, coords);
+
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS];
+	uint64_t offt_in_tile = 0;
+	for (uint32_t dim = 0; dim < dataset->tile_rank; dim++) {
+		tile_coords[dim] = coords[dim] / dataset->tile_dims[dim];
+		offt_in_tile = offt_in_tile * dataset->tile_dims[dim] + coords[dim] % dataset->tile_dims[dim];
+	}
+
+	struct parh5T_tile tile_uuid = { .uuid.dset_id = parh5I_get_inode_num(dataset->inode),
+					 .uuid.tile_id = parh5D_get_tile_id(dataset, tile_coords),
+					 .offt_in_tile = offt_in_tile * dataset->elem_size };
 	return tile_uuid;
 }
 
+hsize_t parh5D_get_tile_run_len(parh5D_dataset_t dataset, hsize_t storage_elem_id)
+{
+	hsize_t coords[PARH5D_MAX_DIMENSIONS];
+	parh5D_id2coords(dataset, storage_elem_id, coords);
+
+	hsize_t run_len = 0;
+	hsize_t inner_elems = 1;
+	for (int dim = dataset->tile_rank - 1; dim >= 0; dim--) {
+		hsize_t tile_left = dataset->tile_dims[dim] - coords[dim] % dataset->tile_dims[dim];
+		hsize_t dim_left = dataset->dims[dim] - coords[dim];
+		run_len = (tile_left < dim_left ? tile_left : dim_left) * inner_elems;
+		/*The run goes on to the next dimension only when the tile spans this one exactly*/
+		if (coords[dim] || dataset->tile_dims[dim] != dataset->dims[dim])
+			break;
+		inner_elems *= dataset->dims[dim];
+	}
+	return run_len;
+}
+
 /**
  * @brief Calculates the final coordinates of an element id
  * @param [in] elem_id The id of the element in the memory buffer
@@ -102,35 +192,6 @@ static struct parh5T_tile parh5D_map_id2tile(parh5D_dataset_t dataset, hsize_t s
 // 	return true;
 // }
 
-/**
- * @brief Given a cell in a multi dimensional array returns its elem id
- * in 1D projection.
- * @param [in] coords array with the elements coordinates
- * @param [in] shape  array dimensions
- * @param [in] ndims number of dimensions
- * @return >=0 in case of SUCCESS otherwise -1 on failure
- */
-static inline hsize_t parh5D_get_id_from_coords(hsize_t coords[], hsize_t shape[], int ndims)
-{
-	if (0 == ndims)
-		return -1;
-
-	int index = 0;
-	int stride = 1;
-
-	for (int i = ndims - 1; i >= 0; i--) {
-		index += coords[i] * stride;
-		stride *= shape[i];
-	}
-
-	// for (int i = 0; i < ndims; i++)
-	// 	fprintf(stderr, "storage_coord[%d] = %ld ", i, coords[i]);
-	// fprintf(stderr, "\n");
-	// fprintf(stderr, "Element id (in 1D) = %d\n", index);
-
-	return index;
-}
-
 #define PAR5HD_BUFFER_CHECK_REMAINING(X, Y)                           \
 	if (X < Y) {                                                  \
 		log_fatal("Sorry need to resize inode XXX TODO XXX"); \
@@ -178,6 +239,39 @@ static bool parh5D_store_dataset(parh5D_dataset_t dset)
 	}
 	idx += space_needed;
 	remaining_bytes -= space_needed;
+	//Finally the tile shape
+	space_needed = sizeof(dset->tile_rank) + sizeof(dset->tile_order) + dset->tile_rank * sizeof(hsize_t);
+	PAR5HD_BUFFER_CHECK_REMAINING(remaining_bytes, space_needed);
+	memcpy(&buffer[idx], &dset->tile_rank, sizeof(dset->tile_rank));
+	memcpy(&buffer[idx + sizeof(dset->tile_rank)], &dset->tile_order, sizeof(dset->tile_order));
+	memcpy(&buffer[idx + sizeof(dset->tile_rank) + sizeof(dset->tile_order)], dset->tile_dims,
+	       dset->tile_rank * sizeof(hsize_t));
+	idx += space_needed;
+	remaining_bytes -= space_needed;
+	//and whether partial writes are stored as delta records
+	PAR5HD_BUFFER_CHECK_REMAINING(remaining_bytes, sizeof(dset->delta_threshold));
+	memcpy(&buffer[idx], &dset->delta_threshold, sizeof(dset->delta_threshold));
+	idx += sizeof(dset->delta_threshold);
+	remaining_bytes -= sizeof(dset->delta_threshold);
+	//and the error bound of lossy tiles
+	PAR5HD_BUFFER_CHECK_REMAINING(remaining_bytes, sizeof(dset->error_bound));
+	memcpy(&buffer[idx], &dset->error_bound, sizeof(dset->error_bound));
+	idx += sizeof(dset->error_bound);
+	remaining_bytes -= sizeof(dset->error_bound);
+	//and whether tiles keep zone maps
+	PAR5HD_BUFFER_CHECK_REMAINING(remaining_bytes, sizeof(dset->zone_maps));
+	memcpy(&buffer[idx], &dset->zone_maps, sizeof(dset->zone_maps));
+	idx += sizeof(dset->zone_maps);
+	remaining_bytes -= sizeof(dset->zone_maps);
+	//and the bins of the bitmap index
+	space_needed = sizeof(dset->bitmap.lower) + sizeof(dset->bitmap.upper) + sizeof(dset->bitmap.num_bins);
+	PAR5HD_BUFFER_CHECK_REMAINING(remaining_bytes, space_needed);
+	memcpy(&buffer[idx], &dset->bitmap.lower, sizeof(dset->bitmap.lower));
+	memcpy(&buffer[idx + sizeof(dset->bitmap.lower)], &dset->bitmap.upper, sizeof(dset->bitmap.upper));
+	memcpy(&buffer[idx + sizeof(dset->bitmap.lower) + sizeof(dset->bitmap.upper)], &dset->bitmap.num_bins,
+	       sizeof(dset->bitmap.num_bins));
+	idx += space_needed;
+	remaining_bytes -= space_needed;
 	parh5I_store_inode(dset->inode, parh5F_get_parallax_db(dset->file));
 #ifdef METRICS_ENABLE
 	parh5M_inc_dset_metadata_bytes_written(dset, parh5I_get_inode_size());
@@ -210,12 +304,44 @@ static void parh5D_deserialize_dataset(parh5D_dataset_t dataset)
 		log_fatal("Failed to decode dataset type");
 		_exit(EXIT_FAILURE);
 	}
+	dataset->elem_size = H5Tget_size(dataset->type_id);
 	H5Tencode(dataset->type_id, NULL, &size);
 	idx += size;
 	//Get the dataset creation property list
 	dataset->dcpl_id = H5Pdecode(&buffer[idx]);
+	if (dataset->dcpl_id < 0) {
+		log_fatal("Failed to decode dataset creation property list");
+		_exit(EXIT_FAILURE);
+	}
+	H5Pencode1(dataset->dcpl_id, NULL, &size);
+	idx += size;
+	//Get the tile shape
+	memcpy(&dataset->tile_rank, &buffer[idx], sizeof(dataset->tile_rank));
+	if (dataset->tile_rank > PARH5D_MAX_DIMENSIONS) {
+		log_fatal("Corrupted tile rank %u for dataset %s", dataset->tile_rank,
+			  parh5I_get_inode_name(dataset->inode));
+		_exit(EXIT_FAILURE);
+	}
+	idx += sizeof(dataset->tile_rank);
+	memcpy(&dataset->tile_order, &buffer[idx], sizeof(dataset->tile_order));
+	idx += sizeof(dataset->tile_order);
+	memcpy(dataset->tile_dims, &buffer[idx], dataset->tile_rank * sizeof(hsize_t));
+	idx += dataset->tile_rank * sizeof(hsize_t);
+	memcpy(&dataset->delta_threshold, &buffer[idx], sizeof(dataset->delta_threshold));
+	idx += sizeof(dataset->delta_threshold);
+	memcpy(&dataset->error_bound, &buffer[idx], sizeof(dataset->error_bound));
+	idx += sizeof(dataset->error_bound);
+	memcpy(&dataset->zone_maps, &buffer[idx], sizeof(dataset->zone_maps));
+	idx += sizeof(dataset->zone_maps);
+	memcpy(&dataset->bitmap.lower, &buffer[idx], sizeof(dataset->bitmap.lower));
+	idx += sizeof(dataset->bitmap.lower);
+	memcpy(&dataset->bitmap.upper, &buffer[idx], sizeof(dataset->bitmap.upper));
+	idx += sizeof(dataset->bitmap.upper);
+	memcpy(&dataset->bitmap.num_bins, &buffer[idx], sizeof(dataset->bitmap.num_bins));
 }
 
+static void parh5D_set_tile_size(parh5D_dataset_t dataset);
+
 parh5D_dataset_t parh5D_open_dataset(parh5I_inode_t inode, parh5F_file_t file)
 {
 	parh5D_dataset_t dset = calloc(1UL, sizeof(*dset));
@@ -223,6 +349,7 @@ parh5D_dataset_t parh5D_open_dataset(parh5I_inode_t inode, parh5F_file_t file)
 	dset->inode = inode;
 	dset->file = file;
 	parh5D_deserialize_dataset(dset);
+	parh5D_set_tile_size(dset);
 	return dset;
 }
 
@@ -240,36 +367,276 @@ static parh5D_dataset_t parh5D_read_dataset(parh5G_group_t group, uint64_t inode
 	return dset;
 }
 
-static void parh5D_set_tile_size(parh5D_dataset_t dataset)
+/**
+ * @brief Picks a tile shape of about PARH5D_CONTIGUOUS_TILE_SIZE elements
+ * for datasets without a chunk shape. Edges are balanced across dimensions,
+ * dimensions shorter than their share are covered whole and leave the rest
+ * of the budget to the others.
+ */
+static void parh5D_auto_tile_dims(parh5D_dataset_t dataset, int ndims)
+{
+	bool done[PARH5D_MAX_DIMENSIONS] = { 0 };
+	hsize_t remaining_elems = PARH5D_CONTIGUOUS_TILE_SIZE;
+	for (int dims_left = ndims; dims_left > 0; dims_left--) {
+		/*Visit the shortest dimension first*/
+		int dim = -1;
+		for (int i = 0; i < ndims; i++) {
+			if (!done[i] && (dim < 0 || dataset->dims[i] < dataset->dims[dim]))
+				dim = i;
+		}
+		/*The largest edge whose power over the dimensions left fits in the budget*/
+		hsize_t edge = 1;
+		for (;;) {
+			hsize_t volume = 1;
+			for (int i = 0; i < dims_left; i++)
+				volume *= edge + 1;
+			if (volume > remaining_elems)
+				break;
+			edge++;
+		}
+		if (edge > dataset->dims[dim])
+			edge = dataset->dims[dim] ? dataset->dims[dim] : 1;
+		dataset->tile_dims[dim] = edge;
+		remaining_elems /= edge;
+		done[dim] = true;
+	}
+}
+
+/**
+ * @brief Returns the tile order the application asked for through the
+ * PARH5_TILE_ORDER property of the dcpl, row-major if it is absent.
+ */
+static uint32_t parh5D_get_tile_order(hid_t dcpl_id)
+{
+	int tile_order = PARH5_TILE_ORDER_ROW_MAJOR;
+	if (H5Pexist(dcpl_id, PARH5_TILE_ORDER) <= 0)
+		return tile_order;
+	if (H5Pget(dcpl_id, PARH5_TILE_ORDER, &tile_order) < 0) {
+		log_fatal("Failed to get property %s", PARH5_TILE_ORDER);
+		_exit(EXIT_FAILURE);
+	}
+	if (tile_order != PARH5_TILE_ORDER_ROW_MAJOR && tile_order != PARH5_TILE_ORDER_MORTON) {
+		log_fatal("Unknown tile order %d", tile_order);
+		_exit(EXIT_FAILURE);
+	}
+	return tile_order;
+}
+
+/**
+ * @brief Returns the PARH5_DELTA_UPDATES property of the dcpl, 0 if it is
+ * absent.
+ */
+static uint32_t parh5D_get_delta_threshold_prop(hid_t dcpl_id)
 {
-	H5D_layout_t layout = H5Pget_layout(dataset->dcpl_id);
+	unsigned int delta_threshold = 0;
+	if (H5Pexist(dcpl_id, PARH5_DELTA_UPDATES) <= 0)
+		return delta_threshold;
+	if (H5Pget(dcpl_id, PARH5_DELTA_UPDATES, &delta_threshold) < 0) {
+		log_fatal("Failed to get property %s", PARH5_DELTA_UPDATES);
+		_exit(EXIT_FAILURE);
+	}
+	return delta_threshold;
+}
 
-	H5T_class_t class_id = H5Tget_class(dataset->type_id);
-	log_debug("Layout is %d", layout);
+/**
+ * @brief Returns the PARH5_ZONE_MAPS property of the dcpl, 0 if it is
+ * absent.
+ */
+static uint32_t parh5D_get_zone_maps_prop(hid_t dcpl_id)
+{
+	unsigned int zone_maps = 0;
+	if (H5Pexist(dcpl_id, PARH5_ZONE_MAPS) <= 0)
+		return zone_maps;
+	if (H5Pget(dcpl_id, PARH5_ZONE_MAPS, &zone_maps) < 0) {
+		log_fatal("Failed to get property %s", PARH5_ZONE_MAPS);
+		_exit(EXIT_FAILURE);
+	}
+	return zone_maps;
+}
 
-	dataset->tile_size_in_elems = PARH5D_CHUNKED_TILE_SIZE;
-	if (layout == H5D_CONTIGUOUS)
-		dataset->tile_size_in_elems = PARH5D_CONTIGUOUS_TILE_SIZE;
+/**
+ * @brief Returns the PARH5_BITMAP_INDEX property of the dcpl, without bins
+ * if it is absent.
+ */
+static struct parh5_bitmap_index parh5D_get_bitmap_index_prop(hid_t dcpl_id, const char *dataset_name)
+{
+	struct parh5_bitmap_index bitmap = { 0 };
+	if (H5Pexist(dcpl_id, PARH5_BITMAP_INDEX) <= 0)
+		return bitmap;
+	if (H5Pget(dcpl_id, PARH5_BITMAP_INDEX, &bitmap) < 0) {
+		log_fatal("Failed to get property %s", PARH5_BITMAP_INDEX);
+		_exit(EXIT_FAILURE);
+	}
+	if (bitmap.num_bins && (!isfinite(bitmap.lower) || !isfinite(bitmap.upper) || bitmap.lower > bitmap.upper)) {
+		log_fatal("Invalid bitmap index range [%g, %g] for dataset %s", bitmap.lower, bitmap.upper,
+			  dataset_name);
+		_exit(EXIT_FAILURE);
+	}
+	return bitmap;
+}
 
-	if (class_id != H5T_FLOAT && class_id != H5T_INTEGER && class_id != H5T_NATIVE_DOUBLE)
-		dataset->tile_size_in_elems = 1;
+/**
+ * @brief Returns the PARH5_LOSSY_ERROR_BOUND property of the dcpl, 0 if it
+ * is absent or the dataset is not of native floats or doubles.
+ */
+static double parh5D_get_error_bound_prop(hid_t dcpl_id, hid_t type_id, const char *dataset_name)
+{
+	double error_bound = 0;
+	if (H5Pexist(dcpl_id, PARH5_LOSSY_ERROR_BOUND) <= 0)
+		return error_bound;
+	if (H5Pget(dcpl_id, PARH5_LOSSY_ERROR_BOUND, &error_bound) < 0) {
+		log_fatal("Failed to get property %s", PARH5_LOSSY_ERROR_BOUND);
+		_exit(EXIT_FAILURE);
+	}
+	if (!(error_bound >= 0) || isinf(error_bound)) {
+		log_fatal("Invalid error bound %g for dataset %s", error_bound, dataset_name);
+		_exit(EXIT_FAILURE);
+	}
+	if (error_bound > 0 && H5Tequal(type_id, H5T_NATIVE_FLOAT) <= 0 && H5Tequal(type_id, H5T_NATIVE_DOUBLE) <= 0) {
+		log_warn("Dataset %s is not of floats or doubles, its tiles are stored exact", dataset_name);
+		return 0;
+	}
+	return error_bound;
+}
 
-	hsize_t dims[PARH5D_MAX_DIMENSIONS] = { 0 };
-	int ndims = H5Sget_simple_extent_dims(dataset->space_id, dims, NULL);
-	if (ndims < 0) {
+/**
+ * @brief Builds the fill tile of the dataset from the fill value of its
+ * dcpl. Fill values of variable-length types would hold pointers, they and
+ * fill values that are all zeros leave the fill tile NULL.
+ */
+static void parh5D_set_fill_tile(parh5D_dataset_t dataset)
+{
+	free(dataset->fill_tile);
+	dataset->fill_tile = NULL;
+	H5D_fill_value_t fill_status = H5D_FILL_VALUE_UNDEFINED;
+	if (H5Pfill_value_defined(dataset->dcpl_id, &fill_status) < 0 || H5D_FILL_VALUE_USER_DEFINED != fill_status ||
+	    H5T_VLEN == H5Tget_class(dataset->type_id) || H5Tis_variable_str(dataset->type_id) > 0)
+		return;
+	char *fill_value = calloc(1UL, dataset->elem_size);
+	if (H5Pget_fill_value(dataset->dcpl_id, dataset->type_id, fill_value) < 0) {
+		log_fatal("Failed to get the fill value of dataset %s", parh5I_get_inode_name(dataset->inode));
+		_exit(EXIT_FAILURE);
+	}
+	bool zero = true;
+	for (uint32_t i = 0; zero && i < dataset->elem_size; i++)
+		zero = 0 == fill_value[i];
+	if (zero) {
+		free(fill_value);
+		return;
+	}
+
+	/*Double the filled prefix until it covers the tile*/
+	size_t tile_size_in_bytes = (size_t)dataset->tile_size_in_elems * dataset->elem_size;
+	dataset->fill_tile = malloc(tile_size_in_bytes);
+	memcpy(dataset->fill_tile, fill_value, dataset->elem_size);
+	for (size_t filled = dataset->elem_size; filled < tile_size_in_bytes; filled *= 2)
+		memcpy(&dataset->fill_tile[filled], dataset->fill_tile, PARH5D_MIN(filled, tile_size_in_bytes - filled));
+	free(fill_value);
+}
+
+static void parh5D_set_tile_size(parh5D_dataset_t dataset)
+{
+	int ndims = H5Sget_simple_extent_dims(dataset->space_id, dataset->dims, NULL);
+	if (ndims < 0 || ndims > PARH5D_MAX_DIMENSIONS) {
 		log_fatal("Failed to get dimensions for dataset");
 		_exit(EXIT_FAILURE);
 	}
+	if (0 == ndims) {
+		/*Scalar dataspace, a single element*/
+		ndims = 1;
+		dataset->dims[0] = 1;
+	}
+
+	if (0 == dataset->tile_rank) {
+		H5D_layout_t layout = H5Pget_layout(dataset->dcpl_id);
+		H5T_class_t class_id = H5Tget_class(dataset->type_id);
+		log_debug("Layout is %d", layout);
+
+		if (class_id != H5T_FLOAT && class_id != H5T_INTEGER) {
+			for (int dim = 0; dim < ndims; dim++)
+				dataset->tile_dims[dim] = 1;
+		} else if (H5D_CHUNKED == layout) {
+			if (H5Pget_chunk(dataset->dcpl_id, ndims, dataset->tile_dims) != ndims) {
+				log_fatal("Failed to get the chunk dimensions of dataset %s",
+					  parh5I_get_inode_name(dataset->inode));
+				_exit(EXIT_FAILURE);
+			}
+		} else
+			parh5D_auto_tile_dims(dataset, ndims);
+		dataset->tile_rank = ndims;
+		dataset->tile_order = parh5D_get_tile_order(dataset->dcpl_id);
+		dataset->delta_threshold = parh5D_get_delta_threshold_prop(dataset->dcpl_id);
+		dataset->error_bound = parh5D_get_error_bound_prop(dataset->dcpl_id, dataset->type_id,
+								   parh5I_get_inode_name(dataset->inode));
+		dataset->zone_maps = parh5D_get_zone_maps_prop(dataset->dcpl_id);
+		if (dataset->zone_maps && PARH5S_NONE == parh5S_get_elem_type(dataset->type_id)) {
+			log_warn("Dataset %s is not of native integers or floats, it keeps no zone maps",
+				 parh5I_get_inode_name(dataset->inode));
+			dataset->zone_maps = 0;
+		}
+		dataset->bitmap = parh5D_get_bitmap_index_prop(dataset->dcpl_id, parh5I_get_inode_name(dataset->inode));
+		if (dataset->bitmap.num_bins && PARH5S_NONE == parh5S_get_elem_type(dataset->type_id)) {
+			log_warn("Dataset %s is not of native integers or floats, it keeps no bitmap index",
+				 parh5I_get_inode_name(dataset->inode));
+			dataset->bitmap.num_bins = 0;
+		}
+	}
+
+	if (dataset->tile_rank != (uint32_t)ndims) {
+		log_fatal("Tile rank %u does not match the rank %d of dataset %s", dataset->tile_rank, ndims,
+			  parh5I_get_inode_name(dataset->inode));
+		_exit(EXIT_FAILURE);
+	}
 
-	// if (dataset->tile_size_in_elems > dims[0])
-	// 	dataset->tile_size_in_elems = dims[0];
-	// Iterate through the properties and print their names and values
-	H5Piterate(dataset->dcpl_id, NULL, parh5_property_list_iterator, NULL);
+	dataset->tile_size_in_elems = 1;
+	for (int dim = 0; dim < ndims; dim++) {
+		dataset->tiles_per_dim[dim] = (dataset->dims[dim] + dataset->tile_dims[dim] - 1) / dataset->tile_dims[dim];
+		dataset->tile_size_in_elems *= dataset->tile_dims[dim];
+		log_debug("Dim[%d] = %lu tile dim = %lu", dim, dataset->dims[dim], dataset->tile_dims[dim]);
+	}
+	log_debug("Set tile size in elements %u", dataset->tile_size_in_elems);
+	parh5D_set_fill_tile(dataset);
+	/*Tiles are the chunks of the dataset, the filters see them as such*/
+	if (NULL == dataset->pipeline)
+		dataset->pipeline = parh5Z_create_pipeline(dataset->dcpl_id, dataset->type_id, dataset->tile_rank,
+							   dataset->tile_dims, dataset->error_bound,
+							   parh5I_get_inode_name(dataset->inode));
+	dataset->zone_type = dataset->zone_maps ? parh5S_get_elem_type(dataset->type_id) : PARH5S_NONE;
+	if (NULL == dataset->bitmap_index && dataset->bitmap.num_bins)
+		dataset->bitmap_index = parh5B_create_index(parh5S_get_elem_type(dataset->type_id),
+							    dataset->bitmap.lower, dataset->bitmap.upper,
+							    dataset->bitmap.num_bins);
+
+	if (PARH5_TILE_ORDER_MORTON != dataset->tile_order)
+		return;
+	uint32_t bits_per_dim = PARH5D_TILE_ID_BITS / dataset->tile_rank;
+	for (int dim = 0; dim < ndims; dim++) {
+		if (bits_per_dim >= PARH5D_TILE_ID_BITS || dataset->tiles_per_dim[dim] <= (1UL << bits_per_dim))
+			continue;
+		log_fatal("Dataset %s has too many tiles in dimension %d for Z-order tile ids",
+			  parh5I_get_inode_name(dataset->inode), dim);
+		_exit(EXIT_FAILURE);
+	}
+}
 
-	fprintf(stderr, "Set tile size in elements %u\n", dataset->tile_size_in_elems);
-	for (int i = ndims - 1; i >= 0; i--)
-		fprintf(stderr, "Dim[%d] = %ld\n", i, dims[i]);
-	// _exit(EXIT_FAILURE);
+/**
+ * @brief The tile cache is shared by all datasets of the file. A chunk cache
+ * size set on the dataset access property list raises the budget of the
+ * shared cache to at least that size.
+ */
+static void parh5D_reserve_tile_cache(parh5D_dataset_t dataset, hid_t dapl_id)
+{
+	size_t rdcc_nslots = 0;
+	size_t rdcc_nbytes = 0;
+	double rdcc_w0 = 0;
+	if (dapl_id <= 0 || H5Pget_chunk_cache(dapl_id, &rdcc_nslots, &rdcc_nbytes, &rdcc_w0) < 0)
+		return;
+	/*HDF5 reports the library default when the application has not set one, ignore it*/
+	size_t default_nbytes = 0;
+	if (H5Pget_chunk_cache(H5P_DATASET_ACCESS_DEFAULT, &rdcc_nslots, &default_nbytes, &rdcc_w0) < 0 ||
+	    default_nbytes == rdcc_nbytes)
+		return;
+	parh5T_reserve_tile_cache(parh5F_get_tile_cache(dataset->file), rdcc_nbytes);
 }
 
 void *parh5D_create(void *obj, const H5VL_loc_params_t *loc_params, const char *name, hid_t lcpl_id, hid_t type_id,
@@ -278,7 +645,6 @@ void *parh5D_create(void *obj, const H5VL_loc_params_t *loc_params, const char *
 	(void)loc_params;
 	(void)name;
 	(void)lcpl_id;
-	(void)dapl_id;
 	(void)req;
 	(void)dxpl_id;
 	H5I_type_t *obj_type = obj;
@@ -315,15 +681,17 @@ void *parh5D_create(void *obj, const H5VL_loc_params_t *loc_params, const char *
 					     parh5G_get_parallax_db(parent_group));
 	log_debug("Creating dataspace in parent group %s", parh5I_get_inode_name(parh5G_get_inode(parent_group)));
 	dataset->type_id = H5Tcopy(type_id);
+	dataset->elem_size = H5Tget_size(dataset->type_id);
 	dataset->dcpl_id = H5Pcopy(dcpl_id);
 	dataset->file = parh5G_get_file(parent_group);
 	dataset->space_id = H5Scopy(space_id);
+	parh5D_set_tile_size(dataset);
 	parh5D_store_dataset(dataset);
 	parh5I_add_pivot_in_inode(parh5G_get_inode(parent_group), parh5I_get_inode_num(dataset->inode), name,
 				  parh5G_get_parallax_db(parent_group));
 	parh5I_store_inode(parh5G_get_inode(parent_group), parh5G_get_parallax_db(parent_group));
 
-	parh5D_set_tile_size(dataset);
+	parh5D_reserve_tile_cache(dataset, dapl_id);
 	log_debug("Dimensions of new dataspace are %d", H5Sget_simple_extent_ndims(dataset->space_id));
 
 	return dataset;
@@ -333,7 +701,6 @@ void *parh5D_open(void *obj, const H5VL_loc_params_t *loc_params, const char *na
 		  void **req)
 {
 	(void)loc_params;
-	(void)dapl_id;
 	(void)dxpl_id;
 	(void)req;
 	H5I_type_t *obj_type = obj;
@@ -358,109 +725,198 @@ void *parh5D_open(void *obj, const H5VL_loc_params_t *loc_params, const char *na
 
 	parh5D_dataset_t dataset = parh5D_read_dataset(parent_group, inode_num);
 	parh5D_set_tile_size(dataset);
+	parh5D_reserve_tile_cache(dataset, dapl_id);
 	assert(dataset);
 	return dataset;
 }
 
-/**
- * @brief Based on the start array returns the coordinates of the first element.
- * @param ndims [in] number of array dimensions.
- * @param coordinates [out] fills the coordinates of the the first element.
- * @param start [in] the starting coordinates of the element.
- */
-static void parh5D_get_first_array_element(int ndims, hsize_t coordinates[], hsize_t start[])
-{
-	// if (ndims > 2)
-	// 	fprintf(stderr, "*--*\n");
+struct parh5D_multi_op {
+	parh5D_dataset_t dataset;
+	size_t idx; /*in the arrays of the multi-dataset call*/
+};
 
-	for (int dim = 0; dim < ndims; dim++) {
-		coordinates[dim] = start[dim];
-		// if (ndims > 2)
-		// fprintf(stderr, "Fresh start[%d]=%ld\n", dim, start[dim]);
-	}
-	// if (ndims > 2)
-	// 	fprintf(stderr, "*--*\n");
+static int parh5D_cmp_multi_ops(const void *op_a, const void *op_b)
+{
+	const struct parh5D_multi_op *a = op_a;
+	const struct parh5D_multi_op *b = op_b;
+	if (a->dataset->file != b->dataset->file)
+		return a->dataset->file < b->dataset->file ? -1 : 1;
+	uint64_t inode_num_a = parh5I_get_inode_num(a->dataset->inode);
+	uint64_t inode_num_b = parh5I_get_inode_num(b->dataset->inode);
+	if (inode_num_a != inode_num_b)
+		return inode_num_a < inode_num_b ? -1 : 1;
+	return a->idx < b->idx ? -1 : a->idx > b->idx;
 }
 
 /**
- * @brief Returns the coordinates of the next element in row-wise iteration.
- * @param ndims [in] number of array dimensions
- * @param coordinates [out] the coordinates of the next element
- * @param start [in] the starting coordinates of the selection
- * @param end [in] the ending coordinates of the selection
+ * @brief Orders the datasets of a multi-dataset call by file and then by
+ * inode number. Tile keys start with the inode number, so visiting the
+ * datasets in this order touches the tiles of each file in key order.
+ * Operations on the same dataset keep their relative order.
+ * @return array of count operations the caller frees
  */
-static void parh5D_get_next_array_element(int ndims, hsize_t coordinates[], hsize_t start[], hsize_t end[])
+static struct parh5D_multi_op *parh5D_plan_multi_op(size_t count, void *dset[])
 {
-	int i = ndims - 1;
-	while (i >= 0) {
-		if (coordinates[i] <= end[i]) {
-			coordinates[i--]++;
-			break;
+	struct parh5D_multi_op *ops = calloc(count, sizeof(*ops));
+	for (size_t i = 0; i < count; i++) {
+		H5I_type_t *obj_type = dset[i];
+		if (H5I_DATASET != *obj_type) {
+			log_fatal("Dataset I/O can only be associated with a dataset object");
+			_exit(EXIT_FAILURE);
 		}
-		coordinates[i] = start[i];
-		i--;
+		ops[i].dataset = dset[i];
+		ops[i].idx = i;
 	}
-	// for (int id = 0; id < ndims && ndims > 2; id++) {
-	// fprintf(stderr, "start[%d] = %ld\n", id, start[id]);
-	// fprintf(stderr, "end[%d] = %ld\n", id, end[id]);
-	// 	fprintf(stderr, "coord[%d] = %ld\n", id, coordinates[id]);
-	// }
+	qsort(ops, count, sizeof(*ops), parh5D_cmp_multi_ops);
+	return ops;
 }
 
 /**
- * @brief Calculates the address of the element in a N-dimensional array.
- * @param  base_addr [in] starting address of the array in memory
- * @param ndims [in] dimensions of the in memory array
- * @param dims [in] the actual dimensions of the in memory array
- * @param coords [in] the coordinates of the element
- * @param elem_size [in] the size in bytes of each cell of the array
- * @return a pointer to the element
+ * @brief Returns the converter from src_type_id to dst_type_id or NULL if
+ * the types are the same.
  */
-static char *parh5D_calc_elem_addr(const char *base_addr, int ndims, size_t dims[], size_t coords[], size_t elem_size)
+static parh5C_converter_t parh5D_get_converter(hid_t src_type_id, hid_t dst_type_id)
 {
-	// log_debug("Ndims are: %d", ndims);
-	// for (int i = 0; i < ndims; i++) {
-	// 	fprintf(stderr, "element[%d] = %ld\n", i, coords[i]);
-	// 	fprintf(stderr, "dimension[%d] = %ld\n", i, dims[i]);
-	// }
-	char *element_addr = (char *)base_addr;
+	if (H5Tequal(src_type_id, dst_type_id) > 0)
+		return NULL;
+	parh5C_converter_t conv = parh5C_create_converter(src_type_id, dst_type_id);
+	if (NULL == conv) {
+		log_fatal("Cannot convert between the memory and the dataset datatype");
+		_exit(EXIT_FAILURE);
+	}
+	return conv;
+}
 
-	size_t stride = elem_size;
+/*The transfers of an asynchronous read or write call, they run as one request*/
+struct parh5D_deferred_io {
+	size_t count;
+	parh5C_converter_t *convs; /*one per operation of the call*/
+	parh5X_op_t *ops; /*one per operation that selects elements*/
+	size_t num_ops;
+	parh5T_tile_cache_t wait_cache; /*the request completes after its puts, NULL for reads and buffered writes*/
+};
 
-	for (int i = 0; i < ndims; i++) {
-		element_addr += (coords[i] * stride);
-		stride *= dims[i];
-	}
+static void parh5D_run_deferred_io(void *arg)
+{
+	struct parh5D_deferred_io *deferred = arg;
+	for (size_t i = 0; i < deferred->num_ops; i++)
+		parh5X_run_op(deferred->ops[i]);
+	if (deferred->wait_cache)
+		parh5T_wait_for_puts(deferred->wait_cache);
+}
 
-	return element_addr;
+static void parh5D_free_deferred_io(void *arg)
+{
+	struct parh5D_deferred_io *deferred = arg;
+	for (size_t i = 0; i < deferred->num_ops; i++)
+		parh5X_destroy_op(deferred->ops[i]);
+	for (size_t i = 0; i < deferred->count; i++)
+		parh5C_destroy_converter(deferred->convs[i]);
+	free(deferred->ops);
+	free(deferred->convs);
+	free(deferred);
 }
 
-herr_t parh5D_read(size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_space_id[], hid_t file_space_id[],
-		   hid_t dxpl_id, void *buf[], void **req)
+/**
+ * @brief Returns true if the application asked for buffered writes through
+ * the PARH5_BUFFERED_WRITES property of the dxpl.
+ */
+static bool parh5D_is_buffered_write(hid_t dxpl_id)
 {
-	(void)dxpl_id;
-	(void)req;
-	if (0 == count) {
-		log_warn("Zero operations defined?");
-		return PARH5_SUCCESS;
+	unsigned int buffered = 0;
+	if (H5P_DEFAULT == dxpl_id || H5Pexist(dxpl_id, PARH5_BUFFERED_WRITES) <= 0)
+		return false;
+	if (H5Pget(dxpl_id, PARH5_BUFFERED_WRITES, &buffered) < 0) {
+		log_fatal("Failed to get property %s", PARH5_BUFFERED_WRITES);
+		_exit(EXIT_FAILURE);
 	}
+	return 0 != buffered;
+}
 
-	if (count > 1) {
-		log_fatal("Sorry cannot support yet scatter/gather write I/Os");
-		_exit(EXIT_FAILURE);
+/**
+ * @brief Creates the converters of a read or write call, ordered as ops.
+ * @param [in] to_mem true for reads, the converters go from the dataset to
+ * the memory type
+ */
+static parh5C_converter_t *parh5D_get_converters(size_t count, const struct parh5D_multi_op *ops,
+						 const hid_t mem_type_id[], bool to_mem)
+{
+	parh5C_converter_t *convs = calloc(count, sizeof(*convs));
+	for (size_t i = 0; i < count; i++) {
+		hid_t dset_type_id = ops[i].dataset->type_id;
+		hid_t type_id = mem_type_id[ops[i].idx];
+		convs[i] = to_mem ? parh5D_get_converter(dset_type_id, type_id) :
+				    parh5D_get_converter(type_id, dset_type_id);
 	}
+	return convs;
+}
 
-	H5I_type_t *obj_type = dset[0];
-	if (H5I_DATASET != *obj_type) {
-		log_fatal("Dataset write can only be associated with a file object");
+/**
+ * @brief Decides how a read or write call runs. If HDF5 asks for a request
+ * and the call can run without the library, i.e., it works on a single file
+ * and its conversions, if any, are thread-safe, the call gets a deferred I/O
+ * that its transfers are prepared into. Otherwise the call runs
+ * synchronously, after the requests of its files complete.
+ * @return the deferred I/O, NULL if the call runs synchronously
+ */
+static struct parh5D_deferred_io *parh5D_defer_io(size_t count, const struct parh5D_multi_op *ops,
+						  parh5C_converter_t convs[], void **req)
+{
+	bool can_defer = NULL != req;
+	for (size_t i = 0; can_defer && i < count; i++) {
+		if (ops[i].dataset->file != ops[0].dataset->file || (convs[i] && !parh5C_is_thread_safe(convs[i])))
+			can_defer = false;
+	}
+	if (can_defer) {
+		struct parh5D_deferred_io *deferred_io = calloc(1UL, sizeof(*deferred_io));
+		deferred_io->count = count;
+		deferred_io->convs = convs;
+		deferred_io->ops = calloc(count, sizeof(*deferred_io->ops));
+		return deferred_io;
+	}
+	for (size_t i = 0; i < count; i++)
+		parh5R_drain(parh5F_get_executor(ops[i].dataset->file));
+	return NULL;
+}
+
+/**
+ * @brief Prepares a transfer of a deferred I/O.
+ */
+static void parh5D_defer_transfer(struct parh5D_deferred_io *deferred, parh5D_dataset_t dataset, hid_t file_space_id,
+				  hid_t mem_space_id, parh5C_converter_t conv, char *mem_buf,
+				  enum parh5X_direction direction)
+{
+	parh5X_op_t op = parh5X_prepare(dataset, parh5F_get_tile_cache(dataset->file), parh5F_get_workers(dataset->file),
+					file_space_id, mem_space_id, conv, mem_buf, direction, true);
+	if (NULL == op) {
+		log_fatal("Unsupported selection");
 		_exit(EXIT_FAILURE);
 	}
+	deferred->ops[deferred->num_ops++] = op;
+}
 
-	parh5D_dataset_t dataset = (parh5D_dataset_t)dset[0];
-	assert(H5Tequal(mem_type_id[0], dataset->type_id));
+/**
+ * @brief Ends a read or write call. A deferred I/O becomes the request
+ * the call returns to HDF5, the converters of a synchronous call are freed.
+ */
+static void parh5D_finish_io(size_t count, const struct parh5D_multi_op *ops, parh5C_converter_t convs[],
+			     struct parh5D_deferred_io *deferred, void **req)
+{
+	if (deferred) {
+		*req = parh5R_submit(parh5F_get_executor(ops[0].dataset->file), parh5D_run_deferred_io,
+				     parh5D_free_deferred_io, deferred);
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+		parh5C_destroy_converter(convs[i]);
+	free(convs);
+}
 
-	hid_t real_file_space_id = file_space_id[0] == H5S_ALL ? dataset->space_id : file_space_id[0];
-	hid_t real_mem_space_id = mem_space_id[0] == H5S_ALL ? dataset->space_id : mem_space_id[0];
+static void parh5D_read_selection(parh5D_dataset_t dataset, hid_t mem_space_id, hid_t file_space_id, void *buf,
+				  parh5C_converter_t conv, struct parh5D_deferred_io *deferred)
+{
+	hid_t real_file_space_id = file_space_id == H5S_ALL ? dataset->space_id : file_space_id;
+	hid_t real_mem_space_id = mem_space_id == H5S_ALL ? dataset->space_id : mem_space_id;
 
 	/* Get number of elements in selections */
 	hssize_t num_elem_file = -1;
@@ -486,104 +942,56 @@ herr_t parh5D_read(size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_sp
 	}
 
 	if (num_elem_file == 0)
-		return PARH5_SUCCESS;
-
-	if (num_elem_file == 0)
-		return PARH5_SUCCESS;
-
-	//Retrieve mem ndims and start, end coords
-	hsize_t mem_shape[PARH5D_MAX_DIMENSIONS] = { 0 };
-	int mem_ndims = H5Sget_simple_extent_dims(real_mem_space_id, mem_shape, NULL);
-	if (mem_ndims < 0) {
-		log_fatal("Failed to get file dimensions");
-		_exit(EXIT_FAILURE);
-	}
-	hsize_t mem_start_coords[PARH5D_MAX_DIMENSIONS];
-	hsize_t mem_end_coords[PARH5D_MAX_DIMENSIONS];
-	if (H5Sget_select_bounds(real_mem_space_id, mem_start_coords, mem_end_coords) < 0) {
-		log_fatal("Failed to get start, end bounds");
-		_exit(EXIT_FAILURE);
-	}
-	//Retrieve file ndims and start, end coords
-	hsize_t file_shape[PARH5D_MAX_DIMENSIONS] = { 0 };
-	int file_ndims = H5Sget_simple_extent_dims(real_file_space_id, file_shape, NULL);
-	if (file_ndims < 0) {
-		log_fatal("Failed to get file dimensions");
-		_exit(EXIT_FAILURE);
-	}
-	hsize_t file_start_coords[PARH5D_MAX_DIMENSIONS];
-	hsize_t file_end_coords[PARH5D_MAX_DIMENSIONS];
-	if (H5Sget_select_bounds(real_file_space_id, file_start_coords, file_end_coords) < 0) {
-		log_fatal("Failed to get start, end bounds");
-		_exit(EXIT_FAILURE);
-	}
-
-	size_t mem_buf_size = num_elem_mem * H5Tget_size(dataset->type_id);
-
-	hsize_t mem_coords[PARH5D_MAX_DIMENSIONS] = { 0 };
-	parh5D_get_first_array_element(mem_ndims, mem_coords, mem_start_coords);
-
-	hsize_t file_coords[PARH5D_MAX_DIMENSIONS] = { 0 };
-	parh5D_get_first_array_element(file_ndims, file_coords, file_start_coords);
+		return;
 
 #ifdef METRICS_ENABLE
+	size_t mem_buf_size = num_elem_mem * dataset->elem_size;
 	parh5M_inc_dset_bytes_read(dataset, mem_buf_size);
 #endif
 
-	parh5T_tile_cache_t tile_cache = parh5T_init_tile_cache(dataset, PARH5D_READ_TILE_CACHE);
-	const char *mem_buf = buf[0];
+	parh5T_tile_cache_t tile_cache = parh5F_get_tile_cache(dataset->file);
+	char *mem_buf = buf;
 
-	// fprintf(stderr, " <Read access>\n");
-	for (hssize_t elem_num = 0; elem_num < num_elem_mem; elem_num++) {
-		char *elem_addr =
-			parh5D_calc_elem_addr(mem_buf, mem_ndims, mem_shape, mem_coords, H5Tget_size(dataset->type_id));
-
-		hsize_t file_elem_id = parh5D_get_id_from_coords(file_coords, file_shape, file_ndims);
-
-		// for (int i = file_ndims - 1; i >= 0; i--)
-		// 	fprintf(stderr, "Read access: file_coord[%d] = %ld ", i, file_coords[i]);
-		// fprintf(stderr, "\n");
-
-		struct parh5T_tile file_tile = parh5D_map_id2tile(dataset, file_elem_id);
-		parh5T_read_from_tile_cache(tile_cache, file_tile, elem_addr, H5Tget_size(dataset->type_id));
-
-		parh5D_get_next_array_element(mem_ndims, mem_coords, mem_start_coords, mem_end_coords);
-		parh5D_get_next_array_element(file_ndims, file_coords, file_start_coords, file_end_coords);
+	if (deferred)
+		parh5D_defer_transfer(deferred, dataset, real_file_space_id, real_mem_space_id, conv, mem_buf,
+				      PARH5X_READ);
+	else if (!parh5X_transfer(dataset, tile_cache, parh5F_get_workers(dataset->file), real_file_space_id,
+				  real_mem_space_id, conv, mem_buf, PARH5X_READ)) {
+		log_fatal("Unsupported selection");
+		_exit(EXIT_FAILURE);
 	}
-	// fprintf(stderr, " </Read access>\n");
-	parh5T_destroy_tile_cache(tile_cache);
-
-	return PARH5_SUCCESS;
 }
 
-herr_t parh5D_write(size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_space_id[], hid_t file_space_id[],
-		    hid_t dxpl_id, const void *buf[], void **req)
+herr_t parh5D_read(size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_space_id[], hid_t file_space_id[],
+		   hid_t dxpl_id, void *buf[], void **req)
 {
-	(void)req;
 	(void)dxpl_id;
-
 	if (0 == count) {
 		log_warn("Zero operations defined?");
 		return PARH5_SUCCESS;
 	}
 
-	if (count > 1) {
-		log_fatal("Sorry cannot support yet scatter/gather write I/Os");
+	if (!buf) {
+		log_fatal("NULL buffer array");
 		_exit(EXIT_FAILURE);
 	}
 
-	H5I_type_t *obj_type = dset[0];
-	if (H5I_DATASET != *obj_type) {
-		log_fatal("Dataset write can only be associated with a file object");
-		_exit(EXIT_FAILURE);
-	}
-
-	parh5D_dataset_t dataset = (parh5D_dataset_t)dset[0];
-	if (!H5Tequal(mem_type_id[0], dataset->type_id)) {
-		log_fatal("Sorry Parallax does not support dynamic types yet");
-		_exit(EXIT_FAILURE);
+	struct parh5D_multi_op *ops = parh5D_plan_multi_op(count, dset);
+	parh5C_converter_t *convs = parh5D_get_converters(count, ops, mem_type_id, true);
+	struct parh5D_deferred_io *deferred = parh5D_defer_io(count, ops, convs, req);
+	for (size_t i = 0; i < count; i++) {
+		size_t idx = ops[i].idx;
+		parh5D_read_selection(ops[i].dataset, mem_space_id[idx], file_space_id[idx], buf[idx], convs[i],
+				      deferred);
 	}
+	parh5D_finish_io(count, ops, convs, deferred, req);
+	free(ops);
+	return PARH5_SUCCESS;
+}
 
+static void parh5D_write_selection(parh5D_dataset_t dataset, hid_t mem_space_id, hid_t file_space_id,
+				   const void *buf, parh5C_converter_t conv, struct parh5D_deferred_io *deferred)
+{
 	/* Get dataspace extent */
 	int dpace_ndims = 0;
 	if ((dpace_ndims = H5Sget_simple_extent_ndims(dataset->space_id)) < 0) {
@@ -591,8 +999,8 @@ herr_t parh5D_write(size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_s
 		_exit(EXIT_FAILURE);
 	}
 
-	hid_t real_file_space_id = file_space_id[0] == H5S_ALL ? dataset->space_id : file_space_id[0];
-	hid_t real_mem_space_id = mem_space_id[0] == H5S_ALL ? dataset->space_id : mem_space_id[0];
+	hid_t real_file_space_id = file_space_id == H5S_ALL ? dataset->space_id : file_space_id;
+	hid_t real_mem_space_id = mem_space_id == H5S_ALL ? dataset->space_id : mem_space_id;
 
 	hssize_t num_elem_mem = -1;
 	if ((num_elem_mem = H5Sget_select_npoints(real_mem_space_id)) < 0) {
@@ -617,78 +1025,57 @@ herr_t parh5D_write(size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_s
 		log_fatal("write buffer is NULL but selection has >0 elements");
 
 	if (num_elem_file == 0)
-		return PARH5_SUCCESS;
+		return;
 
-	//Retrieve mem ndims and start, end coords
-	hsize_t mem_shape[PARH5D_MAX_DIMENSIONS] = { 0 };
-	int mem_ndims = H5Sget_simple_extent_dims(real_mem_space_id, mem_shape, NULL);
-	if (mem_ndims < 0) {
-		log_fatal("Failed to get file dimensions");
-		_exit(EXIT_FAILURE);
-	}
-	hsize_t mem_start_coords[PARH5D_MAX_DIMENSIONS];
-	hsize_t mem_end_coords[PARH5D_MAX_DIMENSIONS];
-	if (H5Sget_select_bounds(real_mem_space_id, mem_start_coords, mem_end_coords) < 0) {
-		log_fatal("Failed to get start, end bounds");
+#ifdef METRICS_ENABLE
+	size_t mem_buf_size = num_elem_mem * dataset->elem_size;
+	parh5M_inc_dset_bytes_written(dataset, mem_buf_size);
+#endif
+
+	char *mem_buf = (char *)buf;
+	parh5T_tile_cache_t tile_cache = parh5F_get_tile_cache(dataset->file);
+
+	/*Dirty tiles stay in the cache, they reach Parallax on eviction, flush, or close*/
+	if (deferred)
+		parh5D_defer_transfer(deferred, dataset, real_file_space_id, real_mem_space_id, conv, mem_buf,
+				      PARH5X_WRITE);
+	else if (!parh5X_transfer(dataset, tile_cache, parh5F_get_workers(dataset->file), real_file_space_id,
+				  real_mem_space_id, conv, mem_buf, PARH5X_WRITE)) {
+		log_fatal("Unsupported selection");
 		_exit(EXIT_FAILURE);
 	}
-	//Retrieve file ndims and start, end coords
-	hsize_t file_shape[PARH5D_MAX_DIMENSIONS] = { 0 };
-	int file_ndims = H5Sget_simple_extent_dims(real_file_space_id, file_shape, NULL);
-	if (file_ndims < 0) {
-		log_fatal("Failed to get file dimensions");
-		_exit(EXIT_FAILURE);
+}
+
+herr_t parh5D_write(size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_space_id[], hid_t file_space_id[],
+		    hid_t dxpl_id, const void *buf[], void **req)
+{
+	if (0 == count) {
+		log_warn("Zero operations defined?");
+		return PARH5_SUCCESS;
 	}
-	hsize_t file_start_coords[PARH5D_MAX_DIMENSIONS];
-	hsize_t file_end_coords[PARH5D_MAX_DIMENSIONS];
-	if (H5Sget_select_bounds(real_file_space_id, file_start_coords, file_end_coords) < 0) {
-		log_fatal("Failed to get start, end bounds");
+
+	if (!buf) {
+		log_fatal("NULL buffer array");
 		_exit(EXIT_FAILURE);
 	}
 
-	size_t mem_buf_size = num_elem_mem * H5Tget_size(dataset->type_id);
-
-	hsize_t mem_coords[PARH5D_MAX_DIMENSIONS] = { 0 };
-	parh5D_get_first_array_element(mem_ndims, mem_coords, mem_start_coords);
-
-	hsize_t file_coords[PARH5D_MAX_DIMENSIONS] = { 0 };
-	parh5D_get_first_array_element(file_ndims, file_coords, file_start_coords);
-
-#ifdef METRICS_ENABLE
-	parh5M_inc_dset_bytes_written(dataset, mem_buf_size);
-#endif
-
-	const char *mem_buf = buf[0];
-	parh5T_tile_cache_t tile_cache = parh5T_init_tile_cache(dataset, PARH5D_WRITE_TILE_CACHE);
-
-	// fprintf(stderr, "[%s:%s:%d]---------> memory size = %lu\n", __FILE__, __func__, __LINE__,
-	// 	num_elem_mem * H5Tget_size(dataset->type_id));
-	// fprintf(stderr, "<Write access>\n");
-	for (hssize_t elem_num = 0; elem_num < num_elem_mem; elem_num++) {
-		// for (int i = mem_ndims - 1; i >= 0; i--)
-		// 	fprintf(stderr, "mem_coord[%d] = %ld ", i, mem_coords[i]);
-		// fprintf(stderr, "\n");
-		// for (int i = file_ndims - 1; i >= 0; i--)
-		// 	fprintf(stderr, " file_coord[%d] = %ld ", i, file_coords[i]);
-		// fprintf(stderr, "\n");
-		// for (int i = mem_ndims - 1; i >= 0; i--)
-		// 	fprintf(stderr, " mem_coord[%d] = %ld ", i, mem_coords[i]);
-		// fprintf(stderr, "num_elem_mem = %ld\n", num_elem_mem);
-
-		char *elem_addr =
-			parh5D_calc_elem_addr(mem_buf, mem_ndims, mem_shape, mem_coords, H5Tget_size(dataset->type_id));
-
-		hsize_t file_elem_id = parh5D_get_id_from_coords(file_coords, file_shape, file_ndims);
-		struct parh5T_tile file_tile = parh5D_map_id2tile(dataset, file_elem_id);
-		parh5T_write_to_tile_cache(tile_cache, file_tile, elem_addr, H5Tget_size(dataset->type_id));
-
-		parh5D_get_next_array_element(mem_ndims, mem_coords, mem_start_coords, mem_end_coords);
-		parh5D_get_next_array_element(file_ndims, file_coords, file_start_coords, file_end_coords);
-	}
-	// fprintf(stderr, "</Write access>\n");
-	parh5T_tile_cache_evict(tile_cache);
-	parh5T_destroy_tile_cache(tile_cache);
-
+	/*All datasets share the tile cache of their file, their dirty tiles reach Parallax in one sorted flush*/
+	struct parh5D_multi_op *ops = parh5D_plan_multi_op(count, dset);
+	parh5C_converter_t *convs = parh5D_get_converters(count, ops, mem_type_id, false);
+	struct parh5D_deferred_io *deferred = parh5D_defer_io(count, ops, convs, req);
+	for (size_t i = 0; i < count; i++) {
+		size_t idx = ops[i].idx;
+		parh5D_write_selection(ops[i].dataset, mem_space_id[idx], file_space_id[idx], buf[idx], convs[i],
+				       deferred);
+	}
+	/*The tiles the write evicted are stored in the background, unbuffered writes complete after their puts*/
+	bool buffered = parh5D_is_buffered_write(dxpl_id);
+	if (deferred && !buffered)
+		deferred->wait_cache = parh5F_get_tile_cache(ops[0].dataset->file);
+	for (size_t i = 0; !deferred && !buffered && i < count; i++)
+		parh5T_wait_for_puts(parh5F_get_tile_cache(ops[i].dataset->file));
+	parh5D_finish_io(count, ops, convs, deferred, req);
+	free(ops);
 	return PARH5_SUCCESS;
 }
 
@@ -731,24 +1118,776 @@ herr_t parh5D_get(void *obj, H5VL_dataset_get_args_t *get_op, hid_t dxpl_id, voi
 
 herr_t parh5D_specific(void *obj, H5VL_dataset_specific_args_t *args, hid_t dxpl_id, void **req)
 {
-	(void)obj;
-	(void)args;
 	(void)dxpl_id;
 	(void)req;
-	log_fatal("Dataset: Sorry unimplemented function XXX TODO XXX");
-	_exit(EXIT_FAILURE);
+	H5I_type_t *obj_type = obj;
+	if (H5I_DATASET != *obj_type) {
+		log_fatal("Object is not a dataset!");
+		_exit(EXIT_FAILURE);
+	}
+	parh5D_dataset_t dataset = obj;
+
+	switch (args->op_type) {
+	case H5VL_DATASET_FLUSH:
+		parh5D_flush(dataset);
+		return PARH5_SUCCESS;
+	default:
+		log_fatal("Dataset: Sorry unimplemented operation %d XXX TODO XXX", args->op_type);
+		_exit(EXIT_FAILURE);
+	}
 	return 1;
 }
 
+enum parh5D_optional_op { PARH5D_QUERY_TILES = 0, PARH5D_AGGREGATE, PARH5D_QUERY_ELEMENTS, PARH5D_NUM_OPTIONAL_OPS };
+
+/*The optional operations of datasets and the op_types HDF5 assigned them, -1 until they are registered*/
+static struct {
+	const char *name;
+	int op_type;
+} parh5D_optional_ops[PARH5D_NUM_OPTIONAL_OPS] = { [PARH5D_QUERY_TILES] = { PARH5_QUERY_TILES_OP, -1 },
+						     [PARH5D_AGGREGATE] = { PARH5_AGGREGATE_OP, -1 },
+						     [PARH5D_QUERY_ELEMENTS] = { PARH5_QUERY_ELEMENTS_OP, -1 } };
+
+void parh5D_register_optional_ops(void)
+{
+	for (int op = 0; op < PARH5D_NUM_OPTIONAL_OPS; op++) {
+		const char *name = parh5D_optional_ops[op].name;
+		int *op_type = &parh5D_optional_ops[op].op_type;
+		if (H5VLregister_opt_operation(H5VL_SUBCLS_DATASET, name, op_type) >= 0)
+			continue;
+		/*Registered already, by an earlier registration of the connector*/
+		if (H5VLfind_opt_operation(H5VL_SUBCLS_DATASET, name, op_type) < 0) {
+			log_warn("Failed to register optional operation %s", name);
+			*op_type = -1;
+		}
+	}
+}
+
+void parh5D_unregister_optional_ops(void)
+{
+	for (int op = 0; op < PARH5D_NUM_OPTIONAL_OPS; op++) {
+		if (parh5D_optional_ops[op].op_type >= 0)
+			H5VLunregister_opt_operation(H5VL_SUBCLS_DATASET, parh5D_optional_ops[op].name);
+		parh5D_optional_ops[op].op_type = -1;
+	}
+}
+
+/**
+ * @brief Returns the optional operation HDF5 assigned op_type to,
+ * PARH5D_NUM_OPTIONAL_OPS if none.
+ */
+static enum parh5D_optional_op parh5D_get_optional_op(int op_type)
+{
+	int op = 0;
+	while (op < PARH5D_NUM_OPTIONAL_OPS && (op_type < 0 || op_type != parh5D_optional_ops[op].op_type))
+		op++;
+	return op;
+}
+
+bool parh5D_is_optional_op(int op_type)
+{
+	return parh5D_get_optional_op(op_type) < PARH5D_NUM_OPTIONAL_OPS;
+}
+
+/*Tiles a zone map scan collects, sorted by tile id since zone maps are scanned in tile id order*/
+struct parh5D_zone_scan {
+	double lower;
+	double upper;
+	bool fill_matches; /*the range holds the fill value: collect the tiles it excludes instead*/
+	uint64_t *tile_ids;
+	size_t num_tile_ids;
+	size_t capacity;
+};
+
+static void parh5D_collect_zone(uint64_t tile_id, const struct parh5S_zone *zone, void *cb_arg)
+{
+	struct parh5D_zone_scan *scan = cb_arg;
+	if (parh5S_zone_may_match(zone, scan->lower, scan->upper) == scan->fill_matches)
+		return;
+	if (scan->num_tile_ids == scan->capacity) {
+		scan->capacity = scan->capacity ? 2 * scan->capacity : PARH5D_MIN_QUERY_TILES;
+		scan->tile_ids = realloc(scan->tile_ids, scan->capacity * sizeof(*scan->tile_ids));
+	}
+	scan->tile_ids[scan->num_tile_ids++] = tile_id;
+}
+
+static int parh5D_cmp_tile_ids(const void *tile_id_a, const void *tile_id_b)
+{
+	uint64_t a = *(const uint64_t *)tile_id_a;
+	uint64_t b = *(const uint64_t *)tile_id_b;
+	return a < b ? -1 : a > b;
+}
+
+static void parh5D_add_query_tile(parh5D_dataset_t dataset, struct parh5_query_tiles_args *query,
+				  const hsize_t tile_coords[])
+{
+	hsize_t *tile_start = &query->tile_starts[query->num_tiles++ * dataset->tile_rank];
+	for (uint32_t dim = 0; dim < dataset->tile_rank; dim++)
+		tile_start[dim] = tile_coords[dim] * dataset->tile_dims[dim];
+}
+
+/**
+ * @brief Lists the tiles of the dataset that may hold values in the range
+ * of the query. Tiles without a zone map hold the fill value and are listed
+ * if the range holds it, tiles with one if it overlaps the range. Only the
+ * zone maps are read, none of the tiles.
+ */
+static void parh5D_query_tiles(parh5D_dataset_t dataset, struct parh5_query_tiles_args *query)
+{
+	struct parh5D_zone_scan scan = { .lower = query->lower, .upper = query->upper, .fill_matches = true };
+	if (PARH5S_NONE != dataset->zone_type) {
+		char *zero_elem = calloc(1UL, dataset->elem_size);
+		struct parh5S_zone fill_zone;
+		parh5S_summarize_tile(dataset->zone_type, dataset->fill_tile ? dataset->fill_tile : zero_elem, 1,
+				      &fill_zone);
+		free(zero_elem);
+		scan.fill_matches = parh5S_zone_may_match(&fill_zone, query->lower, query->upper);
+		/*The zone map scan does not write tiles back, this is the single flush of the query*/
+		parh5D_flush(dataset);
+		parh5T_scan_zones(parh5F_get_tile_cache(dataset->file), dataset, parh5D_collect_zone, &scan);
+	}
+
+	uint64_t num_tiles = 1;
+	for (uint32_t dim = 0; dim < dataset->tile_rank; dim++)
+		num_tiles *= dataset->tiles_per_dim[dim];
+	size_t max_tiles = scan.fill_matches ? num_tiles : scan.num_tile_ids;
+	query->tile_starts = calloc(max_tiles * dataset->tile_rank + 1UL, sizeof(*query->tile_starts));
+	query->num_tiles = 0;
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS] = { 0 };
+	for (size_t i = 0; !scan.fill_matches && i < scan.num_tile_ids; i++) {
+		parh5D_get_tile_coords(dataset, scan.tile_ids[i], tile_coords);
+		bool inside = true;
+		/*Zone maps of tiles the dataset has shrunk away from*/
+		for (uint32_t dim = 0; dim < dataset->tile_rank; dim++)
+			inside = inside && tile_coords[dim] < dataset->tiles_per_dim[dim];
+		if (inside)
+			parh5D_add_query_tile(dataset, query, tile_coords);
+	}
+	for (uint64_t n = 0; scan.fill_matches && n < num_tiles; n++) {
+		uint64_t tile_id = parh5D_get_tile_id(dataset, tile_coords);
+		if (NULL == bsearch(&tile_id, scan.tile_ids, scan.num_tile_ids, sizeof(tile_id), parh5D_cmp_tile_ids))
+			parh5D_add_query_tile(dataset, query, tile_coords);
+		for (int dim = dataset->tile_rank - 1; dim >= 0 && ++tile_coords[dim] == dataset->tiles_per_dim[dim];
+		     dim--)
+			tile_coords[dim] = 0;
+	}
+	for (uint32_t dim = 0; dim < dataset->tile_rank; dim++)
+		query->tile_dims[dim] = dataset->tile_dims[dim];
+	free(scan.tile_ids);
+}
+
+/*A zone map an aggregation collects, with the id of its tile*/
+struct parh5D_stored_zone {
+	uint64_t tile_id;
+	struct parh5S_zone zone;
+};
+
+/**
+ * The state of an aggregation. The selection is reduced tile by tile, its
+ * elements in tiles that are not stored hold the fill value.
+ */
+struct parh5D_aggregation {
+	parh5D_dataset_t dataset;
+	struct parh5_aggregate_args *args;
+	enum parh5S_elem_type elem_type;
+	hid_t space_id; /*the selection*/
+	bool box; /*the selection is its bounding box*/
+	hsize_t sel_start[PARH5D_MAX_DIMENSIONS]; /*the bounding box of the selection*/
+	hsize_t sel_end[PARH5D_MAX_DIMENSIONS]; /*inclusive*/
+	hsize_t *blocks; /*the selected blocks of the current tile, start then end (inclusive) coordinates*/
+	size_t blocks_capacity;
+	struct parh5S_zone total;
+	hsize_t num_stored_elems; /*selected elements of the stored tiles reduced so far*/
+	struct parh5D_stored_zone *zones; /*in tile id order*/
+	size_t num_zones;
+	size_t zones_capacity;
+	uint64_t first_tile_id; /*of the tiles the bounding box touches*/
+	uint64_t last_tile_id;
+};
+
+/**
+ * @brief Sets the selection of the aggregation and its bounding box.
+ * @return the number of selected elements
+ */
+static hsize_t parh5D_set_aggregation_selection(struct parh5D_aggregation *agg, hid_t file_space_id)
+{
+	parh5D_dataset_t dataset = agg->dataset;
+	agg->space_id = H5S_ALL == file_space_id ? dataset->space_id : file_space_id;
+	int ndims = H5Sget_simple_extent_ndims(agg->space_id);
+	hssize_t num_selected = H5Sget_select_npoints(agg->space_id);
+	if (ndims < 0 || num_selected < 0) {
+		log_fatal("Failed to get the selection to aggregate of dataset %s",
+			  parh5I_get_inode_name(dataset->inode));
+		_exit(EXIT_FAILURE);
+	}
+	if (ndims > 0 && (uint32_t)ndims != dataset->tile_rank) {
+		log_fatal("Selection of rank %d does not match the rank %u of dataset %s", ndims, dataset->tile_rank,
+			  parh5I_get_inode_name(dataset->inode));
+		_exit(EXIT_FAILURE);
+	}
+	if (0 == num_selected)
+		return 0;
+
+	H5S_sel_type sel_type = H5Sget_select_type(agg->space_id);
+	if (0 == ndims || H5S_SEL_ALL == sel_type) {
+		for (uint32_t dim = 0; dim < dataset->tile_rank; dim++) {
+			agg->sel_start[dim] = 0;
+			agg->sel_end[dim] = dataset->dims[dim] - 1;
+		}
+	} else if (H5S_SEL_HYPERSLABS == sel_type) {
+		if (H5Sget_select_bounds(agg->space_id, agg->sel_start, agg->sel_end) < 0) {
+			log_fatal("Failed to get the bounds of the selection");
+			_exit(EXIT_FAILURE);
+		}
+	} else {
+		log_fatal("Only hyperslabs of dataset %s can be aggregated", parh5I_get_inode_name(dataset->inode));
+		_exit(EXIT_FAILURE);
+	}
+
+	hsize_t box_elems = 1;
+	for (uint32_t dim = 0; dim < dataset->tile_rank; dim++) {
+		if (agg->sel_end[dim] >= dataset->dims[dim]) {
+			log_fatal("Selection exceeds dimension %u of dataset %s", dim,
+				  parh5I_get_inode_name(dataset->inode));
+			_exit(EXIT_FAILURE);
+		}
+		box_elems *= agg->sel_end[dim] - agg->sel_start[dim] + 1;
+	}
+	/*A hyperslab that selects its whole bounding box is a single block*/
+	agg->box = box_elems == (hsize_t)num_selected;
+
+	hsize_t first_tile_coords[PARH5D_MAX_DIMENSIONS];
+	hsize_t last_tile_coords[PARH5D_MAX_DIMENSIONS];
+	for (uint32_t dim = 0; dim < dataset->tile_rank; dim++) {
+		first_tile_coords[dim] = agg->sel_start[dim] / dataset->tile_dims[dim];
+		last_tile_coords[dim] = agg->sel_end[dim] / dataset->tile_dims[dim];
+	}
+	/*Tile ids grow with every tile coordinate, in row-major and in Z-order*/
+	agg->first_tile_id = parh5D_get_tile_id(dataset, first_tile_coords);
+	agg->last_tile_id = parh5D_get_tile_id(dataset, last_tile_coords);
+	return num_selected;
+}
+
+/**
+ * @brief Intersects the selection with a tile, clipped to the dataset
+ * bounds, into agg->blocks.
+ * @param [out] num_elems the number of selected elements in the tile
+ * @return the number of blocks, 0 if the tile holds no selected element
+ */
+static size_t parh5D_select_in_tile(struct parh5D_aggregation *agg, const hsize_t tile_coords[], hsize_t *num_elems)
+{
+	parh5D_dataset_t dataset = agg->dataset;
+	uint32_t rank = dataset->tile_rank;
+	hsize_t start[PARH5D_MAX_DIMENSIONS];
+	hsize_t count[PARH5D_MAX_DIMENSIONS];
+	*num_elems = 0;
+	for (uint32_t dim = 0; dim < rank; dim++) {
+		hsize_t tile_start = tile_coords[dim] * dataset->tile_dims[dim];
+		hsize_t end = PARH5D_MIN(tile_start + dataset->tile_dims[dim] - 1, agg->sel_end[dim]);
+		start[dim] = tile_start > agg->sel_start[dim] ? tile_start : agg->sel_start[dim];
+		if (start[dim] > end)
+			return 0;
+		count[dim] = end - start[dim] + 1;
+	}
+
+	size_t num_blocks = 1;
+	if (!agg->box) {
+		hid_t tile_space_id = H5Scopy(agg->space_id);
+		if (tile_space_id < 0 ||
+		    H5Sselect_hyperslab(tile_space_id, H5S_SELECT_AND, start, NULL, count, NULL) < 0) {
+			log_fatal("Failed to intersect the selection with tile %lu",
+				  parh5D_get_tile_id(dataset, tile_coords));
+			_exit(EXIT_FAILURE);
+		}
+		/*Selections that miss the tile become empty, they have no blocks*/
+		hssize_t num_hyper_blocks = H5S_SEL_HYPERSLABS == H5Sget_select_type(tile_space_id) ?
+						    H5Sget_select_hyper_nblocks(tile_space_id) :
+						    0;
+		num_blocks = num_hyper_blocks > 0 ? num_hyper_blocks : 0;
+		if (2UL * rank * num_blocks > agg->blocks_capacity) {
+			agg->blocks_capacity = 2UL * rank * num_blocks;
+			agg->blocks = realloc(agg->blocks, agg->blocks_capacity * sizeof(*agg->blocks));
+		}
+		if (num_blocks && H5Sget_select_hyper_blocklist(tile_space_id, 0, num_blocks, agg->blocks) < 0) {
+			log_fatal("Failed to get the blocks of the selection in tile %lu",
+				  parh5D_get_tile_id(dataset, tile_coords));
+			_exit(EXIT_FAILURE);
+		}
+		H5Sclose(tile_space_id);
+	} else {
+		if (2UL * rank > agg->blocks_capacity) {
+			agg->blocks_capacity = 2UL * rank;
+			agg->blocks = realloc(agg->blocks, agg->blocks_capacity * sizeof(*agg->blocks));
+		}
+		for (uint32_t dim = 0; dim < rank; dim++) {
+			agg->blocks[dim] = start[dim];
+			agg->blocks[rank + dim] = start[dim] + count[dim] - 1;
+		}
+	}
+
+	for (size_t block = 0; block < num_blocks; block++) {
+		const hsize_t *block_start = &agg->blocks[2 * rank * block];
+		hsize_t block_elems = 1;
+		for (uint32_t dim = 0; dim < rank; dim++)
+			block_elems *= block_start[rank + dim] - block_start[dim] + 1;
+		*num_elems += block_elems;
+	}
+	return num_blocks;
+}
+
+static void parh5D_reduce_run(struct parh5D_aggregation *agg, const char *run, uint32_t run_len)
+{
+	struct parh5S_zone zone;
+	parh5S_summarize_tile(agg->elem_type, run, run_len, &zone);
+	parh5S_merge_zone(&agg->total, &zone);
+	parh5S_histogram(agg->elem_type, run, run_len, agg->args->hist_lower, agg->args->hist_upper,
+			 agg->args->num_bins, agg->args->histogram);
+}
+
+/**
+ * @brief Reduces the selected blocks of a tile run by run. The rows of a
+ * block that spans whole rows of the tile form a single run.
+ */
+static void parh5D_reduce_blocks(struct parh5D_aggregation *agg, const hsize_t tile_coords[], const char *tile_buf,
+				 size_t num_blocks)
+{
+	parh5D_dataset_t dataset = agg->dataset;
+	int rank = dataset->tile_rank;
+	for (size_t block = 0; block < num_blocks; block++) {
+		const hsize_t *start = &agg->blocks[2 * rank * block];
+		const hsize_t *end = &start[rank];
+		int run_dim = rank - 1;
+		hsize_t run_len = 1;
+		while (run_dim > 0 && end[run_dim] - start[run_dim] + 1 == dataset->tile_dims[run_dim])
+			run_len *= dataset->tile_dims[run_dim--];
+		run_len *= end[run_dim] - start[run_dim] + 1;
+
+		hsize_t coords[PARH5D_MAX_DIMENSIONS];
+		memcpy(coords, start, rank * sizeof(*coords));
+		int dim = 0;
+		do {
+			hsize_t offset = 0;
+			for (dim = 0; dim < rank; dim++)
+				offset = offset * dataset->tile_dims[dim] + coords[dim] -
+					 tile_coords[dim] * dataset->tile_dims[dim];
+			parh5D_reduce_run(agg, &tile_buf[offset * dataset->elem_size], run_len);
+			for (dim = run_dim - 1; dim >= 0 && ++coords[dim] > end[dim]; dim--)
+				coords[dim] = start[dim];
+		} while (dim >= 0);
+	}
+}
+
+static void parh5D_reduce_stored_tile(uint64_t tile_id, const char *tile_buf, uint32_t size, void *cb_arg)
+{
+	(void)size;
+	struct parh5D_aggregation *agg = cb_arg;
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS];
+	parh5D_get_tile_coords(agg->dataset, tile_id, tile_coords);
+	hsize_t num_elems = 0;
+	size_t num_blocks = parh5D_select_in_tile(agg, tile_coords, &num_elems);
+	parh5D_reduce_blocks(agg, tile_coords, tile_buf, num_blocks);
+	agg->num_stored_elems += num_elems;
+}
+
+static void parh5D_collect_stored_zone(uint64_t tile_id, const struct parh5S_zone *zone, void *cb_arg)
+{
+	struct parh5D_aggregation *agg = cb_arg;
+	if (tile_id < agg->first_tile_id || tile_id > agg->last_tile_id)
+		return;
+	if (agg->num_zones == agg->zones_capacity) {
+		agg->zones_capacity = agg->zones_capacity ? 2 * agg->zones_capacity : PARH5D_MIN_QUERY_TILES;
+		agg->zones = realloc(agg->zones, agg->zones_capacity * sizeof(*agg->zones));
+	}
+	agg->zones[agg->num_zones++] = (struct parh5D_stored_zone){ .tile_id = tile_id, .zone = *zone };
+}
+
+/**
+ * @brief Reduces a stored tile from its zone map if the map gives the exact
+ * answer: the tile lies within the dataset bounds, the selection covers it
+ * whole and the map tells the histogram bins of its elements.
+ * @return true if the tile is reduced, or holds no selected element, false
+ * if it has to be read
+ */
+static bool parh5D_reduce_zone(struct parh5D_aggregation *agg, const struct parh5D_stored_zone *stored)
+{
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS];
+	parh5D_get_tile_coords(agg->dataset, stored->tile_id, tile_coords);
+	hsize_t num_elems = 0;
+	if (0 == parh5D_select_in_tile(agg, tile_coords, &num_elems))
+		return true;
+	/*Edge tiles are clipped, their zone maps summarize elements beyond the dataset bounds too*/
+	if (num_elems < agg->dataset->tile_size_in_elems || !parh5S_zone_is_exact(agg->elem_type, &stored->zone))
+		return false;
+	if (!parh5S_histogram_zone(&stored->zone, agg->args->hist_lower, agg->args->hist_upper, agg->args->num_bins,
+				   agg->args->histogram))
+		return false;
+	parh5S_merge_zone(&agg->total, &stored->zone);
+	agg->num_stored_elems += num_elems;
+	return true;
+}
+
+/**
+ * @brief Reduces the tiles of the selection that are stored. Without zone
+ * maps a single scan streams them. With zone maps the tiles whose maps give
+ * the answer are not read, the scans stream the stored tiles between them.
+ * The caller flushed the dataset, none of the scans writes tiles back.
+ */
+static void parh5D_reduce_stored_tiles(struct parh5D_aggregation *agg)
+{
+	parh5D_dataset_t dataset = agg->dataset;
+	parh5T_tile_cache_t cache = parh5F_get_tile_cache(dataset->file);
+	/*Lossy tiles read back within the error bound of the values their zone maps summarize*/
+	if (PARH5S_NONE == dataset->zone_type || dataset->error_bound > 0) {
+		parh5T_scan_tiles_no_flush(cache, dataset, agg->first_tile_id, agg->last_tile_id,
+					   parh5D_reduce_stored_tile, agg);
+		return;
+	}
+
+	parh5T_scan_zones(cache, dataset, parh5D_collect_stored_zone, agg);
+	size_t run_start = agg->num_zones;
+	for (size_t i = 0; i <= agg->num_zones; i++) {
+		if (i < agg->num_zones && !parh5D_reduce_zone(agg, &agg->zones[i])) {
+			run_start = run_start < agg->num_zones ? run_start : i;
+			continue;
+		}
+		if (run_start < agg->num_zones)
+			parh5T_scan_tiles_no_flush(cache, dataset, agg->zones[run_start].tile_id,
+						   agg->zones[i - 1].tile_id, parh5D_reduce_stored_tile, agg);
+		run_start = agg->num_zones;
+	}
+}
+
+/**
+ * @brief Reduces the selected elements of the tiles that are not stored,
+ * they all hold the fill value.
+ */
+static void parh5D_reduce_fill(struct parh5D_aggregation *agg, hsize_t num_elems)
+{
+	if (0 == num_elems)
+		return;
+	parh5D_dataset_t dataset = agg->dataset;
+	struct parh5_aggregate_args *args = agg->args;
+	char *zero_elem = calloc(1UL, dataset->elem_size);
+	const char *fill_elem = dataset->fill_tile ? dataset->fill_tile : zero_elem;
+	struct parh5S_zone fill_zone;
+	parh5S_summarize_tile(agg->elem_type, fill_elem, 1, &fill_zone);
+	fill_zone.sum *= num_elems;
+	fill_zone.count *= num_elems;
+	fill_zone.null_count *= num_elems;
+	parh5S_merge_zone(&agg->total, &fill_zone);
+
+	uint64_t *fill_bins = calloc(args->num_bins + 1UL, sizeof(*fill_bins));
+	parh5S_histogram(agg->elem_type, fill_elem, 1, args->hist_lower, args->hist_upper, args->num_bins, fill_bins);
+	for (size_t bin = 0; bin < args->num_bins; bin++)
+		args->histogram[bin] += fill_bins[bin] * num_elems;
+	free(fill_bins);
+	free(zero_elem);
+}
+
+/**
+ * @brief Reduces the selected elements of the dataset into the outputs of
+ * the aggregation, streaming the stored tiles through a single tile buffer.
+ */
+static void parh5D_aggregate(parh5D_dataset_t dataset, struct parh5_aggregate_args *args)
+{
+	struct parh5D_aggregation agg = { .dataset = dataset,
+					  .args = args,
+					  .elem_type = parh5S_get_elem_type(dataset->type_id),
+					  .total = { .min = INFINITY, .max = -INFINITY } };
+	if (PARH5S_NONE == agg.elem_type) {
+		log_fatal("Dataset %s is not of native integers or floats, it cannot be aggregated",
+			  parh5I_get_inode_name(dataset->inode));
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t num_selected = parh5D_set_aggregation_selection(&agg, args->file_space_id);
+	if (num_selected > 0) {
+		parh5D_flush(dataset);
+		parh5D_reduce_stored_tiles(&agg);
+		parh5D_reduce_fill(&agg, num_selected - agg.num_stored_elems);
+	}
+
+	args->count = agg.total.count;
+	args->null_count = agg.total.null_count;
+	args->sum = agg.total.sum;
+	args->min = agg.total.count ? agg.total.min : NAN;
+	args->max = agg.total.count ? agg.total.max : NAN;
+	args->mean = agg.total.count ? agg.total.sum / agg.total.count : NAN;
+	free(agg.zones);
+	free(agg.blocks);
+}
+
+/*A bitmap value of a tile that may hold matching elements, copied out of the bitmap scan*/
+struct parh5D_tile_bitmaps {
+	uint64_t tile_id;
+	char *value;
+	uint32_t value_size;
+};
+
+/**
+ * The state of an element query. Stored tiles are matched one at a time
+ * through bitsets with a bit per element of a tile: the elements known to
+ * match and the candidates whose values have to be tested.
+ */
+struct parh5D_element_query {
+	parh5D_dataset_t dataset;
+	struct parh5_query_elements_args *args;
+	enum parh5S_elem_type elem_type;
+	double bin_lower; /*the range the bins are matched against, widened by the error bound of lossy tiles*/
+	double bin_upper;
+	size_t capacity; /*of the outputs, in elements*/
+	uint64_t *stored_tile_ids; /*in tile id order*/
+	size_t num_stored_tile_ids;
+	size_t stored_capacity;
+	struct parh5D_tile_bitmaps *bitmaps; /*in tile id order*/
+	size_t num_bitmaps;
+	size_t bitmaps_capacity;
+	uint32_t bitset_words;
+	uint64_t *hits;
+	uint64_t *candidates;
+};
+
+static void parh5D_add_query_elem(struct parh5D_element_query *query, const hsize_t coords[], const char *elem)
+{
+	struct parh5_query_elements_args *args = query->args;
+	uint32_t rank = query->dataset->tile_rank;
+	uint32_t elem_size = query->dataset->elem_size;
+	if (args->num_elems == query->capacity) {
+		query->capacity *= 2;
+		args->coords = realloc(args->coords, query->capacity * rank * sizeof(*args->coords));
+		if (args->read_values)
+			args->values = realloc(args->values, query->capacity * elem_size);
+	}
+	memcpy(&args->coords[args->num_elems * rank], coords, rank * sizeof(*coords));
+	if (args->read_values)
+		memcpy(&((char *)args->values)[args->num_elems * elem_size], elem, elem_size);
+	args->num_elems++;
+}
+
+/**
+ * @brief Adds the elements of a tile that the hits and candidates bitsets
+ * of the query set, the candidates only if their values are in range.
+ * Elements beyond the dataset bounds, in edge tiles, are left out.
+ */
+static void parh5D_match_tile_elems(uint64_t tile_id, const char *tile_buf, uint32_t size, void *cb_arg)
+{
+	(void)size;
+	struct parh5D_element_query *query = cb_arg;
+	parh5D_dataset_t dataset = query->dataset;
+	struct parh5_query_elements_args *args = query->args;
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS];
+	parh5D_get_tile_coords(dataset, tile_id, tile_coords);
+	for (uint32_t word = 0; word < query->bitset_words; word++) {
+		for (uint64_t bits = query->hits[word] | query->candidates[word]; bits; bits &= bits - 1) {
+			uint32_t bit = __builtin_ctzl(bits);
+			uint64_t elem_id = 64UL * word + bit;
+			if (elem_id >= dataset->tile_size_in_elems)
+				break;
+			/*Tiles whose matches need no test are not read unless the query returns values*/
+			const char *elem = tile_buf ? &tile_buf[elem_id * dataset->elem_size] : NULL;
+			if (query->candidates[word] & (1UL << bit)) {
+				double value = parh5B_get_elem(query->elem_type, elem);
+				if (!(value >= args->lower && value <= args->upper))
+					continue;
+			}
+			hsize_t coords[PARH5D_MAX_DIMENSIONS];
+			bool inside = true;
+			for (int dim = dataset->tile_rank - 1; dim >= 0; dim--) {
+				hsize_t tile_dim = dataset->tile_dims[dim];
+				coords[dim] = tile_coords[dim] * tile_dim + elem_id % tile_dim;
+				elem_id /= tile_dim;
+				inside = inside && coords[dim] < dataset->dims[dim];
+			}
+			if (inside)
+				parh5D_add_query_elem(query, coords, elem);
+		}
+	}
+}
+
+static void parh5D_add_stored_tile_id(struct parh5D_element_query *query, uint64_t tile_id)
+{
+	if (query->num_stored_tile_ids == query->stored_capacity) {
+		query->stored_capacity = query->stored_capacity ? 2 * query->stored_capacity : PARH5D_MIN_QUERY_TILES;
+		query->stored_tile_ids =
+			realloc(query->stored_tile_ids, query->stored_capacity * sizeof(*query->stored_tile_ids));
+	}
+	query->stored_tile_ids[query->num_stored_tile_ids++] = tile_id;
+}
+
+/**
+ * @brief Matches a stored tile of a dataset without a bitmap index, all its
+ * elements are candidates.
+ */
+static void parh5D_match_scanned_tile(uint64_t tile_id, const char *tile_buf, uint32_t size, void *cb_arg)
+{
+	struct parh5D_element_query *query = cb_arg;
+	parh5D_add_stored_tile_id(query, tile_id);
+	parh5D_match_tile_elems(tile_id, tile_buf, size, query);
+}
+
+/**
+ * @brief Collects the bitmaps of the stored tiles that may hold matching
+ * elements and lie within the dataset bounds.
+ */
+static void parh5D_collect_tile_bitmaps(uint64_t tile_id, const char *value, uint32_t value_size, void *cb_arg)
+{
+	struct parh5D_element_query *query = cb_arg;
+	parh5D_dataset_t dataset = query->dataset;
+	parh5D_add_stored_tile_id(query, tile_id);
+	if (!parh5B_tile_may_match(dataset->bitmap_index, value, value_size, query->bin_lower, query->bin_upper))
+		return;
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS];
+	parh5D_get_tile_coords(dataset, tile_id, tile_coords);
+	/*Bitmaps of tiles the dataset has shrunk away from*/
+	for (uint32_t dim = 0; dim < dataset->tile_rank; dim++) {
+		if (tile_coords[dim] >= dataset->tiles_per_dim[dim])
+			return;
+	}
+	if (query->num_bitmaps == query->bitmaps_capacity) {
+		query->bitmaps_capacity = query->bitmaps_capacity ? 2 * query->bitmaps_capacity :
+								    PARH5D_MIN_QUERY_TILES;
+		query->bitmaps = realloc(query->bitmaps, query->bitmaps_capacity * sizeof(*query->bitmaps));
+	}
+	struct parh5D_tile_bitmaps *bitmaps = &query->bitmaps[query->num_bitmaps++];
+	bitmaps->tile_id = tile_id;
+	bitmaps->value = malloc(value_size + 1UL);
+	memcpy(bitmaps->value, value, value_size);
+	bitmaps->value_size = value_size;
+}
+
+/**
+ * @brief Matches a stored tile through its bitmaps. The tile is read only
+ * if some of its elements are candidates, or the query returns values.
+ */
+static void parh5D_match_tile_bitmaps(struct parh5D_element_query *query, const struct parh5D_tile_bitmaps *bitmaps)
+{
+	parh5D_dataset_t dataset = query->dataset;
+	size_t bitset_size = query->bitset_words * sizeof(*query->hits);
+	memset(query->hits, 0x00, bitset_size);
+	memset(query->candidates, 0x00, bitset_size);
+	/*Lossy tiles read back within the error bound of the values the bitmaps bin*/
+	if (!parh5B_match_tile(dataset->bitmap_index, bitmaps->value, bitmaps->value_size, query->bin_lower,
+			       query->bin_upper, 0 == dataset->error_bound, dataset->tile_size_in_elems, query->hits,
+			       query->candidates))
+		memset(query->candidates, 0xFF, bitset_size);
+
+	bool read_tile = query->args->read_values;
+	for (uint32_t word = 0; !read_tile && word < query->bitset_words; word++)
+		read_tile = query->candidates[word] != 0;
+	if (!read_tile) {
+		parh5D_match_tile_elems(bitmaps->tile_id, NULL, 0, query);
+		return;
+	}
+	struct parh5T_tile_uuid uuid = { .dset_id = parh5I_get_inode_num(dataset->inode), .tile_id = bitmaps->tile_id };
+	parh5T_read_tile(parh5F_get_tile_cache(dataset->file), dataset, uuid, parh5D_match_tile_elems, query);
+}
+
+/**
+ * @brief Adds every element of the tiles that are not stored, they all hold
+ * the fill value, which is in range.
+ */
+static void parh5D_match_fill_tiles(struct parh5D_element_query *query)
+{
+	parh5D_dataset_t dataset = query->dataset;
+	char *zero_tile = dataset->fill_tile ? NULL : calloc(dataset->tile_size_in_elems, dataset->elem_size);
+	const char *fill_tile = dataset->fill_tile ? dataset->fill_tile : zero_tile;
+	memset(query->hits, 0xFF, query->bitset_words * sizeof(*query->hits));
+	memset(query->candidates, 0x00, query->bitset_words * sizeof(*query->candidates));
+	uint64_t num_tiles = 1;
+	for (uint32_t dim = 0; dim < dataset->tile_rank; dim++)
+		num_tiles *= dataset->tiles_per_dim[dim];
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS] = { 0 };
+	for (uint64_t n = 0; n < num_tiles; n++) {
+		uint64_t tile_id = parh5D_get_tile_id(dataset, tile_coords);
+		if (NULL == bsearch(&tile_id, query->stored_tile_ids, query->num_stored_tile_ids, sizeof(tile_id),
+				    parh5D_cmp_tile_ids))
+			parh5D_match_tile_elems(tile_id, fill_tile, 0, query);
+		for (int dim = dataset->tile_rank - 1; dim >= 0 && ++tile_coords[dim] == dataset->tiles_per_dim[dim];
+		     dim--)
+			tile_coords[dim] = 0;
+	}
+	free(zero_tile);
+}
+
+/**
+ * @brief Finds the elements of the dataset in the range of the query. With
+ * a bitmap index only the bitmaps are scanned, tiles whose bitmaps exclude
+ * the range are skipped and the elements of the bins strictly inside it
+ * match without being tested. Without one every stored tile is tested.
+ */
+static void parh5D_query_elements(parh5D_dataset_t dataset, struct parh5_query_elements_args *args)
+{
+	struct parh5D_element_query query = { .dataset = dataset,
+					       .args = args,
+					       .elem_type = parh5S_get_elem_type(dataset->type_id),
+					       .bin_lower = args->lower - dataset->error_bound,
+					       .bin_upper = args->upper + dataset->error_bound,
+					       .capacity = PARH5D_MIN_QUERY_ELEMS,
+					       .bitset_words = (dataset->tile_size_in_elems + 63) / 64 };
+	if (PARH5S_NONE == query.elem_type) {
+		log_fatal("Dataset %s is not of native integers or floats, it cannot be queried",
+			  parh5I_get_inode_name(dataset->inode));
+		_exit(EXIT_FAILURE);
+	}
+	args->num_elems = 0;
+	args->coords = malloc(query.capacity * dataset->tile_rank * sizeof(*args->coords));
+	args->values = args->read_values ? malloc(query.capacity * dataset->elem_size) : NULL;
+	query.hits = calloc(query.bitset_words, sizeof(*query.hits));
+	query.candidates = calloc(query.bitset_words, sizeof(*query.candidates));
+
+	/*The single flush of the query, the bitmap and tile scans do not write tiles back*/
+	parh5D_flush(dataset);
+	parh5T_tile_cache_t cache = parh5F_get_tile_cache(dataset->file);
+	if (dataset->bitmap_index) {
+		parh5T_scan_bitmaps(cache, dataset, parh5D_collect_tile_bitmaps, &query);
+		for (size_t i = 0; i < query.num_bitmaps; i++) {
+			parh5D_match_tile_bitmaps(&query, &query.bitmaps[i]);
+			free(query.bitmaps[i].value);
+		}
+	} else {
+		memset(query.candidates, 0xFF, query.bitset_words * sizeof(*query.candidates));
+		parh5T_scan_tiles_no_flush(cache, dataset, 0, UINT64_MAX, parh5D_match_scanned_tile, &query);
+	}
+
+	char *zero_elem = calloc(1UL, dataset->elem_size);
+	double fill_value = parh5B_get_elem(query.elem_type, dataset->fill_tile ? dataset->fill_tile : zero_elem);
+	free(zero_elem);
+	if (fill_value >= args->lower && fill_value <= args->upper)
+		parh5D_match_fill_tiles(&query);
+
+	free(query.bitmaps);
+	free(query.stored_tile_ids);
+	free(query.hits);
+	free(query.candidates);
+}
+
 herr_t parh5D_optional(void *obj, H5VL_optional_args_t *args, hid_t dxpl_id, void **req)
 {
-	(void)obj;
-	(void)args;
 	(void)dxpl_id;
+	/*Queries complete before they return, HDF5 sees no request and does not wait for one*/
 	(void)req;
-	log_fatal("Dataset: Sorry unimplemented function XXX TODO XXX");
-	_exit(EXIT_FAILURE);
-	return 1;
+	H5I_type_t *obj_type = obj;
+	if (H5I_DATASET != *obj_type) {
+		log_fatal("Object is not a dataset!");
+		_exit(EXIT_FAILURE);
+	}
+	parh5D_dataset_t dataset = obj;
+
+	switch (parh5D_get_optional_op(args->op_type)) {
+	case PARH5D_QUERY_TILES:
+		parh5D_query_tiles(dataset, args->args);
+		return PARH5_SUCCESS;
+	case PARH5D_AGGREGATE:
+		parh5D_aggregate(dataset, args->args);
+		return PARH5_SUCCESS;
+	case PARH5D_QUERY_ELEMENTS:
+		parh5D_query_elements(dataset, args->args);
+		return PARH5_SUCCESS;
+	default:
+		break;
+	}
+	log_warn("Dataset %s got unknown optional operation %d", parh5I_get_inode_name(dataset->inode),
+		 args->op_type);
+	return PARH5_FAILURE;
 }
 
 herr_t parh5D_close(void *dset, hid_t dxpl_id, void **req)
@@ -766,13 +1905,34 @@ herr_t parh5D_close(void *dset, hid_t dxpl_id, void **req)
 	//Don't worry about space, type, and dcpl. HDF5 knows about their existence
 	//since it has asked the plugin during open and cleans them up itself
 
+	/*The flush drains the put stage, which filters and bins the tiles with the pipeline and index freed below*/
+	parh5D_flush(dataset);
 	// log_debug("Closing dataset %s SUCCESS", parh5I_get_inode_name(dataset->inode));
+	parh5X_destroy_plans(dataset->plans);
+	parh5Z_destroy_pipeline(dataset->pipeline);
+	parh5B_destroy_index(dataset->bitmap_index);
+	free(dataset->fill_tile);
 	free(dataset->inode);
 	free(dataset);
 
 	return PARH5_SUCCESS;
 }
 
+struct parh5X_plans *parh5D_get_access_plans(parh5D_dataset_t dataset)
+{
+	if (NULL == dataset->plans)
+		dataset->plans = parh5X_create_plans();
+	return dataset->plans;
+}
+
+void parh5D_flush(parh5D_dataset_t dataset)
+{
+	if (NULL == dataset)
+		return;
+	parh5R_drain(parh5F_get_executor(dataset->file));
+	parh5T_flush_dataset_tiles(parh5F_get_tile_cache(dataset->file), parh5I_get_inode_num(dataset->inode));
+}
+
 const char *parh5D_get_dataset_name(parh5D_dataset_t dataset)
 {
 	return dataset ? parh5I_get_inode_name(dataset->inode) : NULL;
@@ -793,7 +1953,47 @@ inline uint32_t parh5D_get_tile_size_in_elems(parh5D_dataset_t dataset)
 	return dataset ? dataset->tile_size_in_elems : 0;
 }
 
+uint32_t parh5D_get_tile_rank(parh5D_dataset_t dataset)
+{
+	return dataset ? dataset->tile_rank : 0;
+}
+
+const hsize_t *parh5D_get_tile_dims(parh5D_dataset_t dataset)
+{
+	return dataset ? dataset->tile_dims : NULL;
+}
+
+const hsize_t *parh5D_get_dims(parh5D_dataset_t dataset)
+{
+	return dataset ? dataset->dims : NULL;
+}
+
 inline uint32_t parh5D_get_elems_size_in_bytes(parh5D_dataset_t dataset)
 {
-	return NULL == dataset ? 0 : dataset->type_id ? H5Tget_size(dataset->type_id) : 0;
+	return NULL == dataset ? 0 : dataset->elem_size;
+}
+
+uint32_t parh5D_get_delta_threshold(parh5D_dataset_t dataset)
+{
+	return dataset ? dataset->delta_threshold : 0;
+}
+
+const char *parh5D_get_fill_tile(parh5D_dataset_t dataset)
+{
+	return dataset ? dataset->fill_tile : NULL;
+}
+
+parh5Z_pipeline_t parh5D_get_pipeline(parh5D_dataset_t dataset)
+{
+	return dataset ? dataset->pipeline : NULL;
+}
+
+enum parh5S_elem_type parh5D_get_zone_type(parh5D_dataset_t dataset)
+{
+	return dataset ? dataset->zone_type : PARH5S_NONE;
+}
+
+parh5B_index_t parh5D_get_bitmap_index(parh5D_dataset_t dataset)
+{
+	return dataset ? dataset->bitmap_index : NULL;
 }
@@ -1,9 +1,15 @@
 #ifndef PARALLAX_VOL_DATASET_H
 #define PARALLAX_VOL_DATASET_H
+#include "parallax_vol_tile_cache.h"
+#include "parallax_vol_zone_map.h"
 #include <H5VLconnector.h>
+#define PARH5D_MAX_DIMENSIONS 5
 typedef struct parh5D_dataset *parh5D_dataset_t;
 typedef struct parh5I_inode *parh5I_inode_t;
 typedef struct parh5F_file *parh5F_file_t;
+typedef struct parh5Z_pipeline *parh5Z_pipeline_t;
+typedef struct parh5B_index *parh5B_index_t;
+struct parh5X_plans;
 
 /*VOL-plugin specific functions*/
 void *parh5D_create(void *obj, const H5VL_loc_params_t *loc_params, const char *name, hid_t lcpl_id, hid_t type_id,
@@ -28,4 +34,102 @@ parh5F_file_t parh5D_get_file(parh5D_dataset_t dataset);
 
 uint32_t parh5D_get_tile_size_in_elems(parh5D_dataset_t dataset);
 uint32_t parh5D_get_elems_size_in_bytes(parh5D_dataset_t dataset);
+
+/**
+ * @brief Tiles are boxes laid over the dataset. The rank of a dataset's
+ * tiles equals the rank of the dataset (1 for scalars).
+ */
+uint32_t parh5D_get_tile_rank(parh5D_dataset_t dataset);
+const hsize_t *parh5D_get_tile_dims(parh5D_dataset_t dataset);
+const hsize_t *parh5D_get_dims(parh5D_dataset_t dataset);
+
+/**
+ * @brief Returns how many delta records a tile of the dataset accumulates
+ * before they are folded into it, 0 if the dataset does not use delta
+ * updates (see PARH5_DELTA_UPDATES).
+ */
+uint32_t parh5D_get_delta_threshold(parh5D_dataset_t dataset);
+
+/**
+ * @brief Returns a tile holding the fill value of the dataset (see
+ * H5Pset_fill_value) in every element, NULL if the fill value is zero.
+ * Tiles never written read as the fill value and tiles that hold only the
+ * fill value are not stored.
+ */
+const char *parh5D_get_fill_tile(parh5D_dataset_t dataset);
+
+/**
+ * @brief Returns the filter pipeline of the dataset (see H5Pset_filter),
+ * NULL if its dcpl has no filters. Tiles pass through it on their way to
+ * and from Parallax.
+ */
+parh5Z_pipeline_t parh5D_get_pipeline(parh5D_dataset_t dataset);
+
+/**
+ * @brief Returns the element type of the zone maps the tiles of the
+ * dataset keep (see PARH5_ZONE_MAPS), PARH5S_NONE if they keep none.
+ */
+enum parh5S_elem_type parh5D_get_zone_type(parh5D_dataset_t dataset);
+
+/**
+ * @brief Returns the bins of the bitmap index the tiles of the dataset keep
+ * (see PARH5_BITMAP_INDEX), NULL if they keep none.
+ */
+parh5B_index_t parh5D_get_bitmap_index(parh5D_dataset_t dataset);
+
+/**
+ * @brief Registers the dataset optional operations of the connector
+ * (PARH5_QUERY_TILES_OP, PARH5_AGGREGATE_OP, PARH5_QUERY_ELEMENTS_OP) with
+ * HDF5, applications find them by name.
+ */
+void parh5D_register_optional_ops(void);
+void parh5D_unregister_optional_ops(void);
+
+/**
+ * @brief Returns true if op_type is a dataset optional operation of the
+ * connector.
+ */
+bool parh5D_is_optional_op(int op_type);
+
+/**
+ * @brief Returns the id of the tile at tile_coords in the tile grid. The id
+ * follows the tile order of the dataset (row-major or Z-order).
+ */
+uint64_t parh5D_get_tile_id(parh5D_dataset_t dataset, const hsize_t tile_coords[]);
+
+/**
+ * @brief Inverse of parh5D_get_tile_id.
+ */
+void parh5D_get_tile_coords(parh5D_dataset_t dataset, uint64_t tile_id, hsize_t tile_coords[]);
+
+/**
+ * @brief Returns tile metadata to access a storage element.
+ * @param dataset [in] pointer to the dataset object
+ * @param storage_elem_id id of the storage element
+ * @return a parh5D_tile object
+ */
+struct parh5T_tile parh5D_map_id2tile(parh5D_dataset_t dataset, hsize_t storage_elem_id);
+
+/**
+ * @brief Returns how many elements starting from storage_elem_id are
+ * consecutive both in the row-major order of the dataset and inside the
+ * tile that holds storage_elem_id.
+ * @param dataset [in] pointer to the dataset object
+ * @param storage_elem_id id of the storage element
+ * @return the length of the run in elements
+ */
+hsize_t parh5D_get_tile_run_len(parh5D_dataset_t dataset, hsize_t storage_elem_id);
+
+/**
+ * @brief Returns the access plans the transfers of the dataset compiled for
+ * the selection shapes they saw, creating them on first use.
+ * @param dataset [in] pointer to the dataset object
+ */
+struct parh5X_plans *parh5D_get_access_plans(parh5D_dataset_t dataset);
+
+/**
+ * @brief Writes back to Parallax the dirty tiles of the dataset's tile cache.
+ * @param dataset [in] pointer to the dataset object
+ */
+void parh5D_flush(parh5D_dataset_t dataset);
 #endif
@@ -0,0 +1,431 @@
+#include "parallax_vol_encoding.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#define PARH5E_HEADER_SIZE 1U
+/*Runs of equal elements are stored as a count followed by the element*/
+#define PARH5E_RUN_COUNT_SIZE ((uint32_t)sizeof(uint32_t))
+/*Delta encoded tiles start with the width of their deltas and the first element*/
+#define PARH5E_WIDTH_SIZE 1U
+/**
+ * Shuffled bytes are packed: a control byte below PARH5E_MAX_LITERAL is
+ * followed by control + 1 literal bytes, any other is followed by a byte
+ * repeated control - PARH5E_RUN_BASE times, 2 to PARH5E_MAX_RUN.
+ */
+#define PARH5E_MAX_LITERAL 128U
+#define PARH5E_RUN_BASE 126U
+#define PARH5E_MAX_RUN 129U
+#define PARH5E_NOT_SMALLER UINT32_MAX
+
+enum parh5E_encoding { PARH5E_RAW = 0, PARH5E_CONSTANT, PARH5E_RUNS, PARH5E_DELTA, PARH5E_SHUFFLE };
+
+/**
+ * @brief Repeats the element num_elems times in dst, doubling the filled
+ * prefix with every copy.
+ */
+static void parh5E_fill(char *dst, const char *elem, uint32_t elem_size, uint32_t num_elems)
+{
+	uint64_t size = (uint64_t)num_elems * elem_size;
+	if (0 == size)
+		return;
+	if (1 == elem_size) {
+		memset(dst, *elem, size);
+		return;
+	}
+	memcpy(dst, elem, elem_size);
+	for (uint64_t filled = elem_size; filled < size; filled *= 2)
+		memcpy(&dst[filled], dst, filled < size - filled ? filled : size - filled);
+}
+
+#define PARH5E_DEFINE_COUNT_RUNS(BITS)                                                    \
+	static uint32_t parh5E_count_runs##BITS(const char *tile_buf, uint32_t num_elems) \
+	{                                                                                 \
+		const uint##BITS##_t *elems = (const uint##BITS##_t *)tile_buf;           \
+		uint32_t num_runs = 1;                                                    \
+		for (uint32_t i = 1; i < num_elems; i++)                                  \
+			num_runs += elems[i] != elems[i - 1];                             \
+		return num_runs;                                                          \
+	}
+PARH5E_DEFINE_COUNT_RUNS(8)
+PARH5E_DEFINE_COUNT_RUNS(16)
+PARH5E_DEFINE_COUNT_RUNS(32)
+PARH5E_DEFINE_COUNT_RUNS(64)
+
+static uint32_t parh5E_count_runs(const char *tile_buf, uint32_t num_elems, uint32_t elem_size)
+{
+	switch (elem_size) {
+	case 1:
+		return parh5E_count_runs8(tile_buf, num_elems);
+	case 2:
+		return parh5E_count_runs16(tile_buf, num_elems);
+	case 4:
+		return parh5E_count_runs32(tile_buf, num_elems);
+	case 8:
+		return parh5E_count_runs64(tile_buf, num_elems);
+	default:
+		break;
+	}
+	uint32_t num_runs = 1;
+	for (uint32_t i = 1; i < num_elems; i++)
+		num_runs += 0 != memcmp(&tile_buf[(uint64_t)i * elem_size], &tile_buf[(uint64_t)(i - 1) * elem_size],
+					elem_size);
+	return num_runs;
+}
+
+static uint32_t parh5E_encode_runs(const char *tile_buf, uint32_t num_elems, uint32_t elem_size, char *payload)
+{
+	uint32_t idx = 0;
+	uint32_t start = 0;
+	while (start < num_elems) {
+		const char *elem = &tile_buf[(uint64_t)start * elem_size];
+		uint32_t end = start + 1;
+		while (end < num_elems && 0 == memcmp(&tile_buf[(uint64_t)end * elem_size], elem, elem_size))
+			end++;
+		uint32_t count = end - start;
+		memcpy(&payload[idx], &count, sizeof(count));
+		memcpy(&payload[idx + PARH5E_RUN_COUNT_SIZE], elem, elem_size);
+		idx += PARH5E_RUN_COUNT_SIZE + elem_size;
+		start = end;
+	}
+	return idx;
+}
+
+static bool parh5E_decode_runs(const char *payload, uint32_t payload_size, char *tile_buf, uint32_t num_elems,
+			       uint32_t elem_size)
+{
+	uint32_t idx = 0;
+	uint32_t num_filled = 0;
+	while ((uint64_t)idx + PARH5E_RUN_COUNT_SIZE + elem_size <= payload_size) {
+		uint32_t count = 0;
+		memcpy(&count, &payload[idx], sizeof(count));
+		if (count > num_elems - num_filled)
+			return false;
+		parh5E_fill(&tile_buf[(uint64_t)num_filled * elem_size], &payload[idx + PARH5E_RUN_COUNT_SIZE],
+			    elem_size, count);
+		num_filled += count;
+		idx += PARH5E_RUN_COUNT_SIZE + elem_size;
+	}
+	return idx == payload_size && num_filled == num_elems;
+}
+
+/**
+ * Deltas of consecutive elements are zigzag mapped, so that small negative
+ * deltas become small unsigned values, and stored in 1, 2 or 4 bytes. They
+ * wrap around, so any bit pattern, floats included, decodes exactly.
+ */
+#define PARH5E_ZIGZAG(BITS, delta)                                                                 \
+	((uint##BITS##_t)((uint##BITS##_t)((uint##BITS##_t)(delta) << 1) ^                         \
+			  (uint##BITS##_t)((int##BITS##_t)(uint##BITS##_t)(delta) >> (BITS - 1))))
+
+#define PARH5E_ENCODE_DELTAS(BITS, WTYPE)                                                     \
+	for (uint32_t i = 1; i < num_elems; i++) {                                            \
+		WTYPE zigzag = (WTYPE)PARH5E_ZIGZAG(BITS, elems[i] - elems[i - 1]);           \
+		memcpy(&deltas[(uint64_t)(i - 1) * sizeof(zigzag)], &zigzag, sizeof(zigzag)); \
+	}
+
+#define PARH5E_DECODE_DELTAS(BITS, WTYPE)                                                     \
+	for (uint32_t i = 1; i < num_elems; i++) {                                            \
+		WTYPE zigzag = 0;                                                             \
+		memcpy(&zigzag, &deltas[(uint64_t)(i - 1) * sizeof(zigzag)], sizeof(zigzag)); \
+		uint##BITS##_t sign = (uint##BITS##_t)0 - (uint##BITS##_t)(zigzag & 1U);      \
+		uint##BITS##_t delta = (uint##BITS##_t)(zigzag >> 1) ^ (uint##BITS##_t)sign;  \
+		elems[i] = (uint##BITS##_t)(elems[i - 1] + delta);                            \
+	}
+
+#define PARH5E_DEFINE_DELTA(BITS)                                                                       \
+	static uint64_t parh5E_delta_bits##BITS(const char *tile_buf, uint32_t num_elems)               \
+	{                                                                                               \
+		const uint##BITS##_t *elems = (const uint##BITS##_t *)tile_buf;                         \
+		uint##BITS##_t bits = 0;                                                                \
+		for (uint32_t i = 1; i < num_elems; i++)                                                \
+			bits |= PARH5E_ZIGZAG(BITS, elems[i] - elems[i - 1]);                           \
+		return bits;                                                                            \
+	}                                                                                               \
+                                                                                                        \
+	static void parh5E_encode_delta##BITS(const char *tile_buf, uint32_t num_elems, uint32_t width, \
+					      char *deltas)                                             \
+	{                                                                                               \
+		const uint##BITS##_t *elems = (const uint##BITS##_t *)tile_buf;                         \
+		if (1 == width) {                                                                       \
+			PARH5E_ENCODE_DELTAS(BITS, uint8_t)                                             \
+		} else if (2 == width) {                                                                \
+			PARH5E_ENCODE_DELTAS(BITS, uint16_t)                                            \
+		} else {                                                                                \
+			PARH5E_ENCODE_DELTAS(BITS, uint32_t)                                            \
+		}                                                                                       \
+	}                                                                                               \
+                                                                                                        \
+	static bool parh5E_decode_delta##BITS(const char *deltas, uint32_t num_elems, uint32_t width,   \
+					      char *tile_buf)                                           \
+	{                                                                                               \
+		uint##BITS##_t *elems = (uint##BITS##_t *)tile_buf;                                     \
+		if (width >= BITS / 8)                                                                  \
+			return false;                                                                   \
+		if (1 == width) {                                                                       \
+			PARH5E_DECODE_DELTAS(BITS, uint8_t)                                             \
+		} else if (2 == width) {                                                                \
+			PARH5E_DECODE_DELTAS(BITS, uint16_t)                                            \
+		} else if (4 == width) {                                                                \
+			PARH5E_DECODE_DELTAS(BITS, uint32_t)                                            \
+		} else                                                                                  \
+			return false;                                                                   \
+		return true;                                                                            \
+	}
+PARH5E_DEFINE_DELTA(16)
+PARH5E_DEFINE_DELTA(32)
+PARH5E_DEFINE_DELTA(64)
+
+/**
+ * @brief Returns the fewest bytes, 1, 2 or 4, that hold every delta of the
+ * tile, 0 if the deltas take as many bytes as the elements.
+ */
+static uint32_t parh5E_delta_width(const char *tile_buf, uint32_t num_elems, uint32_t elem_size)
+{
+	uint64_t bits = 0;
+	switch (elem_size) {
+	case 2:
+		bits = parh5E_delta_bits16(tile_buf, num_elems);
+		break;
+	case 4:
+		bits = parh5E_delta_bits32(tile_buf, num_elems);
+		break;
+	case 8:
+		bits = parh5E_delta_bits64(tile_buf, num_elems);
+		break;
+	default:
+		return 0;
+	}
+	uint32_t width = bits <= UINT8_MAX ? 1 : bits <= UINT16_MAX ? 2 : bits <= UINT32_MAX ? 4 : 8;
+	return width < elem_size ? width : 0;
+}
+
+static void parh5E_encode_delta(const char *tile_buf, uint32_t num_elems, uint32_t elem_size, uint32_t width,
+				char *payload)
+{
+	payload[0] = (char)width;
+	memcpy(&payload[PARH5E_WIDTH_SIZE], tile_buf, elem_size);
+	char *deltas = &payload[PARH5E_WIDTH_SIZE + elem_size];
+	if (2 == elem_size)
+		parh5E_encode_delta16(tile_buf, num_elems, width, deltas);
+	else if (4 == elem_size)
+		parh5E_encode_delta32(tile_buf, num_elems, width, deltas);
+	else
+		parh5E_encode_delta64(tile_buf, num_elems, width, deltas);
+}
+
+static bool parh5E_decode_delta(const char *payload, uint32_t payload_size, char *tile_buf, uint32_t num_elems,
+				uint32_t elem_size)
+{
+	if (payload_size < PARH5E_WIDTH_SIZE + elem_size)
+		return false;
+	uint32_t width = (uint8_t)payload[0];
+	if (payload_size != PARH5E_WIDTH_SIZE + elem_size + (uint64_t)(num_elems - 1) * width)
+		return false;
+	memcpy(tile_buf, &payload[PARH5E_WIDTH_SIZE], elem_size);
+	const char *deltas = &payload[PARH5E_WIDTH_SIZE + elem_size];
+	switch (elem_size) {
+	case 2:
+		return parh5E_decode_delta16(deltas, num_elems, width, tile_buf);
+	case 4:
+		return parh5E_decode_delta32(deltas, num_elems, width, tile_buf);
+	case 8:
+		return parh5E_decode_delta64(deltas, num_elems, width, tile_buf);
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief Packs src into dst collapsing runs of equal bytes.
+ * @return the packed size, PARH5E_NOT_SMALLER if it exceeds dst_size
+ */
+static uint32_t parh5E_pack_bytes(const uint8_t *src, uint32_t size, uint8_t *dst, uint32_t dst_size)
+{
+	uint32_t out = 0;
+	uint32_t i = 0;
+	while (i < size) {
+		uint32_t run = 1;
+		while (i + run < size && run < PARH5E_MAX_RUN && src[i + run] == src[i])
+			run++;
+		if (run > 1) {
+			if (out + 2 > dst_size)
+				return PARH5E_NOT_SMALLER;
+			dst[out++] = (uint8_t)(run + PARH5E_RUN_BASE);
+			dst[out++] = src[i];
+			i += run;
+			continue;
+		}
+		/*A literal ends where three equal bytes start, shorter runs cost as much as literals*/
+		uint32_t len = 1;
+		while (i + len < size && len < PARH5E_MAX_LITERAL &&
+		       !(i + len + 2 < size && src[i + len] == src[i + len + 1] && src[i + len] == src[i + len + 2]))
+			len++;
+		if (out + 1 + len > dst_size)
+			return PARH5E_NOT_SMALLER;
+		dst[out++] = (uint8_t)(len - 1);
+		memcpy(&dst[out], &src[i], len);
+		out += len;
+		i += len;
+	}
+	return out;
+}
+
+static bool parh5E_unpack_bytes(const uint8_t *src, uint32_t src_size, uint8_t *dst, uint32_t dst_size)
+{
+	uint32_t in = 0;
+	uint32_t out = 0;
+	while (in < src_size) {
+		uint32_t control = src[in++];
+		if (control < PARH5E_MAX_LITERAL) {
+			uint32_t len = control + 1;
+			if (in + len > src_size || out + len > dst_size)
+				return false;
+			memcpy(&dst[out], &src[in], len);
+			in += len;
+			out += len;
+			continue;
+		}
+		uint32_t len = control - PARH5E_RUN_BASE;
+		if (in >= src_size || out + len > dst_size)
+			return false;
+		memset(&dst[out], src[in++], len);
+		out += len;
+	}
+	return out == dst_size;
+}
+
+/**
+ * @brief Byte shuffle: the first bytes of all elements, then the second
+ * bytes and so on, each group packed. Elements that share their high bytes,
+ * e.g. small integers in wide types or floats of similar magnitude, leave
+ * long runs behind.
+ * @return the size of the payload, PARH5E_NOT_SMALLER if it exceeds limit
+ */
+static uint32_t parh5E_encode_shuffle(const char *tile_buf, uint32_t num_elems, uint32_t elem_size, char *payload,
+				      uint32_t limit)
+{
+	uint8_t *plane = malloc(num_elems);
+	uint32_t idx = 0;
+	for (uint32_t byte = 0; byte < elem_size && PARH5E_NOT_SMALLER != idx; byte++) {
+		for (uint32_t i = 0; i < num_elems; i++)
+			plane[i] = tile_buf[(uint64_t)i * elem_size + byte];
+		uint32_t size = parh5E_pack_bytes(plane, num_elems, (uint8_t *)&payload[idx], limit - idx);
+		idx = PARH5E_NOT_SMALLER == size ? PARH5E_NOT_SMALLER : idx + size;
+	}
+	free(plane);
+	return idx;
+}
+
+/*The element size is a constant in each call, the compiler unrolls the inner loop*/
+static inline void parh5E_unshuffle(const uint8_t *restrict planes, uint8_t *restrict tile_buf, uint32_t num_elems,
+				    uint32_t elem_size)
+{
+	for (uint32_t i = 0; i < num_elems; i++) {
+		for (uint32_t byte = 0; byte < elem_size; byte++)
+			tile_buf[(uint64_t)i * elem_size + byte] = planes[(uint64_t)byte * num_elems + i];
+	}
+}
+
+static bool parh5E_decode_shuffle(const char *payload, uint32_t payload_size, char *tile_buf, uint32_t num_elems,
+				  uint32_t elem_size)
+{
+	uint32_t tile_size_in_bytes = num_elems * elem_size;
+	uint8_t *planes = malloc(tile_size_in_bytes);
+	bool success = parh5E_unpack_bytes((const uint8_t *)payload, payload_size, planes, tile_size_in_bytes);
+	if (!success) {
+		free(planes);
+		return false;
+	}
+	switch (elem_size) {
+	case 2:
+		parh5E_unshuffle(planes, (uint8_t *)tile_buf, num_elems, 2);
+		break;
+	case 4:
+		parh5E_unshuffle(planes, (uint8_t *)tile_buf, num_elems, 4);
+		break;
+	case 8:
+		parh5E_unshuffle(planes, (uint8_t *)tile_buf, num_elems, 8);
+		break;
+	default:
+		parh5E_unshuffle(planes, (uint8_t *)tile_buf, num_elems, elem_size);
+	}
+	free(planes);
+	return true;
+}
+
+char *parh5E_encode_tile(const char *tile_buf, uint32_t tile_size_in_bytes, uint32_t elem_size, uint32_t extra_bytes,
+			 uint32_t *encoded_size)
+{
+	uint32_t num_elems = tile_size_in_bytes / elem_size;
+	char *encoded = malloc(PARH5E_HEADER_SIZE + tile_size_in_bytes + extra_bytes);
+	char *payload = &encoded[PARH5E_HEADER_SIZE];
+	if (0 == memcmp(tile_buf, &tile_buf[elem_size], tile_size_in_bytes - elem_size)) {
+		encoded[0] = PARH5E_CONSTANT;
+		memcpy(payload, tile_buf, elem_size);
+		*encoded_size = PARH5E_HEADER_SIZE + elem_size;
+		return encoded;
+	}
+
+	/*The sizes of runs and deltas are known without encoding*/
+	enum parh5E_encoding encoding = PARH5E_RAW;
+	uint64_t payload_size = tile_size_in_bytes;
+	uint64_t runs_size = (uint64_t)parh5E_count_runs(tile_buf, num_elems, elem_size) *
+			     (PARH5E_RUN_COUNT_SIZE + elem_size);
+	if (runs_size < payload_size) {
+		encoding = PARH5E_RUNS;
+		payload_size = runs_size;
+	}
+	uint32_t width = parh5E_delta_width(tile_buf, num_elems, elem_size);
+	uint64_t delta_size = PARH5E_WIDTH_SIZE + elem_size + (uint64_t)(num_elems - 1) * width;
+	if (width && delta_size < payload_size) {
+		encoding = PARH5E_DELTA;
+		payload_size = delta_size;
+	}
+	/*Shuffling is tried last and given up as soon as it is not smaller*/
+	uint32_t shuffle_size = PARH5E_NOT_SMALLER;
+	if (elem_size > 1)
+		shuffle_size = parh5E_encode_shuffle(tile_buf, num_elems, elem_size, payload, payload_size - 1);
+	if (PARH5E_NOT_SMALLER != shuffle_size) {
+		encoding = PARH5E_SHUFFLE;
+		payload_size = shuffle_size;
+	} else if (PARH5E_RUNS == encoding)
+		parh5E_encode_runs(tile_buf, num_elems, elem_size, payload);
+	else if (PARH5E_DELTA == encoding)
+		parh5E_encode_delta(tile_buf, num_elems, elem_size, width, payload);
+	else
+		memcpy(payload, tile_buf, tile_size_in_bytes);
+	encoded[0] = (char)encoding;
+	*encoded_size = PARH5E_HEADER_SIZE + payload_size;
+	return encoded;
+}
+
+bool parh5E_decode_tile(const char *encoded, uint32_t encoded_size, char *tile_buf, uint32_t tile_size_in_bytes,
+			uint32_t elem_size)
+{
+	if (encoded_size < PARH5E_HEADER_SIZE || 0 == elem_size || tile_size_in_bytes % elem_size)
+		return false;
+	const char *payload = &encoded[PARH5E_HEADER_SIZE];
+	uint32_t payload_size = encoded_size - PARH5E_HEADER_SIZE;
+	uint32_t num_elems = tile_size_in_bytes / elem_size;
+	switch ((uint8_t)encoded[0]) {
+	case PARH5E_RAW:
+		if (payload_size != tile_size_in_bytes)
+			return false;
+		memcpy(tile_buf, payload, tile_size_in_bytes);
+		return true;
+	case PARH5E_CONSTANT:
+		if (payload_size != elem_size)
+			return false;
+		parh5E_fill(tile_buf, payload, elem_size, num_elems);
+		return true;
+	case PARH5E_RUNS:
+		return parh5E_decode_runs(payload, payload_size, tile_buf, num_elems, elem_size);
+	case PARH5E_DELTA:
+		return parh5E_decode_delta(payload, payload_size, tile_buf, num_elems, elem_size);
+	case PARH5E_SHUFFLE:
+		return parh5E_decode_shuffle(payload, payload_size, tile_buf, num_elems, elem_size);
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef PARALLAX_VOL_ENCODING_H
+#define PARALLAX_VOL_ENCODING_H
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Encodes a tile for Parallax. It picks, per tile, the smallest of a
+ * raw copy, a single value for constant tiles, runs of equal elements,
+ * deltas of consecutive elements narrowed to the fewest bytes that hold
+ * them, and the bytes of the elements grouped by position (byte shuffle)
+ * with runs of equal bytes collapsed. The first byte of the result names
+ * the encoding.
+ * @param [in] tile_buf the tile
+ * @param [in] tile_size_in_bytes the size of the tile, a multiple of
+ * elem_size
+ * @param [in] elem_size the size of the elements of the tile
+ * @param [in] extra_bytes room the caller wants after the encoded tile
+ * @param [out] encoded_size the size of the encoded tile, extra_bytes not
+ * included
+ * @return the encoded tile, the caller frees it
+ */
+char *parh5E_encode_tile(const char *tile_buf, uint32_t tile_size_in_bytes, uint32_t elem_size, uint32_t extra_bytes,
+			 uint32_t *encoded_size);
+
+/**
+ * @brief Inverse of parh5E_encode_tile.
+ * @param [in] encoded the encoded tile
+ * @param [in] encoded_size its size
+ * @param [out] tile_buf where to decode the tile
+ * @param [in] tile_size_in_bytes the size of the tile
+ * @param [in] elem_size the size of the elements of the tile
+ * @return true on success false if encoded is not a tile of that size
+ */
+bool parh5E_decode_tile(const char *encoded, uint32_t encoded_size, char *tile_buf, uint32_t tile_size_in_bytes,
+			uint32_t elem_size);
+#endif
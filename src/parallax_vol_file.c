@@ -5,6 +5,7 @@
 #include "parallax_vol_connector.h"
 #include "parallax_vol_group.h"
 #include "parallax_vol_inode.h"
+#include "parallax_vol_request.h"
 #include "uthash.h"
 #include <H5Fpublic.h>
 #include <H5Ipublic.h>
@@ -21,12 +22,17 @@
 #include <unistd.h>
 typedef struct parh5G_group *parh5G_group_t;
 
+#define PARH5F_DEFAULT_TILE_CACHE_SIZE (1024UL * 1024)
+
 struct parh5F_file {
 	H5I_type_t obj_type;
 	const char *name;
 	parh5G_group_t root_group;
 	par_handle db;
 	unsigned int flags; /*READ ONLY, RDWR etc*/
+	parh5T_tile_cache_t tile_cache; /*shared by all datasets of the file*/
+	parh5W_pool_t workers; /*shared by all datasets of the file*/
+	parh5R_executor_t executor; /*runs the asynchronous reads and writes of the file*/
 };
 extern const char *parh5_volume;
 
@@ -74,6 +80,42 @@ inline par_handle parh5F_get_parallax_db(parh5F_file_t file)
 	return file ? file->db : NULL;
 }
 
+/**
+ * @brief Returns the memory budget of the file's tile cache. It is the raw
+ * data chunk cache size of the file access property list.
+ */
+static uint64_t parh5F_get_tile_cache_size(hid_t fapl_id)
+{
+	int mdc_nelmts = 0;
+	size_t rdcc_nslots = 0;
+	size_t rdcc_nbytes = 0;
+	double rdcc_w0 = 0;
+	if (fapl_id <= 0 || H5Pget_cache(fapl_id, &mdc_nelmts, &rdcc_nslots, &rdcc_nbytes, &rdcc_w0) < 0)
+		return PARH5F_DEFAULT_TILE_CACHE_SIZE;
+	return rdcc_nbytes;
+}
+
+/**
+ * @brief Returns the number of transfer threads the application asked for
+ * through the PARH5_TRANSFER_THREADS property of the fapl or the environment,
+ * 1 if it asked for none.
+ */
+static uint32_t parh5F_get_num_transfer_threads(hid_t fapl_id)
+{
+	unsigned int num_threads = 1;
+	if (fapl_id > 0 && H5Pexist(fapl_id, PARH5_TRANSFER_THREADS) > 0) {
+		if (H5Pget(fapl_id, PARH5_TRANSFER_THREADS, &num_threads) < 0) {
+			log_fatal("Failed to get property %s", PARH5_TRANSFER_THREADS);
+			_exit(EXIT_FAILURE);
+		}
+		return num_threads;
+	}
+	const char *env_threads = getenv(PARALLAX_TRANSFER_THREADS_ENV_VAR);
+	if (env_threads)
+		num_threads = strtoul(env_threads, NULL, 10);
+	return num_threads;
+}
+
 static parh5F_file_t parh5F_new_file(const char *file_name, enum par_db_initializers open_flag, hid_t fapl_id,
 				     hid_t fcpl_id, unsigned int flags)
 {
@@ -98,6 +140,9 @@ static parh5F_file_t parh5F_new_file(const char *file_name, enum par_db_initiali
 		_exit(EXIT_FAILURE);
 	}
 	file->name = strdup(file_name);
+	file->tile_cache = parh5T_init_tile_cache(file->db, parh5F_get_tile_cache_size(fapl_id));
+	file->workers = parh5W_create_pool(parh5F_get_num_transfer_threads(fapl_id));
+	file->executor = parh5R_create_executor();
 
 	/*Check it the root inode exists*/
 	parh5I_inode_t root_inode = parh5I_get_inode(file->db, 1);
@@ -366,7 +411,8 @@ herr_t parh5F_get(void *obj, H5VL_file_get_args_t *fquery, hid_t dxpl_id, void *
 
 static void parh5F_handle_file_flush(parh5F_file_t file, H5VL_file_specific_args_t *file_query)
 {
-	log_warn("Flush of file: %s not implemented yet XXX TODO XXX", file->name);
+	parh5R_drain(file->executor);
+	parh5T_flush_tile_cache(file->tile_cache);
 	switch (file_query->args.flush.obj_type) {
 	case H5I_UNINIT:
 	case H5I_BADID:
@@ -446,8 +492,26 @@ herr_t parh5F_close(void *file, hid_t dxpl_id, void **req)
 	// parh5G_group_t root_group = parh5F_get_root_group(file);
 	// parh5G_close(root_group, 0, NULL);
 	// log_debug("Closing file: %s....SUCCESS", par_file->name);
+	parh5R_destroy_executor(par_file->executor);
+	parh5W_destroy_pool(par_file->workers);
+	parh5T_destroy_tile_cache(par_file->tile_cache);
 	free((char *)par_file->name);
 	free(par_file);
 
 	return PARH5_SUCCESS;
 }
+
+parh5T_tile_cache_t parh5F_get_tile_cache(parh5F_file_t file)
+{
+	return file ? file->tile_cache : NULL;
+}
+
+parh5W_pool_t parh5F_get_workers(parh5F_file_t file)
+{
+	return file ? file->workers : NULL;
+}
+
+parh5R_executor_t parh5F_get_executor(parh5F_file_t file)
+{
+	return file ? file->executor : NULL;
+}
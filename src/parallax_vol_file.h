@@ -1,6 +1,9 @@
 #ifndef PARALLAX_VOL_FILE_H
 #define PARALLAX_VOL_FILE_H
 #include "parallax_vol_group.h"
+#include "parallax_vol_request.h"
+#include "parallax_vol_tile_cache.h"
+#include "parallax_vol_workers.h"
 #include <H5VLconnector.h>
 #include <parallax/structures.h>
 typedef struct parh5G_group *parh5G_group_t;
@@ -20,4 +23,21 @@ par_handle parh5F_get_parallax_db(parh5F_file_t file);
 
 parh5G_group_t parh5F_get_root_group(parh5F_file_t file);
 
+/**
+ * @brief Returns the tile cache that the datasets of the file share.
+ */
+parh5T_tile_cache_t parh5F_get_tile_cache(parh5F_file_t file);
+
+/**
+ * @brief Returns the worker pool that the transfers of the file fan their
+ * tiles out to.
+ */
+parh5W_pool_t parh5F_get_workers(parh5F_file_t file);
+
+/**
+ * @brief Returns the executor that runs the asynchronous reads and writes
+ * of the file.
+ */
+parh5R_executor_t parh5F_get_executor(parh5F_file_t file);
+
 #endif
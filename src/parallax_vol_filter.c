@@ -0,0 +1,435 @@
+#include "parallax_vol_filter.h"
+#include "parallax_vol_lossy.h"
+#include <dirent.h>
+#include <dlfcn.h>
+#include <endian.h>
+#include <hdf5.h>
+#include <limits.h>
+#include <log.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+/*The filter mask that precedes the filtered bytes*/
+#define PARH5Z_HEADER_SIZE ((uint32_t)sizeof(uint32_t))
+#define PARH5Z_MAX_CD_VALUES 32UL
+#define PARH5Z_FLETCHER32_SIZE ((uint32_t)sizeof(uint32_t))
+/*The lossy stage is not an HDF5 filter, its id is one no HDF5 filter can have and only shows in messages*/
+#define PARH5Z_FILTER_LOSSY ((H5Z_filter_t)(H5Z_FILTER_MAX + 1))
+/*Element size, the two halves of the error bound and the row size of the tiles*/
+#define PARH5Z_LOSSY_CD_NELMTS 4UL
+
+typedef H5PL_type_t (*parh5Z_plugin_type_fn)(void);
+typedef const void *(*parh5Z_plugin_info_fn)(void);
+
+struct parh5Z_filter {
+	H5Z_filter_t id;
+	unsigned int flags;
+	size_t cd_nelmts;
+	unsigned int cd_values[PARH5Z_MAX_CD_VALUES];
+	H5Z_func_t func;
+};
+
+struct parh5Z_pipeline {
+	uint32_t num_filters;
+	/*The lossy stage, when there is one, comes first*/
+	struct parh5Z_filter filters[H5Z_MAX_NFILTERS];
+};
+
+/*Filter plugins found in the plugin paths, loaded once and kept for the lifetime of the process*/
+struct parh5Z_plugin {
+	const H5Z_class2_t *filter_class;
+	struct parh5Z_plugin *next;
+};
+
+static pthread_mutex_t parh5Z_plugins_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct parh5Z_plugin *parh5Z_plugins;
+static bool parh5Z_plugins_loaded;
+
+/**
+ * The filters below run on the threads of the connector, concurrently with
+ * the application and without the HDF5 lock, so they do not call into
+ * HDF5. Their buffers come from malloc, which H5allocate_memory is as well
+ * outside of memory debugging builds.
+ */
+
+static size_t parh5Z_deflate(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[], size_t nbytes,
+			     size_t *buf_size, void **buf)
+{
+	if (flags & H5Z_FLAG_REVERSE) {
+		size_t out_size = *buf_size > nbytes ? *buf_size : 2 * nbytes;
+		unsigned char *out = malloc(out_size);
+		z_stream stream = { .next_in = *buf, .avail_in = (uInt)nbytes };
+		if (Z_OK != inflateInit(&stream)) {
+			free(out);
+			return 0;
+		}
+		int status = Z_OK;
+		do {
+			if (stream.total_out == out_size) {
+				out_size *= 2;
+				out = realloc(out, out_size);
+			}
+			stream.next_out = &out[stream.total_out];
+			stream.avail_out = (uInt)(out_size - stream.total_out);
+			status = inflate(&stream, Z_NO_FLUSH);
+		} while (Z_OK == status || (Z_BUF_ERROR == status && 0 == stream.avail_out));
+		inflateEnd(&stream);
+		if (Z_STREAM_END != status) {
+			free(out);
+			return 0;
+		}
+		free(*buf);
+		*buf = out;
+		*buf_size = out_size;
+		return stream.total_out;
+	}
+
+	/*Like HDF5, data that does not shrink fails the filter, deflate is optional and gets skipped*/
+	int level = cd_nelmts > 0 ? (int)cd_values[0] : Z_DEFAULT_COMPRESSION;
+	uLongf out_size = nbytes;
+	unsigned char *out = malloc(nbytes);
+	if (Z_OK != compress2(out, &out_size, *buf, nbytes, level)) {
+		free(out);
+		return 0;
+	}
+	free(*buf);
+	*buf = out;
+	*buf_size = nbytes;
+	return out_size;
+}
+
+static herr_t parh5Z_set_shuffle_local(hid_t dcpl_id, hid_t type_id, hid_t space_id)
+{
+	(void)space_id;
+	unsigned int flags = 0;
+	unsigned int cd_values[PARH5Z_MAX_CD_VALUES];
+	size_t cd_nelmts = PARH5Z_MAX_CD_VALUES;
+	if (H5Pget_filter_by_id2(dcpl_id, H5Z_FILTER_SHUFFLE, &flags, &cd_nelmts, cd_values, 0, NULL, NULL) < 0)
+		return -1;
+	unsigned int elem_size = (unsigned int)H5Tget_size(type_id);
+	return H5Pmodify_filter(dcpl_id, H5Z_FILTER_SHUFFLE, flags, 1, &elem_size);
+}
+
+/*The first bytes of all elements, then the second bytes and so on, trailing bytes stay in place*/
+static size_t parh5Z_shuffle(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[], size_t nbytes,
+			     size_t *buf_size, void **buf)
+{
+	size_t elem_size = cd_nelmts > 0 ? cd_values[0] : 1;
+	size_t num_elems = elem_size > 0 ? nbytes / elem_size : 0;
+	if (elem_size <= 1 || num_elems <= 1)
+		return nbytes;
+	const unsigned char *in = *buf;
+	unsigned char *out = malloc(nbytes);
+	for (size_t byte = 0; byte < elem_size; byte++) {
+		for (size_t i = 0; i < num_elems; i++) {
+			if (flags & H5Z_FLAG_REVERSE)
+				out[i * elem_size + byte] = in[byte * num_elems + i];
+			else
+				out[byte * num_elems + i] = in[i * elem_size + byte];
+		}
+	}
+	memcpy(&out[num_elems * elem_size], &in[num_elems * elem_size], nbytes - num_elems * elem_size);
+	free(*buf);
+	*buf = out;
+	*buf_size = nbytes;
+	return nbytes;
+}
+
+/*The Fletcher checksum of HDF5, over 16-bit big-endian words*/
+static uint32_t parh5Z_checksum_fletcher32(const unsigned char *data, size_t size)
+{
+	uint32_t sum1 = 0;
+	uint32_t sum2 = 0;
+	for (size_t num_words = size / 2; num_words > 0;) {
+		/*360 words keep the sums from overflowing between reductions*/
+		size_t batch = num_words > 360 ? 360 : num_words;
+		num_words -= batch;
+		for (; batch > 0; batch--, data += 2) {
+			sum1 += (uint32_t)data[0] << 8 | data[1];
+			sum2 += sum1;
+		}
+		sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+		sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+	}
+	if (size % 2) {
+		sum1 += (uint32_t)data[0] << 8;
+		sum2 += sum1;
+		sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+		sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+	}
+	sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+	sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+	return sum2 << 16 | sum1;
+}
+
+/*Appends the checksum little-endian, reading verifies and drops it*/
+static size_t parh5Z_fletcher32(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[], size_t nbytes,
+				size_t *buf_size, void **buf)
+{
+	(void)cd_nelmts;
+	(void)cd_values;
+	if (flags & H5Z_FLAG_REVERSE) {
+		if (nbytes < PARH5Z_FLETCHER32_SIZE)
+			return 0;
+		size_t size = nbytes - PARH5Z_FLETCHER32_SIZE;
+		uint32_t stored = 0;
+		memcpy(&stored, &((const unsigned char *)*buf)[size], sizeof(stored));
+		return le32toh(stored) == parh5Z_checksum_fletcher32(*buf, size) ? size : 0;
+	}
+	if (*buf_size < nbytes + PARH5Z_FLETCHER32_SIZE) {
+		*buf_size = nbytes + PARH5Z_FLETCHER32_SIZE;
+		*buf = realloc(*buf, *buf_size);
+	}
+	uint32_t checksum = htole32(parh5Z_checksum_fletcher32(*buf, nbytes));
+	memcpy(&((unsigned char *)*buf)[nbytes], &checksum, sizeof(checksum));
+	return nbytes + PARH5Z_FLETCHER32_SIZE;
+}
+
+/*Runs parh5Q on a tile, it is mandatory and runs whether the tile shrinks or not*/
+static size_t parh5Z_lossy(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[], size_t nbytes,
+			   size_t *buf_size, void **buf)
+{
+	if (cd_nelmts < PARH5Z_LOSSY_CD_NELMTS || nbytes > UINT32_MAX)
+		return 0;
+	uint32_t elem_size = cd_values[0];
+	uint32_t row_size = cd_values[3];
+	uint64_t error_bound_bits = (uint64_t)cd_values[2] << 32 | cd_values[1];
+	double error_bound = 0;
+	memcpy(&error_bound, &error_bound_bits, sizeof(error_bound));
+	uint32_t size = 0;
+	char *out = (flags & H5Z_FLAG_REVERSE) ?
+			    parh5Q_decompress_tile(*buf, (uint32_t)nbytes, elem_size, row_size, error_bound, &size) :
+			    parh5Q_compress_tile(*buf, (uint32_t)nbytes, elem_size, row_size, error_bound, &size);
+	if (NULL == out)
+		return 0;
+	free(*buf);
+	*buf = out;
+	*buf_size = size;
+	return size;
+}
+
+static const H5Z_class2_t parh5Z_builtin_filters[] = {
+	{ .version = H5Z_CLASS_T_VERS,
+	  .id = H5Z_FILTER_DEFLATE,
+	  .encoder_present = 1,
+	  .decoder_present = 1,
+	  .name = "deflate",
+	  .filter = parh5Z_deflate },
+	{ .version = H5Z_CLASS_T_VERS,
+	  .id = H5Z_FILTER_SHUFFLE,
+	  .encoder_present = 1,
+	  .decoder_present = 1,
+	  .name = "shuffle",
+	  .set_local = parh5Z_set_shuffle_local,
+	  .filter = parh5Z_shuffle },
+	{ .version = H5Z_CLASS_T_VERS,
+	  .id = H5Z_FILTER_FLETCHER32,
+	  .encoder_present = 1,
+	  .decoder_present = 1,
+	  .name = "fletcher32",
+	  .filter = parh5Z_fletcher32 },
+};
+
+/**
+ * @brief Keeps the library at path if it is an HDF5 filter plugin. The
+ * library of the connector sits in the plugin path too, it is a VOL plugin
+ * and is skipped like every other plugin that is not a filter.
+ */
+static void parh5Z_load_plugin(const char *path)
+{
+	void *handle = dlopen(path, RTLD_LAZY | RTLD_LOCAL);
+	if (NULL == handle)
+		return;
+	parh5Z_plugin_type_fn get_plugin_type = NULL;
+	parh5Z_plugin_info_fn get_plugin_info = NULL;
+	/*ISO C has no conversion from object to function pointers, POSIX guarantees this one*/
+	*(void **)(&get_plugin_type) = dlsym(handle, "H5PLget_plugin_type");
+	*(void **)(&get_plugin_info) = dlsym(handle, "H5PLget_plugin_info");
+	const H5Z_class2_t *filter_class = NULL;
+	if (get_plugin_type && get_plugin_info && H5PL_TYPE_FILTER == get_plugin_type())
+		filter_class = get_plugin_info();
+	if (NULL == filter_class || H5Z_CLASS_T_VERS != filter_class->version || NULL == filter_class->filter) {
+		dlclose(handle);
+		return;
+	}
+	struct parh5Z_plugin *plugin = calloc(1UL, sizeof(*plugin));
+	plugin->filter_class = filter_class;
+	plugin->next = parh5Z_plugins;
+	parh5Z_plugins = plugin;
+	log_debug("Loaded filter %d (%s) from %s", filter_class->id, filter_class->name, path);
+}
+
+static void parh5Z_load_plugins(void)
+{
+	unsigned int num_paths = 0;
+	if (H5PLsize(&num_paths) < 0)
+		return;
+	for (unsigned int i = 0; i < num_paths; i++) {
+		ssize_t path_size = H5PLget(i, NULL, 0);
+		if (path_size <= 0)
+			continue;
+		char *dir_path = calloc(1UL, path_size + 1UL);
+		H5PLget(i, dir_path, path_size + 1UL);
+		DIR *dir = opendir(dir_path);
+		for (struct dirent *dir_entry = dir ? readdir(dir) : NULL; dir_entry; dir_entry = readdir(dir)) {
+			if ('.' == dir_entry->d_name[0])
+				continue;
+			char path[PATH_MAX];
+			if (snprintf(path, sizeof(path), "%s/%s", dir_path, dir_entry->d_name) < (int)sizeof(path))
+				parh5Z_load_plugin(path);
+		}
+		if (dir)
+			closedir(dir);
+		free(dir_path);
+	}
+}
+
+static const H5Z_class2_t *parh5Z_find_filter(H5Z_filter_t id)
+{
+	for (size_t i = 0; i < sizeof(parh5Z_builtin_filters) / sizeof(parh5Z_builtin_filters[0]); i++) {
+		if (id == parh5Z_builtin_filters[i].id)
+			return &parh5Z_builtin_filters[i];
+	}
+	pthread_mutex_lock(&parh5Z_plugins_lock);
+	if (!parh5Z_plugins_loaded) {
+		parh5Z_load_plugins();
+		parh5Z_plugins_loaded = true;
+	}
+	const H5Z_class2_t *filter_class = NULL;
+	for (struct parh5Z_plugin *plugin = parh5Z_plugins; plugin && NULL == filter_class; plugin = plugin->next) {
+		if (id == plugin->filter_class->id)
+			filter_class = plugin->filter_class;
+	}
+	pthread_mutex_unlock(&parh5Z_plugins_lock);
+	return filter_class;
+}
+
+parh5Z_pipeline_t parh5Z_create_pipeline(hid_t dcpl_id, hid_t type_id, uint32_t rank, const hsize_t tile_dims[],
+					 double error_bound, const char *dataset_name)
+{
+	int num_filters = H5Pget_nfilters(dcpl_id);
+	if (num_filters <= 0 && error_bound <= 0)
+		return NULL;
+	parh5Z_pipeline_t pipeline = calloc(1UL, sizeof(*pipeline));
+	if (error_bound > 0) {
+		struct parh5Z_filter *filter = &pipeline->filters[pipeline->num_filters++];
+		uint64_t error_bound_bits = 0;
+		memcpy(&error_bound_bits, &error_bound, sizeof(error_bound_bits));
+		filter->id = PARH5Z_FILTER_LOSSY;
+		filter->flags = H5Z_FLAG_MANDATORY;
+		filter->cd_nelmts = PARH5Z_LOSSY_CD_NELMTS;
+		filter->cd_values[0] = (unsigned int)H5Tget_size(type_id);
+		filter->cd_values[1] = (unsigned int)(error_bound_bits & UINT32_MAX);
+		filter->cd_values[2] = (unsigned int)(error_bound_bits >> 32);
+		filter->cd_values[3] = rank > 0 ? (unsigned int)tile_dims[rank - 1] : 1;
+		filter->func = parh5Z_lossy;
+	}
+
+	/*set_local callbacks tune the parameters of their filter to the dataset, on a copy of the dcpl*/
+	hid_t local_dcpl_id = H5Pcopy(dcpl_id);
+	hid_t tile_space_id = H5Screate_simple((int)rank, tile_dims, NULL);
+	for (int idx = 0; idx < num_filters && pipeline->num_filters < H5Z_MAX_NFILTERS; idx++) {
+		unsigned int flags = 0;
+		size_t cd_nelmts = 0;
+		H5Z_filter_t id = H5Pget_filter2(dcpl_id, (unsigned int)idx, &flags, &cd_nelmts, NULL, 0, NULL, NULL);
+		const H5Z_class2_t *filter_class = id < 0 ? NULL : parh5Z_find_filter(id);
+		if (filter_class && filter_class->can_apply &&
+		    filter_class->can_apply(local_dcpl_id, type_id, tile_space_id) <= 0)
+			filter_class = NULL;
+		if (filter_class && filter_class->set_local &&
+		    filter_class->set_local(local_dcpl_id, type_id, tile_space_id) < 0)
+			filter_class = NULL;
+		if (NULL == filter_class && (flags & H5Z_FLAG_OPTIONAL)) {
+			log_warn("Optional filter %d of dataset %s is not available, tiles are stored without it", id,
+				 dataset_name);
+			continue;
+		}
+		if (NULL == filter_class) {
+			log_fatal("Filter %d of dataset %s is not available", id, dataset_name);
+			_exit(EXIT_FAILURE);
+		}
+
+		struct parh5Z_filter *filter = &pipeline->filters[pipeline->num_filters++];
+		filter->id = id;
+		filter->cd_nelmts = PARH5Z_MAX_CD_VALUES;
+		if (H5Pget_filter_by_id2(local_dcpl_id, id, &filter->flags, &filter->cd_nelmts, filter->cd_values, 0,
+					 NULL, NULL) < 0 ||
+		    filter->cd_nelmts > PARH5Z_MAX_CD_VALUES) {
+			log_fatal("Failed to get the parameters of filter %d of dataset %s", id, dataset_name);
+			_exit(EXIT_FAILURE);
+		}
+		filter->func = filter_class->filter;
+	}
+	H5Sclose(tile_space_id);
+	H5Pclose(local_dcpl_id);
+	if (0 == pipeline->num_filters) {
+		free(pipeline);
+		return NULL;
+	}
+	return pipeline;
+}
+
+char *parh5Z_filter_tile(parh5Z_pipeline_t pipeline, const char *tile_buf, uint32_t tile_size_in_bytes,
+			 uint32_t extra_bytes, uint32_t *filtered_size)
+{
+	size_t buf_size = tile_size_in_bytes;
+	void *buf = malloc(buf_size);
+	memcpy(buf, tile_buf, tile_size_in_bytes);
+	size_t nbytes = tile_size_in_bytes;
+	uint32_t filter_mask = 0;
+	for (uint32_t i = 0; i < pipeline->num_filters; i++) {
+		struct parh5Z_filter *filter = &pipeline->filters[i];
+		size_t filtered_nbytes =
+			filter->func(filter->flags, filter->cd_nelmts, filter->cd_values, nbytes, &buf_size, &buf);
+		if (filtered_nbytes > 0) {
+			nbytes = filtered_nbytes;
+			continue;
+		}
+		if (!(filter->flags & H5Z_FLAG_OPTIONAL)) {
+			log_fatal("Filter %d failed on a tile", filter->id);
+			_exit(EXIT_FAILURE);
+		}
+		filter_mask |= 1U << i;
+	}
+
+	char *filtered = malloc(PARH5Z_HEADER_SIZE + nbytes + extra_bytes);
+	memcpy(filtered, &filter_mask, sizeof(filter_mask));
+	memcpy(&filtered[PARH5Z_HEADER_SIZE], buf, nbytes);
+	free(buf);
+	*filtered_size = PARH5Z_HEADER_SIZE + (uint32_t)nbytes;
+	return filtered;
+}
+
+bool parh5Z_unfilter_tile(parh5Z_pipeline_t pipeline, const char *filtered, uint32_t filtered_size, char *tile_buf,
+			  uint32_t tile_size_in_bytes)
+{
+	if (filtered_size < PARH5Z_HEADER_SIZE)
+		return false;
+	uint32_t filter_mask = 0;
+	memcpy(&filter_mask, filtered, sizeof(filter_mask));
+	size_t nbytes = filtered_size - PARH5Z_HEADER_SIZE;
+	/*Filters grow the buffer as they need, starting at the tile size spares most of them a realloc*/
+	size_t buf_size = nbytes > tile_size_in_bytes ? nbytes : tile_size_in_bytes;
+	void *buf = malloc(buf_size);
+	memcpy(buf, &filtered[PARH5Z_HEADER_SIZE], nbytes);
+	for (uint32_t i = pipeline->num_filters; i-- > 0 && nbytes > 0;) {
+		struct parh5Z_filter *filter = &pipeline->filters[i];
+		if (filter_mask & (1U << i))
+			continue;
+		nbytes = filter->func(filter->flags | H5Z_FLAG_REVERSE, filter->cd_nelmts, filter->cd_values, nbytes,
+				      &buf_size, &buf);
+	}
+	bool success = nbytes == tile_size_in_bytes;
+	if (success)
+		memcpy(tile_buf, buf, tile_size_in_bytes);
+	free(buf);
+	return success;
+}
+
+void parh5Z_destroy_pipeline(parh5Z_pipeline_t pipeline)
+{
+	free(pipeline);
+}
@@ -0,0 +1,58 @@
+#ifndef PARALLAX_VOL_FILTER_H
+#define PARALLAX_VOL_FILTER_H
+#include <H5Ipublic.h>
+#include <H5public.h>
+#include <stdbool.h>
+#include <stdint.h>
+typedef struct parh5Z_pipeline *parh5Z_pipeline_t;
+
+/**
+ * @brief Builds the filter pipeline of a dataset from the filters of its
+ * dcpl, the way HDF5 sets it up for the chunks of a dataset. Deflate,
+ * shuffle and fletcher32 are built in, other filters are looked up in the
+ * plugin paths of HDF5 (H5PLget). Optional filters that are not available
+ * are left out, a mandatory one that is not is fatal. Datasets with an
+ * error bound get the lossy codec of parh5Q ahead of their filters, which
+ * then run on its output.
+ * @param [in] dcpl_id the dataset creation property list
+ * @param [in] type_id the datatype of the dataset
+ * @param [in] rank the rank of the tiles
+ * @param [in] tile_dims the dimensions of the tiles
+ * @param [in] error_bound the absolute error bound of float and double
+ * datasets, 0 to keep tiles exact
+ * @param [in] dataset_name for error messages
+ * @return the pipeline, NULL if the dcpl has no filters and there is no
+ * error bound
+ */
+parh5Z_pipeline_t parh5Z_create_pipeline(hid_t dcpl_id, hid_t type_id, uint32_t rank, const hsize_t tile_dims[],
+					 double error_bound, const char *dataset_name);
+
+/**
+ * @brief Runs a tile through the filters of the pipeline, in dcpl order. The
+ * result starts with the mask of the optional filters that failed and were
+ * skipped, like the filter mask HDF5 keeps per chunk, followed by the
+ * filtered bytes.
+ * @param [in] pipeline the pipeline of the dataset
+ * @param [in] tile_buf the tile
+ * @param [in] tile_size_in_bytes its size
+ * @param [in] extra_bytes room the caller wants after the filtered tile
+ * @param [out] filtered_size the size of the result, extra_bytes not
+ * included
+ * @return the filtered tile, the caller frees it
+ */
+char *parh5Z_filter_tile(parh5Z_pipeline_t pipeline, const char *tile_buf, uint32_t tile_size_in_bytes,
+			 uint32_t extra_bytes, uint32_t *filtered_size);
+
+/**
+ * @brief Inverse of parh5Z_filter_tile, the filters run in reverse order.
+ * @return true on success false if a filter fails, e.g. a checksum does not
+ * match, or the result is not a tile of tile_size_in_bytes
+ */
+bool parh5Z_unfilter_tile(parh5Z_pipeline_t pipeline, const char *filtered, uint32_t filtered_size, char *tile_buf,
+			  uint32_t tile_size_in_bytes);
+
+/**
+ * @brief Frees the pipeline, pipeline may be NULL.
+ */
+void parh5Z_destroy_pipeline(parh5Z_pipeline_t pipeline);
+#endif
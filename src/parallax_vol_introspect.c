@@ -1,5 +1,6 @@
 #include "parallax_vol_introspect.h"
 #include "parallax_vol_connector.h"
+#include "parallax_vol_dataset.h"
 #include <H5Ipublic.h>
 #include <H5VLconnector.h>
 #include <log.h>
@@ -42,7 +43,9 @@ herr_t parh5_get_conn_cls(void *obj, H5VL_get_conn_lvl_t lvl, const struct H5VL_
 herr_t parh5_get_cap_flags(const void *info, uint64_t *cap_flags)
 {
 	(void)info;
-	(void)cap_flags;
+	/*Dataset reads and writes return requests that complete in the background*/
+	if (cap_flags)
+		*cap_flags = H5VL_CAP_FLAG_ASYNC;
 	fprintf(stderr, "PAR_INTROSPECT_class from function: %s, in file: %s, and line: %d\n", __func__, __FILE__,
 		__LINE__);
 	return 1;
@@ -50,7 +53,6 @@ herr_t parh5_get_cap_flags(const void *info, uint64_t *cap_flags)
 
 herr_t parh5_opt_query(void *obj, H5VL_subclass_t cls, int opt_type, uint64_t *supported)
 {
-	(void)cls;
 	log_debug("HDF5 is examing PARALLAX VOL plugin capabilities...");
 	if (!obj) {
 		log_warn("obj not provided!");
@@ -62,6 +64,17 @@ herr_t parh5_opt_query(void *obj, H5VL_subclass_t cls, int opt_type, uint64_t *s
 		return PARH5_FAILURE;
 	}
 
+	/**
+	 * Optional operations of the connector have op_types HDF5 assigns at
+	 * registration. They read tiles, write the dirty ones back to Parallax
+	 * first and complete before they return.
+	 */
+	if (H5VL_SUBCLS_DATASET == cls && parh5D_is_optional_op(opt_type)) {
+		*supported = PARH5_OPT_QUERY_SUPPORTED | PARH5_OPT_QUERY_READ_DATA | PARH5_OPT_QUERY_MODIFY_METADATA |
+			     PARH5_OPT_QUERY_NO_ASYNC;
+		return PARH5_SUCCESS;
+	}
+
 	/* Check operation type */
 	switch (opt_type) {
 	case H5VL_MAP_CREATE:
@@ -0,0 +1,193 @@
+#include "parallax_vol_lossy.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+/*Number of elements, whether the codes are deflated and their size before deflating*/
+#define PARH5Q_HEADER_SIZE (2 * sizeof(uint32_t) + sizeof(uint8_t))
+#define PARH5Q_MAX_VARINT_SIZE 5UL
+/*Differences of more quantization steps than this are stored exactly, their codes fit in 32 bits*/
+#define PARH5Q_MAX_STEPS 1073741824.0
+/*Code of an element stored exactly, the code of q steps is its zigzag plus one*/
+#define PARH5Q_EXACT_CODE 0U
+
+static uint32_t parh5Q_put_varint(unsigned char *stream, uint32_t value)
+{
+	uint32_t size = 0;
+	for (; value >= 0x80; value >>= 7)
+		stream[size++] = (unsigned char)(value | 0x80);
+	stream[size++] = (unsigned char)value;
+	return size;
+}
+
+static bool parh5Q_get_varint(const unsigned char *stream, uint32_t stream_size, uint32_t *pos, uint32_t *value)
+{
+	*value = 0;
+	for (uint32_t shift = 0; shift < 7 * PARH5Q_MAX_VARINT_SIZE && *pos < stream_size; shift += 7) {
+		unsigned char byte = stream[(*pos)++];
+		*value |= (uint32_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Elements are predicted from their reconstructed neighbours in the tile,
+ * taken as rows of row_size elements: the one before, the one above and the
+ * one above that (the Lorenzo predictor), missing neighbours count as 0 and
+ * so do NaNs and infinities. Encoder and decoder reconstruct an element from
+ * the same neighbours with the same operations, so the decoder lands on the
+ * value the encoder checked against the bound.
+ */
+#define PARH5Q_DEFINE_CODEC(TYPE)                                                                                     \
+	static double parh5Q_neighbour_##TYPE(const TYPE *reconstructed, uint32_t idx)                                \
+	{                                                                                                             \
+		return isfinite(reconstructed[idx]) ? (double)reconstructed[idx] : 0;                                 \
+	}                                                                                                             \
+                                                                                                                      \
+	static double parh5Q_predict_##TYPE(const TYPE *reconstructed, uint32_t idx, uint32_t row_size)               \
+	{                                                                                                             \
+		bool has_left = idx % row_size > 0;                                                                   \
+		bool has_up = idx >= row_size;                                                                        \
+		double left = has_left ? parh5Q_neighbour_##TYPE(reconstructed, idx - 1) : 0;                         \
+		double up = has_up ? parh5Q_neighbour_##TYPE(reconstructed, idx - row_size) : 0;                      \
+		double up_left = has_left && has_up ? parh5Q_neighbour_##TYPE(reconstructed, idx - row_size - 1) : 0; \
+		return left + up - up_left;                                                                           \
+	}                                                                                                             \
+                                                                                                                      \
+	static TYPE parh5Q_reconstruct_##TYPE(double prediction, int64_t steps, double step)                          \
+	{                                                                                                             \
+		double delta = (double)steps * step;                                                                  \
+		return (TYPE)(prediction + delta);                                                                    \
+	}                                                                                                             \
+                                                                                                                      \
+	static uint32_t parh5Q_quantize_##TYPE(const char *tile_buf, uint32_t num_elems, uint32_t row_size,           \
+					       double error_bound, unsigned char *stream)                             \
+	{                                                                                                             \
+		double step = 2 * error_bound;                                                                        \
+		TYPE *reconstructed = malloc(num_elems * sizeof(TYPE) + 1UL);                                         \
+		uint32_t stream_size = 0;                                                                             \
+		for (uint32_t i = 0; i < num_elems; i++) {                                                            \
+			TYPE value;                                                                                   \
+			memcpy(&value, &tile_buf[i * sizeof(TYPE)], sizeof(TYPE));                                    \
+			double prediction = parh5Q_predict_##TYPE(reconstructed, i, row_size);                        \
+			double steps = ((double)value - prediction) / step;                                           \
+			if (isfinite(steps) && fabs(steps) < PARH5Q_MAX_STEPS) {                                      \
+				int64_t quantized = llround(steps);                                                   \
+				uint32_t zigzag = (uint32_t)(quantized < 0 ? -2 * quantized - 1 : 2 * quantized);     \
+				reconstructed[i] = parh5Q_reconstruct_##TYPE(prediction, quantized, step);            \
+				if (fabs((double)value - (double)reconstructed[i]) <= error_bound) {                  \
+					stream_size += parh5Q_put_varint(&stream[stream_size], zigzag + 1);           \
+					continue;                                                                     \
+				}                                                                                     \
+			}                                                                                             \
+			stream[stream_size++] = PARH5Q_EXACT_CODE;                                                    \
+			memcpy(&stream[stream_size], &value, sizeof(TYPE));                                           \
+			stream_size += sizeof(TYPE);                                                                  \
+			reconstructed[i] = value;                                                                     \
+		}                                                                                                     \
+		free(reconstructed);                                                                                  \
+		return stream_size;                                                                                   \
+	}                                                                                                             \
+                                                                                                                      \
+	static bool parh5Q_dequantize_##TYPE(const unsigned char *stream, uint32_t stream_size, uint32_t row_size,    \
+					     double error_bound, char *tile_buf, uint32_t num_elems)                  \
+	{                                                                                                             \
+		double step = 2 * error_bound;                                                                        \
+		TYPE *reconstructed = (TYPE *)tile_buf;                                                               \
+		uint32_t pos = 0;                                                                                     \
+		for (uint32_t i = 0; i < num_elems; i++) {                                                            \
+			uint32_t code = 0;                                                                            \
+			if (!parh5Q_get_varint(stream, stream_size, &pos, &code))                                     \
+				return false;                                                                         \
+			if (PARH5Q_EXACT_CODE == code) {                                                              \
+				if (stream_size - pos < sizeof(TYPE))                                                 \
+					return false;                                                                 \
+				memcpy(&reconstructed[i], &stream[pos], sizeof(TYPE));                                \
+				pos += sizeof(TYPE);                                                                  \
+				continue;                                                                             \
+			}                                                                                             \
+			uint32_t zigzag = code - 1;                                                                   \
+			int64_t quantized = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1U);                         \
+			double prediction = parh5Q_predict_##TYPE(reconstructed, i, row_size);                        \
+			reconstructed[i] = parh5Q_reconstruct_##TYPE(prediction, quantized, step);                    \
+		}                                                                                                     \
+		return pos == stream_size;                                                                            \
+	}
+
+PARH5Q_DEFINE_CODEC(float)
+PARH5Q_DEFINE_CODEC(double)
+
+char *parh5Q_compress_tile(const char *tile_buf, uint32_t tile_size_in_bytes, uint32_t elem_size, uint32_t row_size,
+			   double error_bound, uint32_t *compressed_size)
+{
+	uint32_t num_elems = tile_size_in_bytes / elem_size;
+	row_size = row_size > 0 && row_size < num_elems ? row_size : num_elems;
+	unsigned char *stream = malloc(num_elems * (PARH5Q_MAX_VARINT_SIZE + elem_size) + 1UL);
+	uint32_t stream_size = sizeof(float) == elem_size ?
+				       parh5Q_quantize_float(tile_buf, num_elems, row_size, error_bound, stream) :
+				       parh5Q_quantize_double(tile_buf, num_elems, row_size, error_bound, stream);
+
+	/*Codes of smooth data are mostly the same few bytes, deflating them is where most of the gain comes from*/
+	uLongf deflated_size = compressBound(stream_size);
+	char *compressed = malloc(PARH5Q_HEADER_SIZE + deflated_size);
+	uint8_t deflated = Z_OK == compress2((unsigned char *)&compressed[PARH5Q_HEADER_SIZE], &deflated_size, stream,
+					     stream_size, Z_BEST_SPEED) &&
+			   deflated_size < stream_size;
+	if (!deflated) {
+		memcpy(&compressed[PARH5Q_HEADER_SIZE], stream, stream_size);
+		deflated_size = stream_size;
+	}
+	free(stream);
+	memcpy(compressed, &num_elems, sizeof(num_elems));
+	memcpy(&compressed[sizeof(num_elems)], &stream_size, sizeof(stream_size));
+	memcpy(&compressed[2 * sizeof(uint32_t)], &deflated, sizeof(deflated));
+	*compressed_size = PARH5Q_HEADER_SIZE + (uint32_t)deflated_size;
+	return compressed;
+}
+
+char *parh5Q_decompress_tile(const char *compressed, uint32_t compressed_size, uint32_t elem_size, uint32_t row_size,
+			     double error_bound, uint32_t *tile_size_in_bytes)
+{
+	if (compressed_size < PARH5Q_HEADER_SIZE)
+		return NULL;
+	uint32_t num_elems = 0;
+	uint32_t stream_size = 0;
+	uint8_t deflated = 0;
+	memcpy(&num_elems, compressed, sizeof(num_elems));
+	memcpy(&stream_size, &compressed[sizeof(num_elems)], sizeof(stream_size));
+	memcpy(&deflated, &compressed[2 * sizeof(uint32_t)], sizeof(deflated));
+	if ((uint64_t)num_elems * elem_size > UINT32_MAX ||
+	    stream_size > (uint64_t)num_elems * (PARH5Q_MAX_VARINT_SIZE + elem_size))
+		return NULL;
+	row_size = row_size > 0 && row_size < num_elems ? row_size : num_elems;
+
+	const unsigned char *stream = (const unsigned char *)&compressed[PARH5Q_HEADER_SIZE];
+	unsigned char *inflated = NULL;
+	if (deflated) {
+		uLongf inflated_size = stream_size;
+		inflated = malloc(stream_size + 1UL);
+		if (Z_OK != uncompress(inflated, &inflated_size, stream, compressed_size - PARH5Q_HEADER_SIZE) ||
+		    inflated_size != stream_size) {
+			free(inflated);
+			return NULL;
+		}
+		stream = inflated;
+	} else if (compressed_size - PARH5Q_HEADER_SIZE != stream_size)
+		return NULL;
+
+	char *tile_buf = malloc(num_elems * elem_size + 1UL);
+	bool success = false;
+	if (sizeof(float) == elem_size)
+		success = parh5Q_dequantize_float(stream, stream_size, row_size, error_bound, tile_buf, num_elems);
+	else
+		success = parh5Q_dequantize_double(stream, stream_size, row_size, error_bound, tile_buf, num_elems);
+	free(inflated);
+	if (!success) {
+		free(tile_buf);
+		return NULL;
+	}
+	*tile_size_in_bytes = num_elems * elem_size;
+	return tile_buf;
+}
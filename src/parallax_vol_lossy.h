@@ -0,0 +1,34 @@
+#ifndef PARALLAX_VOL_LOSSY_H
+#define PARALLAX_VOL_LOSSY_H
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Compresses a tile of floats or doubles so that every element reads
+ * back within error_bound of its value, in the manner of SZ. Each element
+ * is predicted from its reconstructed neighbours in the tile and the
+ * difference is quantized in steps of twice the bound; the quantization
+ * codes of smooth data are small and repeat, they are stored as varints and
+ * deflated. Elements the prediction misses by far, NaNs and infinities are
+ * stored exactly.
+ * @param [in] tile_buf the tile
+ * @param [in] tile_size_in_bytes its size, a multiple of elem_size
+ * @param [in] elem_size 4 for floats, 8 for doubles
+ * @param [in] row_size the number of elements along the last dimension of
+ * the tile, the neighbours of an element are the ones before it in its row
+ * and the previous row
+ * @param [in] error_bound the absolute error allowed, greater than 0
+ * @param [out] compressed_size the size of the result
+ * @return the compressed tile, the caller frees it
+ */
+char *parh5Q_compress_tile(const char *tile_buf, uint32_t tile_size_in_bytes, uint32_t elem_size, uint32_t row_size,
+			   double error_bound, uint32_t *compressed_size);
+
+/**
+ * @brief Inverse of parh5Q_compress_tile.
+ * @param [out] tile_size_in_bytes the size of the tile
+ * @return the tile, the caller frees it, NULL if compressed is corrupt
+ */
+char *parh5Q_decompress_tile(const char *compressed, uint32_t compressed_size, uint32_t elem_size, uint32_t row_size,
+			     double error_bound, uint32_t *tile_size_in_bytes);
+#endif
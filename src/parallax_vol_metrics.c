@@ -14,7 +14,11 @@ struct parh5M_metrics {
 	uint64_t dset_metadata_bytes_written;
 	uint64_t dset_cache_misses;
 	uint64_t dset_cache_hits;
+	uint64_t dset_cache_evictions;
 	uint64_t dset_partially_written_tiles;
+	uint64_t dset_delta_records;
+	uint64_t dset_consolidated_tiles;
+	uint64_t dset_fill_tiles;
 	uint64_t group_bytes_read;
 	uint64_t group_read_ops;
 	uint64_t group_bytes_written;
@@ -60,6 +64,12 @@ void parh5M_inc_cache_miss(parh5D_dataset_t dataset)
 	__sync_fetch_and_add(&parallax_metrics.dset_cache_misses, 1);
 }
 
+void parh5M_inc_cache_evictions(parh5D_dataset_t dataset)
+{
+	(void)dataset;
+	__sync_fetch_and_add(&parallax_metrics.dset_cache_evictions, 1);
+}
+
 void parh5M_inc_dset_metadata_bytes_read(parh5D_dataset_t dataset, uint64_t num_bytes)
 {
 	(void)dataset;
@@ -94,6 +104,24 @@ void parh5M_inc_dset_partially_written_tile(parh5D_dataset_t dataset)
 	__sync_fetch_and_add(&parallax_metrics.dset_partially_written_tiles, 1);
 }
 
+void parh5M_inc_dset_delta_records(parh5D_dataset_t dataset)
+{
+	(void)dataset;
+	__sync_fetch_and_add(&parallax_metrics.dset_delta_records, 1);
+}
+
+void parh5M_inc_dset_consolidated_tiles(parh5D_dataset_t dataset)
+{
+	(void)dataset;
+	__sync_fetch_and_add(&parallax_metrics.dset_consolidated_tiles, 1);
+}
+
+void parh5M_inc_dset_fill_tiles(parh5D_dataset_t dataset)
+{
+	(void)dataset;
+	__sync_fetch_and_add(&parallax_metrics.dset_fill_tiles, 1);
+}
+
 const char *parh5M_dump_report(void)
 {
 	char *report = calloc(1UL, 8192);
@@ -106,9 +134,16 @@ const char *parh5M_dump_report(void)
 	idx += snprintf(&report[idx], remaining, "Dataset cache hit ratio: %lf\n",
 			(double)parallax_metrics.dset_cache_hits /
 				(parallax_metrics.dset_cache_hits + parallax_metrics.dset_cache_misses));
+	idx += snprintf(&report[idx], remaining, "Dataset cache evictions: %lu\n", parallax_metrics.dset_cache_evictions);
 	//
 	idx += snprintf(&report[idx], remaining, "Dataset partially written tiles: %lu\n",
 			parallax_metrics.dset_partially_written_tiles);
+	idx += snprintf(&report[idx], remaining, "Dataset delta records written: %lu\n",
+			parallax_metrics.dset_delta_records);
+	idx += snprintf(&report[idx], remaining, "Dataset consolidated tiles: %lu\n",
+			parallax_metrics.dset_consolidated_tiles);
+	idx += snprintf(&report[idx], remaining, "Dataset fill tiles not stored: %lu\n",
+			parallax_metrics.dset_fill_tiles);
 	idx += snprintf(&report[idx], remaining, "Dataset bytes written: %lu\n", parallax_metrics.dset_bytes_written);
 	idx += snprintf(&report[idx], remaining, "Dataset tiles written: %lu\n", parallax_metrics.dset_write_ntiles);
 	//
@@ -22,9 +22,17 @@ void parh5M_inc_cache_hits(parh5D_dataset_t dataset);
 
 void parh5M_inc_cache_miss(parh5D_dataset_t dataset);
 
+void parh5M_inc_cache_evictions(parh5D_dataset_t dataset);
+
 void parh5M_inc_dset_metadata_bytes_written(parh5D_dataset_t dataset, uint64_t num_bytes);
 
 const char *parh5M_dump_report(void);
 
 void parh5M_inc_dset_partially_written_tile(parh5D_dataset_t dataset);
+
+void parh5M_inc_dset_delta_records(parh5D_dataset_t dataset);
+
+void parh5M_inc_dset_consolidated_tiles(parh5D_dataset_t dataset);
+
+void parh5M_inc_dset_fill_tiles(parh5D_dataset_t dataset);
 #endif
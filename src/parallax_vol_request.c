@@ -0,0 +1,244 @@
+#include "parallax_vol_request.h"
+#include "parallax_vol_connector.h"
+#include <errno.h>
+#include <log.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+/*The timeout of H5ES_WAIT_FOREVER*/
+#define PARH5R_WAIT_FOREVER UINT64_MAX
+#define PARH5R_NSEC_PER_SEC 1000000000UL
+
+struct parh5R_request {
+	struct parh5R_executor *executor;
+	struct parh5R_request *next; /*in the queue of the executor*/
+	parh5R_run_fn run_fn;
+	parh5R_cleanup_fn cleanup_fn;
+	void *arg;
+	H5VL_request_status_t status;
+	bool running;
+	H5VL_request_notify_t notify_cb; /*called once the request completes*/
+	void *notify_ctx;
+};
+
+struct parh5R_executor {
+	pthread_mutex_t lock; /*guards the executor and the status of its requests*/
+	pthread_cond_t request_queued; /*a new request or the shutdown*/
+	pthread_cond_t request_done; /*a request completed or was canceled*/
+	pthread_t thread;
+	bool started;
+	bool shutdown;
+	bool destroyed; /*the file is closed, the last request to be freed frees the executor*/
+	struct parh5R_request *head;
+	struct parh5R_request *tail;
+	uint64_t num_pending; /*queued or running*/
+	uint64_t num_requests; /*not freed by HDF5 yet*/
+};
+
+static void parh5R_free_executor(struct parh5R_executor *executor)
+{
+	pthread_cond_destroy(&executor->request_done);
+	pthread_cond_destroy(&executor->request_queued);
+	pthread_mutex_destroy(&executor->lock);
+	free(executor);
+}
+
+static void *parh5R_executor_main(void *thread_arg)
+{
+	struct parh5R_executor *executor = thread_arg;
+	pthread_mutex_lock(&executor->lock);
+	for (;;) {
+		while (!executor->shutdown && NULL == executor->head)
+			pthread_cond_wait(&executor->request_queued, &executor->lock);
+		if (NULL == executor->head)
+			break;
+		struct parh5R_request *request = executor->head;
+		executor->head = request->next;
+		if (NULL == executor->head)
+			executor->tail = NULL;
+		request->running = true;
+		pthread_mutex_unlock(&executor->lock);
+
+		request->run_fn(request->arg);
+
+		pthread_mutex_lock(&executor->lock);
+		request->running = false;
+		request->status = H5VL_REQUEST_STATUS_SUCCEED;
+		H5VL_request_notify_t notify_cb = request->notify_cb;
+		void *notify_ctx = request->notify_ctx;
+		--executor->num_pending;
+		pthread_cond_broadcast(&executor->request_done);
+		if (NULL == notify_cb)
+			continue;
+		/*The callback may free the request*/
+		pthread_mutex_unlock(&executor->lock);
+		notify_cb(notify_ctx, H5VL_REQUEST_STATUS_SUCCEED);
+		pthread_mutex_lock(&executor->lock);
+	}
+	pthread_mutex_unlock(&executor->lock);
+	return NULL;
+}
+
+parh5R_executor_t parh5R_create_executor(void)
+{
+	parh5R_executor_t executor = calloc(1UL, sizeof(*executor));
+	pthread_mutex_init(&executor->lock, NULL);
+	pthread_cond_init(&executor->request_queued, NULL);
+	pthread_cond_init(&executor->request_done, NULL);
+	return executor;
+}
+
+parh5R_request_t parh5R_submit(parh5R_executor_t executor, parh5R_run_fn run_fn, parh5R_cleanup_fn cleanup_fn,
+			       void *arg)
+{
+	parh5R_request_t request = calloc(1UL, sizeof(*request));
+	request->executor = executor;
+	request->run_fn = run_fn;
+	request->cleanup_fn = cleanup_fn;
+	request->arg = arg;
+	request->status = H5VL_REQUEST_STATUS_IN_PROGRESS;
+
+	pthread_mutex_lock(&executor->lock);
+	if (!executor->started) {
+		if (pthread_create(&executor->thread, NULL, parh5R_executor_main, executor)) {
+			log_fatal("Failed to start the request thread");
+			_exit(EXIT_FAILURE);
+		}
+		executor->started = true;
+	}
+	if (executor->tail)
+		executor->tail->next = request;
+	else
+		executor->head = request;
+	executor->tail = request;
+	++executor->num_pending;
+	++executor->num_requests;
+	pthread_cond_signal(&executor->request_queued);
+	pthread_mutex_unlock(&executor->lock);
+	return request;
+}
+
+void parh5R_drain(parh5R_executor_t executor)
+{
+	if (NULL == executor)
+		return;
+	pthread_mutex_lock(&executor->lock);
+	while (executor->num_pending)
+		pthread_cond_wait(&executor->request_done, &executor->lock);
+	pthread_mutex_unlock(&executor->lock);
+}
+
+void parh5R_destroy_executor(parh5R_executor_t executor)
+{
+	if (NULL == executor)
+		return;
+	parh5R_drain(executor);
+	pthread_mutex_lock(&executor->lock);
+	executor->shutdown = true;
+	pthread_cond_signal(&executor->request_queued);
+	pthread_mutex_unlock(&executor->lock);
+	if (executor->started)
+		pthread_join(executor->thread, NULL);
+
+	pthread_mutex_lock(&executor->lock);
+	executor->destroyed = true;
+	bool unused = 0 == executor->num_requests;
+	pthread_mutex_unlock(&executor->lock);
+	if (unused)
+		parh5R_free_executor(executor);
+}
+
+herr_t parh5R_wait(void *req, uint64_t timeout, H5VL_request_status_t *status)
+{
+	parh5R_request_t request = req;
+	struct parh5R_executor *executor = request->executor;
+	struct timespec deadline = { 0 };
+	if (PARH5R_WAIT_FOREVER != timeout) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		uint64_t nsec = deadline.tv_nsec + timeout % PARH5R_NSEC_PER_SEC;
+		deadline.tv_sec += timeout / PARH5R_NSEC_PER_SEC + nsec / PARH5R_NSEC_PER_SEC;
+		deadline.tv_nsec = nsec % PARH5R_NSEC_PER_SEC;
+	}
+
+	pthread_mutex_lock(&executor->lock);
+	while (H5VL_REQUEST_STATUS_IN_PROGRESS == request->status) {
+		if (PARH5R_WAIT_FOREVER == timeout)
+			pthread_cond_wait(&executor->request_done, &executor->lock);
+		else if (0 == timeout ||
+			 ETIMEDOUT == pthread_cond_timedwait(&executor->request_done, &executor->lock, &deadline))
+			break;
+	}
+	*status = request->status;
+	pthread_mutex_unlock(&executor->lock);
+	return PARH5_SUCCESS;
+}
+
+herr_t parh5R_notify(void *req, H5VL_request_notify_t cb, void *ctx)
+{
+	parh5R_request_t request = req;
+	struct parh5R_executor *executor = request->executor;
+	pthread_mutex_lock(&executor->lock);
+	H5VL_request_status_t status = request->status;
+	if (H5VL_REQUEST_STATUS_IN_PROGRESS == status) {
+		request->notify_cb = cb;
+		request->notify_ctx = ctx;
+	}
+	pthread_mutex_unlock(&executor->lock);
+	if (H5VL_REQUEST_STATUS_IN_PROGRESS != status)
+		return cb(ctx, status);
+	return PARH5_SUCCESS;
+}
+
+herr_t parh5R_cancel(void *req, H5VL_request_status_t *status)
+{
+	parh5R_request_t request = req;
+	struct parh5R_executor *executor = request->executor;
+	pthread_mutex_lock(&executor->lock);
+	*status = H5VL_REQUEST_STATUS_CANT_CANCEL;
+	if (H5VL_REQUEST_STATUS_IN_PROGRESS != request->status || request->running) {
+		pthread_mutex_unlock(&executor->lock);
+		return PARH5_SUCCESS;
+	}
+
+	/*Still queued, take it out before the executor gets to it*/
+	struct parh5R_request **prev = &executor->head;
+	struct parh5R_request *last = NULL;
+	while (*prev != request) {
+		last = *prev;
+		prev = &(*prev)->next;
+	}
+	*prev = request->next;
+	if (executor->tail == request)
+		executor->tail = last;
+	request->status = H5VL_REQUEST_STATUS_CANCELED;
+	*status = H5VL_REQUEST_STATUS_CANCELED;
+	H5VL_request_notify_t notify_cb = request->notify_cb;
+	void *notify_ctx = request->notify_ctx;
+	--executor->num_pending;
+	pthread_cond_broadcast(&executor->request_done);
+	pthread_mutex_unlock(&executor->lock);
+	if (notify_cb)
+		notify_cb(notify_ctx, H5VL_REQUEST_STATUS_CANCELED);
+	return PARH5_SUCCESS;
+}
+
+herr_t parh5R_free(void *req)
+{
+	parh5R_request_t request = req;
+	struct parh5R_executor *executor = request->executor;
+	H5VL_request_status_t status = H5VL_REQUEST_STATUS_IN_PROGRESS;
+	parh5R_wait(request, PARH5R_WAIT_FOREVER, &status);
+	if (request->cleanup_fn)
+		request->cleanup_fn(request->arg);
+	free(request);
+
+	pthread_mutex_lock(&executor->lock);
+	bool last = 0 == --executor->num_requests && executor->destroyed;
+	pthread_mutex_unlock(&executor->lock);
+	if (last)
+		parh5R_free_executor(executor);
+	return PARH5_SUCCESS;
+}
@@ -0,0 +1,51 @@
+#ifndef PARALLAX_VOL_REQUEST_H
+#define PARALLAX_VOL_REQUEST_H
+#include <H5VLconnector.h>
+typedef struct parh5R_executor *parh5R_executor_t;
+typedef struct parh5R_request *parh5R_request_t;
+
+/*Runs the work of a request on the executor thread, it must not call into HDF5*/
+typedef void (*parh5R_run_fn)(void *arg);
+/*Frees what a request holds, called on the application thread when HDF5 frees the request*/
+typedef void (*parh5R_cleanup_fn)(void *arg);
+
+/*VOL-plugin specific functions*/
+herr_t parh5R_wait(void *req, uint64_t timeout, H5VL_request_status_t *status);
+herr_t parh5R_notify(void *req, H5VL_request_notify_t cb, void *ctx);
+herr_t parh5R_cancel(void *req, H5VL_request_status_t *status);
+herr_t parh5R_free(void *req);
+
+/*Non VOL specific functions*/
+
+/**
+ * @brief Creates the executor that runs the asynchronous requests of a
+ * file. Requests run one at a time in the order they were submitted, on a
+ * thread the executor starts with its first request.
+ * @return pointer to the executor object
+ */
+parh5R_executor_t parh5R_create_executor(void);
+
+/**
+ * @brief Queues run_fn(arg) on the executor and returns the request that
+ * tracks it, the token the VOL hands back to HDF5.
+ * @param [in] executor the executor of the file the request works on
+ * @param [in] run_fn the work of the request
+ * @param [in] cleanup_fn frees arg when HDF5 frees the request, may be NULL
+ * @param [in] arg passed to run_fn and cleanup_fn
+ */
+parh5R_request_t parh5R_submit(parh5R_executor_t executor, parh5R_run_fn run_fn, parh5R_cleanup_fn cleanup_fn,
+			       void *arg);
+
+/**
+ * @brief Waits until the executor has no queued or running requests.
+ * Synchronous operations on the data of a file drain its executor first, so
+ * that they see the requests submitted before them. executor may be NULL.
+ */
+void parh5R_drain(parh5R_executor_t executor);
+
+/**
+ * @brief Drains the executor and stops its thread, executor may be NULL.
+ * Requests HDF5 has not freed yet keep it alive until they are freed.
+ */
+void parh5R_destroy_executor(parh5R_executor_t executor);
+#endif
@@ -0,0 +1,1577 @@
+#include "parallax_vol_tile_cache.h"
+#include "parallax_vol_bitmap.h"
+#include "parallax_vol_connector.h"
+#include "parallax_vol_dataset.h"
+#include "parallax_vol_encoding.h"
+#include "parallax_vol_filter.h"
+#include "parallax_vol_inode.h"
+#include "parallax_vol_zone_map.h"
+#include <assert.h>
+#include <endian.h>
+#include <log.h>
+#include <parallax/parallax.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef METRICS_ENABLE
+#include "parallax_vol_metrics.h"
+#endif
+#define PARH5T_TILE_KEY_PREFIX 'T'
+#define PARH5T_TILE_KEY_SIZE (1UL + sizeof(uint64_t) + sizeof(uint64_t))
+/*Delta records append their version to the key of their tile*/
+#define PARH5T_DELTA_KEY_SIZE (PARH5T_TILE_KEY_SIZE + sizeof(uint64_t))
+#define PARH5T_VERSION_KEY_PREFIX 'V'
+/*Zone maps have keys of their own, laid out like tile keys, so a query scans them without the tiles*/
+#define PARH5T_ZONE_KEY_PREFIX 'Z'
+/*Likewise for the bitmaps of the value index of a tile*/
+#define PARH5T_BITMAP_KEY_PREFIX 'B'
+/*Versions are reserved from Parallax in batches so a crash never hands out a version twice*/
+#define PARH5T_VERSION_BATCH (1UL << 20)
+#define PARH5T_MIN_NUM_BUCKETS 1024UL
+#define PARH5T_TYPICAL_TILE_SIZE 4096UL
+/*2Q tuning: A1in holds a quarter of the budget, A1out remembers half a budget worth of tiles*/
+#define PARH5T_A1IN_SHARE 4
+#define PARH5T_A1OUT_SHARE 2
+/*Tiles on their way to Parallax hold at most a quarter of the budget on top of it*/
+#define PARH5T_PUT_STAGE_SHARE 4
+
+enum parh5T_queue_type { PARH5T_A1IN = 1, PARH5T_AM, PARH5T_A1OUT };
+
+/*How a miss fills the tile: read it, read it to merge a write, or zero it since it is overwritten whole*/
+enum parh5T_access { PARH5T_ACCESS_READ = 1, PARH5T_ACCESS_WRITE, PARH5T_ACCESS_OVERWRITE };
+
+struct parh5T_cache_entry {
+	struct parh5T_tile_uuid uuid;
+	struct parh5T_cache_entry *next; /*next in the bucket*/
+	struct parh5T_cache_entry *q_prev;
+	struct parh5T_cache_entry *q_next;
+	char *tile_buf; /*NULL for the entries of A1out*/
+	uint8_t *written; /*delta tiles not loaded yet: bitmap of the bytes written since the last store*/
+	uint64_t *delta_versions; /*delta records merged in tile_buf, deleted when the tile is stored whole*/
+	uint32_t num_deltas;
+	uint32_t tile_size_in_bytes;
+	uint32_t elem_size; /*tiles are encoded per element, see parh5E_encode_tile*/
+	enum parh5T_queue_type queue;
+	uint32_t pins; /*threads copying to or from tile_buf, pinned entries are not evicted*/
+	bool loading; /*a thread fetches the tile without holding the cache lock*/
+	bool delta; /*partial writes go to Parallax as delta records*/
+	bool dirty;
+	uint32_t puts; /*stores of the tile queued in the put stage*/
+	bool evicted; /*left the cache with stores still queued, the put stage finishes the eviction*/
+	bool unstored; /*Parallax is known to have no record of the tile*/
+	const char *fill_tile; /*of the dataset that accessed the tile last, see parh5D_get_fill_tile*/
+	parh5Z_pipeline_t pipeline; /*likewise, see parh5D_get_pipeline*/
+	enum parh5S_elem_type zone_type; /*likewise, see parh5D_get_zone_type*/
+	parh5B_index_t bitmap_index; /*likewise, see parh5D_get_bitmap_index*/
+};
+
+/*A tile, or a delta record of one, on its way to Parallax. A put without a value deletes the tile*/
+struct parh5T_put {
+	struct parh5T_put *next;
+	struct parh5T_cache_entry *entry;
+	char key_buffer[PARH5T_DELTA_KEY_SIZE];
+	uint32_t key_size;
+	char *value;
+	uint32_t value_size;
+	uint32_t tile_size_in_bytes; /*whole tiles are encoded by the put thread, a version may follow the tile*/
+	uint32_t elem_size;
+	parh5Z_pipeline_t pipeline; /*filters the tile instead of the encodings if not NULL*/
+	enum parh5S_elem_type zone_type; /*keeps the zone map of the tile in step unless PARH5S_NONE*/
+	parh5B_index_t bitmap_index; /*keeps the bitmaps of the tile in step if not NULL*/
+	uint64_t *delta_versions; /*delta records folded in the tile, deleted once it is stored*/
+	uint32_t num_deltas;
+};
+
+struct parh5T_queue {
+	struct parh5T_cache_entry *head; /*most recently inserted or used*/
+	struct parh5T_cache_entry *tail;
+	uint64_t size_in_bytes;
+};
+
+struct parh5T_tile_cache {
+	pthread_mutex_t lock; /*guards everything but the data of pinned tiles*/
+	pthread_cond_t tile_loaded;
+	par_handle par_db;
+	uint64_t capacity_in_bytes;
+	struct parh5T_queue a1in; /*FIFO of tiles accessed once*/
+	struct parh5T_queue am; /*LRU of tiles accessed again after leaving A1in*/
+	struct parh5T_queue a1out; /*FIFO of the uuids recently evicted from A1in*/
+	uint64_t num_buckets;
+	struct parh5T_cache_entry **buckets;
+	struct parh5T_cache_entry sparse; /*the last tile a sparse read fetched without caching it*/
+	bool sparse_valid;
+	uint64_t next_version; /*of delta records and of the tiles of delta datasets*/
+	uint64_t version_limit; /*versions up to this one are reserved in Parallax*/
+	bool versions_loaded;
+	/**
+	 * The put stage: writers and flushes assemble the values of the tiles
+	 * they write back and queue them, a thread of the cache issues the
+	 * par_puts, so assembling a tile overlaps storing the previous one.
+	 */
+	pthread_t put_thread;
+	bool put_thread_started;
+	bool put_shutdown;
+	pthread_cond_t put_queued;
+	pthread_cond_t tile_stored;
+	struct parh5T_put *puts_head;
+	struct parh5T_put *puts_tail;
+	uint64_t num_puts; /*queued or being stored*/
+	uint64_t puts_size_in_bytes;
+};
+
+/**
+ * @brief Tile keys are 'T' followed by the dataset and the tile id, both
+ * big-endian, so that Parallax keeps the tiles of a dataset together and in
+ * tile id order.
+ */
+static void parh5T_construct_tile_key(struct parh5T_tile_uuid uuid, char *key_buffer)
+{
+	key_buffer[0] = PARH5T_TILE_KEY_PREFIX;
+	uint64_t dset_id = htobe64(uuid.dset_id);
+	uint64_t tile_id = htobe64(uuid.tile_id);
+	memcpy(&key_buffer[1], &dset_id, sizeof(dset_id));
+	memcpy(&key_buffer[1 + sizeof(dset_id)], &tile_id, sizeof(tile_id));
+}
+
+/**
+ * @brief Delta record keys extend the key of their tile with a big-endian
+ * version, so Parallax stores the records of a tile right after it and in
+ * the order they were written.
+ */
+static void parh5T_construct_delta_key(struct parh5T_tile_uuid uuid, uint64_t version, char *key_buffer)
+{
+	parh5T_construct_tile_key(uuid, key_buffer);
+	version = htobe64(version);
+	memcpy(&key_buffer[PARH5T_TILE_KEY_SIZE], &version, sizeof(version));
+}
+
+/**
+ * @brief Zone map keys are tile keys with their own prefix.
+ */
+static void parh5T_construct_zone_key(struct parh5T_tile_uuid uuid, char *key_buffer)
+{
+	parh5T_construct_tile_key(uuid, key_buffer);
+	key_buffer[0] = PARH5T_ZONE_KEY_PREFIX;
+}
+
+/**
+ * @brief Bitmap keys are tile keys with their own prefix.
+ */
+static void parh5T_construct_bitmap_key(struct parh5T_tile_uuid uuid, char *key_buffer)
+{
+	parh5T_construct_tile_key(uuid, key_buffer);
+	key_buffer[0] = PARH5T_BITMAP_KEY_PREFIX;
+}
+
+/**
+ * @brief Sets every element of a tile to the fill value, fill_tile as
+ * returned by parh5D_get_fill_tile.
+ */
+static inline void parh5T_fill_tile(const char *fill_tile, char *tile_buf, uint32_t tile_size_in_bytes)
+{
+	if (fill_tile)
+		memcpy(tile_buf, fill_tile, tile_size_in_bytes);
+	else
+		memset(tile_buf, 0x00, tile_size_in_bytes);
+}
+
+/**
+ * @brief Returns true if every element of the tile equals the fill value.
+ * A zero tile is recognized by comparing it with itself shifted by a byte.
+ */
+static inline bool parh5T_holds_fill(const char *fill_tile, const char *tile_buf, uint32_t tile_size_in_bytes)
+{
+	if (fill_tile)
+		return 0 == memcmp(tile_buf, fill_tile, tile_size_in_bytes);
+	return 0 == tile_buf[0] && 0 == memcmp(tile_buf, &tile_buf[1], tile_size_in_bytes - 1);
+}
+
+static inline uint64_t parh5T_hash(parh5T_tile_cache_t cache, struct parh5T_tile_uuid uuid)
+{
+	uint64_t hash = uuid.tile_id * 0x9E3779B97F4A7C15ULL ^ uuid.dset_id;
+	return (hash >> 32) % cache->num_buckets;
+}
+
+static struct parh5T_queue *parh5T_get_queue(parh5T_tile_cache_t cache, enum parh5T_queue_type type)
+{
+	switch (type) {
+	case PARH5T_A1IN:
+		return &cache->a1in;
+	case PARH5T_AM:
+		return &cache->am;
+	case PARH5T_A1OUT:
+		return &cache->a1out;
+	default:
+		log_fatal("Unknown queue type %d", type);
+		_exit(EXIT_FAILURE);
+	}
+}
+
+static void parh5T_queue_remove(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry)
+{
+	struct parh5T_queue *queue = parh5T_get_queue(cache, entry->queue);
+	if (entry->q_prev)
+		entry->q_prev->q_next = entry->q_next;
+	else
+		queue->head = entry->q_next;
+	if (entry->q_next)
+		entry->q_next->q_prev = entry->q_prev;
+	else
+		queue->tail = entry->q_prev;
+	entry->q_prev = entry->q_next = NULL;
+	queue->size_in_bytes -= entry->tile_size_in_bytes;
+}
+
+static void parh5T_queue_push(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry,
+			      enum parh5T_queue_type type)
+{
+	struct parh5T_queue *queue = parh5T_get_queue(cache, type);
+	entry->queue = type;
+	entry->q_prev = NULL;
+	entry->q_next = queue->head;
+	if (queue->head)
+		queue->head->q_prev = entry;
+	queue->head = entry;
+	if (NULL == queue->tail)
+		queue->tail = entry;
+	queue->size_in_bytes += entry->tile_size_in_bytes;
+}
+
+static struct parh5T_cache_entry *parh5T_lookup(parh5T_tile_cache_t cache, struct parh5T_tile_uuid uuid)
+{
+	struct parh5T_cache_entry *entry = cache->buckets[parh5T_hash(cache, uuid)];
+	while (entry && (entry->uuid.tile_id != uuid.tile_id || entry->uuid.dset_id != uuid.dset_id))
+		entry = entry->next;
+	return entry;
+}
+
+static void parh5T_unlink_from_bucket(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry)
+{
+	struct parh5T_cache_entry **curr = &cache->buckets[parh5T_hash(cache, entry->uuid)];
+	while (*curr != entry)
+		curr = &(*curr)->next;
+	*curr = entry->next;
+}
+
+/**
+ * @brief Hands out versions for the tiles and the delta records of delta
+ * datasets. Versions grow monotonically across the lifetime of the file,
+ * Parallax keeps the highest version reserved so far.
+ */
+static uint64_t parh5T_next_version(parh5T_tile_cache_t cache)
+{
+	char key_buffer[1] = { PARH5T_VERSION_KEY_PREFIX };
+	struct par_key par_key = { .size = sizeof(key_buffer), .data = key_buffer };
+	const char *error = NULL;
+	if (!cache->versions_loaded) {
+		struct par_value par_value = { .val_buffer_size = sizeof(cache->version_limit),
+					       .val_buffer = (char *)&cache->version_limit };
+		par_get(cache->par_db, &par_key, &par_value, &error);
+		if (error)
+			cache->version_limit = 0;
+		cache->next_version = cache->version_limit;
+		cache->versions_loaded = true;
+		error = NULL;
+	}
+	if (cache->next_version < cache->version_limit)
+		return cache->next_version++;
+
+	cache->version_limit += PARH5T_VERSION_BATCH;
+	struct par_key_value KV = { .k = par_key,
+				    .v.val_size = sizeof(cache->version_limit),
+				    .v.val_buffer_size = sizeof(cache->version_limit),
+				    .v.val_buffer = (char *)&cache->version_limit };
+	par_put(cache->par_db, &KV, &error);
+	if (error) {
+		log_fatal("Failed to reserve tile versions reason: %s", error);
+		_exit(EXIT_FAILURE);
+	}
+	return cache->next_version++;
+}
+
+static inline bool parh5T_is_written(struct parh5T_cache_entry *entry, uint32_t offt)
+{
+	return entry->written[offt / 8] & (1U << (offt % 8));
+}
+
+/**
+ * @brief Marks size bytes of a delta tile that is not loaded as written,
+ * starting at offt. The edge bytes of the bitmap are masked, the ones in
+ * between are set whole.
+ */
+static void parh5T_mark_written(struct parh5T_cache_entry *entry, uint32_t offt, uint32_t size)
+{
+	if (0 == size)
+		return;
+	uint32_t first = offt / 8;
+	uint32_t last = (offt + size - 1) / 8;
+	uint8_t head = 0xffU << (offt % 8);
+	uint8_t tail = 0xffU >> (7 - (offt + size - 1) % 8);
+	if (first == last) {
+		entry->written[first] |= head & tail;
+		return;
+	}
+	entry->written[first] |= head;
+	memset(&entry->written[first + 1], 0xff, last - first - 1);
+	entry->written[last] |= tail;
+}
+
+/**
+ * @brief Finds the next run of bytes written to a delta tile that is not
+ * loaded, starting the search at *offt.
+ * @return true if a run was found false otherwise
+ */
+static bool parh5T_next_written_run(struct parh5T_cache_entry *entry, uint32_t *offt, uint32_t *size)
+{
+	uint32_t start = *offt;
+	while (start < entry->tile_size_in_bytes && !parh5T_is_written(entry, start))
+		start++;
+	if (start == entry->tile_size_in_bytes)
+		return false;
+	uint32_t end = start;
+	while (end < entry->tile_size_in_bytes && parh5T_is_written(entry, end))
+		end++;
+	*offt = start;
+	*size = end - start;
+	return true;
+}
+
+/**
+ * @brief Applies a delta record, a sequence of (offset, size, bytes)
+ * triplets, to a tile.
+ */
+static void parh5T_apply_delta(char *tile_buf, uint32_t tile_size_in_bytes, const char *delta, uint32_t delta_size)
+{
+	uint32_t idx = 0;
+	while (idx < delta_size) {
+		uint32_t offt = 0;
+		uint32_t size = 0;
+		memcpy(&offt, &delta[idx], sizeof(offt));
+		memcpy(&size, &delta[idx + sizeof(offt)], sizeof(size));
+		idx += sizeof(offt) + sizeof(size);
+		if ((uint64_t)offt + size > tile_size_in_bytes || (uint64_t)idx + size > delta_size) {
+			log_fatal("Corrupted delta record offt: %u size: %u tile size: %u", offt, size,
+				  tile_size_in_bytes);
+			_exit(EXIT_FAILURE);
+		}
+		memcpy(&tile_buf[offt], &delta[idx], size);
+		idx += size;
+	}
+}
+
+static uint32_t parh5T_get_tile_size(parh5D_dataset_t dataset)
+{
+	uint32_t tile_size_in_bytes = parh5D_get_tile_size_in_elems(dataset) * parh5D_get_elems_size_in_bytes(dataset);
+	if (0 == tile_size_in_bytes) {
+		log_fatal("Zero sized tiles for dataset: %s", parh5D_get_dataset_name(dataset));
+		_exit(EXIT_FAILURE);
+	}
+	return tile_size_in_bytes;
+}
+
+/**
+ * @brief Decodes a tile value read from Parallax. Whole tiles are stored
+ * encoded, or filtered if the dataset has filters.
+ */
+static void parh5T_decode_tile(parh5D_dataset_t dataset, uint64_t tile_id, const char *value, uint32_t value_size,
+			       char *tile_buf)
+{
+	uint32_t tile_size_in_bytes = parh5T_get_tile_size(dataset);
+	parh5Z_pipeline_t pipeline = parh5D_get_pipeline(dataset);
+	bool success = pipeline ? parh5Z_unfilter_tile(pipeline, value, value_size, tile_buf, tile_size_in_bytes) :
+				  parh5E_decode_tile(value, value_size, tile_buf, tile_size_in_bytes,
+						     parh5D_get_elems_size_in_bytes(dataset));
+	if (success)
+		return;
+	log_fatal("Tile %lu of dataset %s does not decode to a tile of %u bytes", tile_id,
+		  parh5D_get_dataset_name(dataset), tile_size_in_bytes);
+	_exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Merges the records of the tile the scanner points to, its base
+ * record and the delta records written after it, into tile_buf and leaves
+ * the scanner at the first key past them. A tile without a base record
+ * starts from the fill value.
+ * @param [in] scanner positioned at the first record of the tile
+ * @param [in] dataset the dataset the tile belongs to
+ * @param [in] match_tile_id if true merge only records of *tile_id
+ * @param [in,out] tile_id the tile merged
+ * @param [out] tile_buf where to merge the tile
+ * @param [out] entry if not NULL it keeps the versions of the delta records
+ * @return true if the scanner pointed to a record of the tile false otherwise
+ */
+static bool parh5T_merge_tile(par_scanner scanner, parh5D_dataset_t dataset, bool match_tile_id, uint64_t *tile_id,
+			      char *tile_buf, struct parh5T_cache_entry *entry)
+{
+	uint64_t dset_id = parh5I_get_inode_num(parh5D_get_inode(dataset));
+	uint32_t tile_size_in_bytes = parh5T_get_tile_size(dataset);
+	char prefix[PARH5T_TILE_KEY_SIZE];
+	parh5T_construct_tile_key((struct parh5T_tile_uuid){ .dset_id = dset_id }, prefix);
+	parh5T_fill_tile(parh5D_get_fill_tile(dataset), tile_buf, tile_size_in_bytes);
+	bool found = false;
+	bool has_base = false;
+	uint64_t base_version = 0;
+	for (; par_is_valid(scanner); par_get_next(scanner)) {
+		struct par_key key = par_get_key(scanner);
+		if ((key.size != PARH5T_TILE_KEY_SIZE && key.size != PARH5T_DELTA_KEY_SIZE) ||
+		    memcmp(key.data, prefix, 1UL + sizeof(dset_id)))
+			break;
+		uint64_t key_tile_id = 0;
+		memcpy(&key_tile_id, &key.data[1 + sizeof(dset_id)], sizeof(key_tile_id));
+		key_tile_id = be64toh(key_tile_id);
+		if ((found || match_tile_id) && key_tile_id != *tile_id)
+			break;
+		found = true;
+		*tile_id = key_tile_id;
+
+		struct par_value value = par_get_value(scanner);
+		if (PARH5T_TILE_KEY_SIZE == key.size) {
+			if (value.val_size < sizeof(base_version)) {
+				log_fatal("Tile %lu of dataset %lu has no version", key_tile_id, dset_id);
+				_exit(EXIT_FAILURE);
+			}
+			uint32_t encoded_size = value.val_size - sizeof(base_version);
+			parh5T_decode_tile(dataset, key_tile_id, value.val_buffer, encoded_size, tile_buf);
+			memcpy(&base_version, &value.val_buffer[encoded_size], sizeof(base_version));
+			has_base = true;
+			continue;
+		}
+
+		uint64_t version = 0;
+		memcpy(&version, &key.data[PARH5T_TILE_KEY_SIZE], sizeof(version));
+		version = be64toh(version);
+		if (entry) {
+			entry->delta_versions = realloc(entry->delta_versions,
+							(entry->num_deltas + 1UL) * sizeof(*entry->delta_versions));
+			entry->delta_versions[entry->num_deltas++] = version;
+		}
+		/*The base record already includes older deltas*/
+		if (has_base && version <= base_version)
+			continue;
+		parh5T_apply_delta(tile_buf, tile_size_in_bytes, value.val_buffer, value.val_size);
+	}
+	return found;
+}
+
+static par_scanner parh5T_init_tile_scanner(parh5T_tile_cache_t cache, struct parh5T_tile_uuid uuid)
+{
+	char start_key_buffer[PARH5T_TILE_KEY_SIZE];
+	parh5T_construct_tile_key(uuid, start_key_buffer);
+	struct par_key start_key = { .size = sizeof(start_key_buffer), .data = start_key_buffer };
+	const char *error = NULL;
+	par_scanner scanner = par_init_scanner(cache->par_db, &start_key, PAR_GREATER_OR_EQUAL, &error);
+	if (error) {
+		log_fatal("Failed to init scanner reason: %s", error);
+		_exit(EXIT_FAILURE);
+	}
+	return scanner;
+}
+
+/**
+ * @brief Reads a tile of a delta dataset merging its delta records. Tiles
+ * with many delta records are marked dirty, storing them whole folds the
+ * records back into the tile.
+ */
+static bool parh5T_fetch_delta_tile(parh5T_tile_cache_t cache, parh5D_dataset_t dataset,
+				    struct parh5T_cache_entry *entry)
+{
+	par_scanner scanner = parh5T_init_tile_scanner(cache, entry->uuid);
+	uint64_t tile_id = entry->uuid.tile_id;
+	bool found = parh5T_merge_tile(scanner, dataset, true, &tile_id, entry->tile_buf, entry);
+	par_close_scanner(scanner);
+	if (!found)
+		return false;
+#ifdef METRICS_ENABLE
+	parh5M_inc_dset_read_ntiles(dataset);
+#endif
+	if (entry->num_deltas >= parh5D_get_delta_threshold(dataset)) {
+		entry->dirty = true;
+#ifdef METRICS_ENABLE
+		parh5M_inc_dset_consolidated_tiles(dataset);
+#endif
+	}
+	return true;
+}
+
+/**
+ * @brief Reads a tile from Parallax. If the tile has never been stored, or
+ * held only the fill value when it was, it fills the buffer with the fill
+ * value of the dataset.
+ * @return true if the tile exists in Parallax false otherwise
+ */
+static bool parh5T_fetch_tile(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, struct parh5T_cache_entry *entry)
+{
+	if (entry->delta)
+		return parh5T_fetch_delta_tile(cache, dataset, entry);
+	char key_buffer[PARH5T_TILE_KEY_SIZE];
+	parh5T_construct_tile_key(entry->uuid, key_buffer);
+	struct par_key par_key = { .size = sizeof(key_buffer), .data = key_buffer };
+	/*Stored tiles are encoded or filtered, Parallax allocates a buffer of their size*/
+	struct par_value par_value = { 0 };
+	const char *error = NULL;
+	par_get(cache->par_db, &par_key, &par_value, &error);
+	if (error) {
+		parh5T_fill_tile(parh5D_get_fill_tile(dataset), entry->tile_buf, entry->tile_size_in_bytes);
+		return false;
+	}
+	parh5T_decode_tile(dataset, entry->uuid.tile_id, par_value.val_buffer, par_value.val_size, entry->tile_buf);
+	free(par_value.val_buffer);
+#ifdef METRICS_ENABLE
+	parh5M_inc_dset_read_ntiles(dataset);
+#endif
+	return true;
+}
+
+/**
+ * @brief Loads a delta tile that has only been written so far. The bytes
+ * written since the last store stay on top of the merged records.
+ */
+static void parh5T_load_written_tile(parh5T_tile_cache_t cache, parh5D_dataset_t dataset,
+				     struct parh5T_cache_entry *entry)
+{
+	char *written_buf = entry->tile_buf;
+	entry->tile_buf = calloc(1UL, entry->tile_size_in_bytes + sizeof(uint64_t));
+	entry->unstored = !parh5T_fetch_tile(cache, dataset, entry);
+	uint32_t offt = 0;
+	uint32_t size = 0;
+	for (; parh5T_next_written_run(entry, &offt, &size); offt += size)
+		memcpy(&entry->tile_buf[offt], &written_buf[offt], size);
+	free(written_buf);
+	free(entry->written);
+	entry->written = NULL;
+}
+
+/**
+ * @brief Releases the tile data of an entry.
+ */
+static void parh5T_drop_tile(struct parh5T_cache_entry *entry)
+{
+	free(entry->tile_buf);
+	entry->tile_buf = NULL;
+	free(entry->written);
+	entry->written = NULL;
+	free(entry->delta_versions);
+	entry->delta_versions = NULL;
+	entry->num_deltas = 0;
+}
+
+static void parh5T_free_entry(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry)
+{
+	parh5T_queue_remove(cache, entry);
+	parh5T_unlink_from_bucket(cache, entry);
+	parh5T_drop_tile(entry);
+	free(entry);
+}
+
+static void parh5T_trim_a1out(parh5T_tile_cache_t cache)
+{
+	while (cache->a1out.size_in_bytes > cache->capacity_in_bytes / PARH5T_A1OUT_SHARE)
+		parh5T_free_entry(cache, cache->a1out.tail);
+}
+
+/**
+ * @brief Drops the tile data of an entry that left its queue. Entries
+ * leaving A1in are remembered in A1out, the rest are freed.
+ */
+static void parh5T_finish_eviction(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry)
+{
+	entry->evicted = false;
+	parh5T_drop_tile(entry);
+	if (PARH5T_AM == entry->queue) {
+		parh5T_unlink_from_bucket(cache, entry);
+		free(entry);
+		return;
+	}
+	parh5T_queue_push(cache, entry, PARH5T_A1OUT);
+	parh5T_trim_a1out(cache);
+}
+
+/**
+ * @brief Keeps the zone map of a tile in step with a put of it: a whole tile
+ * is summarized, a delta record changes the tile in ways the put thread
+ * cannot see without reading it, so its zone becomes inexact, and a deleted
+ * tile loses its zone, it holds the fill value.
+ */
+static void parh5T_put_zone(parh5T_tile_cache_t cache, const struct parh5T_put *put)
+{
+	struct parh5T_tile_uuid uuid = put->entry->uuid;
+	char key_buffer[PARH5T_TILE_KEY_SIZE];
+	parh5T_construct_zone_key(uuid, key_buffer);
+	struct parh5S_zone zone;
+	struct par_key_value KV = { .k.size = sizeof(key_buffer),
+				    .k.data = key_buffer,
+				    .v.val_size = sizeof(zone),
+				    .v.val_buffer_size = sizeof(zone),
+				    .v.val_buffer = (char *)&zone };
+	const char *error = NULL;
+	if (NULL == put->value) {
+		par_delete(cache->par_db, &KV.k, &error);
+		return;
+	}
+	if (PARH5T_TILE_KEY_SIZE == put->key_size)
+		parh5S_summarize_tile(put->zone_type, put->value, put->tile_size_in_bytes / put->elem_size, &zone);
+	else
+		parh5S_set_inexact_zone(&zone);
+	par_put(cache->par_db, &KV, &error);
+	if (error) {
+		log_fatal("Failed to store the zone map of tile %lu of dataset %lu reason: %s", uuid.tile_id,
+			  uuid.dset_id, error);
+		_exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @brief Keeps the bitmaps of a tile in step with a put of it, like
+ * parh5T_put_zone: a whole tile is binned, the bitmaps of a tile that got a
+ * delta record become unknown and a deleted tile loses them.
+ */
+static void parh5T_put_bitmaps(parh5T_tile_cache_t cache, const struct parh5T_put *put)
+{
+	struct parh5T_tile_uuid uuid = put->entry->uuid;
+	char key_buffer[PARH5T_TILE_KEY_SIZE];
+	parh5T_construct_bitmap_key(uuid, key_buffer);
+	struct par_key_value KV = { .k.size = sizeof(key_buffer), .k.data = key_buffer };
+	const char *error = NULL;
+	if (NULL == put->value) {
+		par_delete(cache->par_db, &KV.k, &error);
+		return;
+	}
+	if (PARH5T_TILE_KEY_SIZE == put->key_size)
+		KV.v.val_buffer = parh5B_encode_tile(put->bitmap_index, put->value,
+						     put->tile_size_in_bytes / put->elem_size, &KV.v.val_size);
+	else
+		KV.v.val_buffer = parh5B_encode_unknown(&KV.v.val_size);
+	KV.v.val_buffer_size = KV.v.val_size;
+	par_put(cache->par_db, &KV, &error);
+	if (error) {
+		log_fatal("Failed to store the bitmaps of tile %lu of dataset %lu reason: %s", uuid.tile_id,
+			  uuid.dset_id, error);
+		_exit(EXIT_FAILURE);
+	}
+	free(KV.v.val_buffer);
+}
+
+/**
+ * @brief Deletes every record of a tile of a delta dataset, the whole tile
+ * and its delta records. A tile overwritten without being read does not
+ * know the versions of its delta records, the scan of the tile finds them.
+ */
+static void parh5T_delete_tile_records(parh5T_tile_cache_t cache, struct parh5T_tile_uuid uuid)
+{
+	char tile_key_buffer[PARH5T_TILE_KEY_SIZE];
+	parh5T_construct_tile_key(uuid, tile_key_buffer);
+	char *keys = NULL;
+	uint32_t *key_sizes = NULL;
+	uint32_t num_keys = 0;
+	uint32_t capacity = 0;
+	/*Collect the keys first, the scanner must not see the records it walks change*/
+	par_scanner scanner = parh5T_init_tile_scanner(cache, uuid);
+	for (; par_is_valid(scanner); par_get_next(scanner)) {
+		struct par_key key = par_get_key(scanner);
+		if ((key.size != PARH5T_TILE_KEY_SIZE && key.size != PARH5T_DELTA_KEY_SIZE) ||
+		    memcmp(key.data, tile_key_buffer, PARH5T_TILE_KEY_SIZE))
+			break;
+		if (num_keys == capacity) {
+			capacity = capacity ? 2 * capacity : 16;
+			keys = realloc(keys, capacity * PARH5T_DELTA_KEY_SIZE);
+			key_sizes = realloc(key_sizes, capacity * sizeof(*key_sizes));
+		}
+		memcpy(&keys[num_keys * PARH5T_DELTA_KEY_SIZE], key.data, key.size);
+		key_sizes[num_keys++] = key.size;
+	}
+	par_close_scanner(scanner);
+
+	for (uint32_t i = 0; i < num_keys; i++) {
+		struct par_key par_key = { .size = key_sizes[i], .data = &keys[i * PARH5T_DELTA_KEY_SIZE] };
+		const char *error = NULL;
+		par_delete(cache->par_db, &par_key, &error);
+		if (error)
+			log_warn("Failed to delete a record of tile %lu reason: %s", uuid.tile_id, error);
+	}
+	free(key_sizes);
+	free(keys);
+}
+
+/**
+ * @brief Stores a queued tile, or delta record, and deletes the delta
+ * records the tile folds. Whole tiles are encoded, or filtered through
+ * the pipeline of their dataset, first, with the version of delta datasets
+ * kept after the result. Runs on the put thread
+ * without the cache lock, the entry of a queued put is not freed.
+ */
+static void parh5T_put_tile(parh5T_tile_cache_t cache, const struct parh5T_put *put)
+{
+	struct parh5T_tile_uuid uuid = put->entry->uuid;
+	struct par_key_value KV = { .k.size = put->key_size,
+				    .k.data = put->key_buffer,
+				    .v.val_size = put->value_size,
+				    .v.val_buffer_size = put->value_size,
+				    .v.val_buffer = put->value };
+	char *encoded = NULL;
+	if (put->value && PARH5T_TILE_KEY_SIZE == put->key_size) {
+		uint32_t trailer_size = put->value_size - put->tile_size_in_bytes;
+		uint32_t encoded_size = 0;
+		if (put->pipeline)
+			encoded = parh5Z_filter_tile(put->pipeline, put->value, put->tile_size_in_bytes, trailer_size,
+						     &encoded_size);
+		else
+			encoded = parh5E_encode_tile(put->value, put->tile_size_in_bytes, put->elem_size,
+						     trailer_size, &encoded_size);
+		memcpy(&encoded[encoded_size], &put->value[put->tile_size_in_bytes], trailer_size);
+		KV.v.val_size = encoded_size + trailer_size;
+		KV.v.val_buffer_size = KV.v.val_size;
+		KV.v.val_buffer = encoded;
+	}
+	const char *error = NULL;
+	if (NULL == put->value && put->entry->delta) {
+		/*Delta records the tile does not know of would apply over the fill value*/
+		parh5T_delete_tile_records(cache, uuid);
+	} else if (NULL == put->value) {
+		/*The tile may never have been stored, then there is nothing to delete*/
+		par_delete(cache->par_db, &KV.k, &error);
+	} else {
+		par_put(cache->par_db, &KV, &error);
+		if (error) {
+			log_fatal("Failed to store tile %lu of dataset %lu reason: %s", uuid.tile_id, uuid.dset_id,
+				  error);
+			_exit(EXIT_FAILURE);
+		}
+	}
+	free(encoded);
+	if (PARH5S_NONE != put->zone_type)
+		parh5T_put_zone(cache, put);
+	if (put->bitmap_index)
+		parh5T_put_bitmaps(cache, put);
+	/*Deleting a delta tile deleted its delta records already*/
+	for (uint32_t i = 0; put->value && i < put->num_deltas; i++) {
+		char key_buffer[PARH5T_DELTA_KEY_SIZE];
+		parh5T_construct_delta_key(uuid, put->delta_versions[i], key_buffer);
+		struct par_key par_key = { .size = sizeof(key_buffer), .data = key_buffer };
+		error = NULL;
+		par_delete(cache->par_db, &par_key, &error);
+		if (error)
+			log_warn("Failed to delete delta record of tile %lu reason: %s", uuid.tile_id, error);
+	}
+}
+
+static void *parh5T_put_main(void *thread_arg)
+{
+	parh5T_tile_cache_t cache = thread_arg;
+	pthread_mutex_lock(&cache->lock);
+	for (;;) {
+		while (!cache->put_shutdown && NULL == cache->puts_head)
+			pthread_cond_wait(&cache->put_queued, &cache->lock);
+		if (NULL == cache->puts_head)
+			break;
+		struct parh5T_put *put = cache->puts_head;
+		cache->puts_head = put->next;
+		if (NULL == cache->puts_head)
+			cache->puts_tail = NULL;
+		pthread_mutex_unlock(&cache->lock);
+
+		parh5T_put_tile(cache, put);
+		free(put->value);
+		free(put->delta_versions);
+
+		pthread_mutex_lock(&cache->lock);
+		struct parh5T_cache_entry *entry = put->entry;
+		if (0 == --entry->puts && entry->evicted)
+			parh5T_finish_eviction(cache, entry);
+		cache->num_puts--;
+		cache->puts_size_in_bytes -= put->value_size;
+		free(put);
+		pthread_cond_broadcast(&cache->tile_stored);
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return NULL;
+}
+
+/**
+ * @brief Returns true if the put stage has room for a tile of
+ * size_in_bytes. It takes one tile whatever its size.
+ */
+static inline bool parh5T_has_put_room(parh5T_tile_cache_t cache, uint32_t size_in_bytes)
+{
+	return 0 == cache->num_puts ||
+	       cache->puts_size_in_bytes + size_in_bytes <= cache->capacity_in_bytes / PARH5T_PUT_STAGE_SHARE;
+}
+
+/**
+ * @brief Waits, dropping the cache lock, until the put stage has room for a
+ * tile of size_in_bytes.
+ */
+static void parh5T_wait_for_put_room(parh5T_tile_cache_t cache, uint32_t size_in_bytes)
+{
+	while (!parh5T_has_put_room(cache, size_in_bytes))
+		pthread_cond_wait(&cache->tile_stored, &cache->lock);
+}
+
+/**
+ * @brief Waits, dropping the cache lock, until every queued put is stored.
+ */
+static void parh5T_drain_puts(parh5T_tile_cache_t cache)
+{
+	while (cache->num_puts)
+		pthread_cond_wait(&cache->tile_stored, &cache->lock);
+}
+
+/**
+ * @brief Hands a put of the tile of entry to the put thread, starting it on
+ * first use. Callers make room with parh5T_wait_for_put_room first, so
+ * queueing itself never waits.
+ */
+static void parh5T_queue_put(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry, struct parh5T_put *put)
+{
+	if (!cache->put_thread_started) {
+		if (pthread_create(&cache->put_thread, NULL, parh5T_put_main, cache)) {
+			log_fatal("Failed to start the put thread of the tile cache");
+			_exit(EXIT_FAILURE);
+		}
+		cache->put_thread_started = true;
+	}
+	put->entry = entry;
+	entry->puts++;
+	if (cache->puts_tail)
+		cache->puts_tail->next = put;
+	else
+		cache->puts_head = put;
+	cache->puts_tail = put;
+	cache->num_puts++;
+	cache->puts_size_in_bytes += put->value_size;
+	pthread_cond_signal(&cache->put_queued);
+}
+
+/**
+ * @brief Queues the bytes written to a delta tile that is not loaded as a
+ * new delta record, without reading the tile.
+ */
+static void parh5T_store_delta(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry)
+{
+	uint32_t value_size = 0;
+	uint32_t offt = 0;
+	uint32_t size = 0;
+	for (; parh5T_next_written_run(entry, &offt, &size); offt += size)
+		value_size += sizeof(offt) + sizeof(size) + size;
+	if (0 == value_size)
+		return;
+
+	struct parh5T_put *put = calloc(1UL, sizeof(*put));
+	put->value = calloc(1UL, value_size);
+	put->value_size = value_size;
+	uint32_t idx = 0;
+	for (offt = 0; parh5T_next_written_run(entry, &offt, &size); offt += size) {
+		memcpy(&put->value[idx], &offt, sizeof(offt));
+		memcpy(&put->value[idx + sizeof(offt)], &size, sizeof(size));
+		idx += sizeof(offt) + sizeof(size);
+		memcpy(&put->value[idx], &entry->tile_buf[offt], size);
+		idx += size;
+	}
+	put->key_size = PARH5T_DELTA_KEY_SIZE;
+	put->zone_type = entry->zone_type;
+	put->bitmap_index = entry->bitmap_index;
+	parh5T_construct_delta_key(entry->uuid, parh5T_next_version(cache), put->key_buffer);
+	parh5T_queue_put(cache, entry, put);
+	entry->unstored = false;
+	memset(entry->written, 0x00, (entry->tile_size_in_bytes + 7) / 8);
+#ifdef METRICS_ENABLE
+	parh5M_inc_dset_delta_records(NULL);
+#endif
+}
+
+/**
+ * @brief Writes a dirty tile back through the put stage. Delta tiles that
+ * are not loaded are stored as delta records. Whole tiles of delta datasets
+ * carry the version they were stored with, so that older delta records do
+ * not apply to them. An evicted tile hands its buffer to the put, a tile
+ * that stays cached is copied, since writers may change it before the put.
+ * Tiles that hold only the fill value are not stored, they read the same
+ * without a record, and the records of the tile, if it may have any, are
+ * deleted instead.
+ */
+static void parh5T_store_tile(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry, bool evicting)
+{
+	entry->dirty = false;
+	if (entry->written) {
+		parh5T_store_delta(cache, entry);
+		return;
+	}
+	bool fill = parh5T_holds_fill(entry->fill_tile, entry->tile_buf, entry->tile_size_in_bytes);
+#ifdef METRICS_ENABLE
+	if (fill)
+		parh5M_inc_dset_fill_tiles(NULL);
+#endif
+	if (fill && entry->unstored && 0 == entry->num_deltas)
+		return;
+
+	struct parh5T_put *put = calloc(1UL, sizeof(*put));
+	put->key_size = PARH5T_TILE_KEY_SIZE;
+	put->zone_type = entry->zone_type;
+	put->bitmap_index = entry->bitmap_index;
+	parh5T_construct_tile_key(entry->uuid, put->key_buffer);
+	put->delta_versions = entry->delta_versions;
+	put->num_deltas = entry->num_deltas;
+	entry->delta_versions = NULL;
+	entry->num_deltas = 0;
+	entry->unstored = fill;
+	if (fill) {
+		parh5T_queue_put(cache, entry, put);
+		return;
+	}
+
+	put->value_size = entry->tile_size_in_bytes;
+	put->tile_size_in_bytes = entry->tile_size_in_bytes;
+	put->elem_size = entry->elem_size;
+	put->pipeline = entry->pipeline;
+	if (entry->delta) {
+		uint64_t version = parh5T_next_version(cache);
+		memcpy(&entry->tile_buf[entry->tile_size_in_bytes], &version, sizeof(version));
+		put->value_size += sizeof(version);
+	}
+	if (evicting) {
+		put->value = entry->tile_buf;
+		entry->tile_buf = NULL;
+	} else {
+		put->value = malloc(put->value_size);
+		memcpy(put->value, entry->tile_buf, put->value_size);
+	}
+	parh5T_queue_put(cache, entry, put);
+#ifdef METRICS_ENABLE
+	parh5M_inc_dset_write_ntiles(NULL);
+#endif
+}
+
+/**
+ * @brief Takes an entry out of its queue, writing its tile back first if it
+ * is dirty. An entry with stores still queued stays in its bucket, so that
+ * lookups of the tile wait for them instead of fetching an older copy, and
+ * the put stage finishes the eviction.
+ */
+static void parh5T_evict_entry(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry)
+{
+	if (entry->dirty)
+		parh5T_store_tile(cache, entry, true);
+#ifdef METRICS_ENABLE
+	parh5M_inc_cache_evictions(NULL);
+#endif
+	parh5T_queue_remove(cache, entry);
+	if (entry->puts) {
+		entry->evicted = true;
+		return;
+	}
+	parh5T_finish_eviction(cache, entry);
+}
+
+/**
+ * @brief Returns the least recently inserted or used entry of the queue that
+ * no thread has pinned.
+ */
+static struct parh5T_cache_entry *parh5T_get_victim(struct parh5T_queue *queue)
+{
+	struct parh5T_cache_entry *entry = queue->tail;
+	while (entry && entry->pins)
+		entry = entry->q_prev;
+	return entry;
+}
+
+/**
+ * @brief Evicts tiles until a tile of size_in_bytes fits in the budget.
+ * @return false if it had to wait for room in the put stage to write back a
+ * dirty victim, the cache lock was dropped in the meantime
+ */
+static bool parh5T_make_room(parh5T_tile_cache_t cache, uint32_t size_in_bytes)
+{
+	while (cache->a1in.size_in_bytes + cache->am.size_in_bytes + size_in_bytes > cache->capacity_in_bytes) {
+		struct parh5T_cache_entry *a1in_victim = parh5T_get_victim(&cache->a1in);
+		struct parh5T_cache_entry *am_victim = parh5T_get_victim(&cache->am);
+		struct parh5T_cache_entry *victim = am_victim;
+		if (a1in_victim &&
+		    (cache->a1in.size_in_bytes > cache->capacity_in_bytes / PARH5T_A1IN_SHARE || NULL == am_victim))
+			victim = a1in_victim;
+		if (NULL == victim)
+			break; /*A single tile larger than the budget or all tiles pinned, let it in*/
+		if (victim->dirty && !parh5T_has_put_room(cache, victim->tile_size_in_bytes)) {
+			parh5T_wait_for_put_room(cache, victim->tile_size_in_bytes);
+			return false;
+		}
+		parh5T_evict_entry(cache, victim);
+	}
+	return true;
+}
+
+static inline bool parh5T_sparse_holds(parh5T_tile_cache_t cache, struct parh5T_tile_uuid uuid)
+{
+	return cache->sparse_valid && cache->sparse.uuid.tile_id == uuid.tile_id &&
+	       cache->sparse.uuid.dset_id == uuid.dset_id;
+}
+
+static inline bool parh5T_sparse_loads(parh5T_tile_cache_t cache, struct parh5T_tile_uuid uuid)
+{
+	return cache->sparse.loading && cache->sparse.uuid.tile_id == uuid.tile_id &&
+	       cache->sparse.uuid.dset_id == uuid.dset_id;
+}
+
+/**
+ * @brief Returns the cache entry of the tile pinned, the caller holds the
+ * cache lock and releases the entry with parh5T_release_entry. On a miss it
+ * loads the tile from Parallax unless the access overwrites the whole tile,
+ * writes a delta tile, or the ghost of the tile remembers that Parallax has
+ * no record of it, such tiles start from the fill value. The lock is dropped during the fetch so that workers
+ * fetch different tiles concurrently, threads that want a tile being fetched
+ * wait for it, as do threads that want a tile evicted but not stored yet.
+ * Reads of a delta tile that has only been written wait for its records in
+ * the put stage, then merge them the same way. Tiles seen for the first time enter A1in, tiles found in A1out enter Am.
+ */
+static struct parh5T_cache_entry *parh5T_get_entry(parh5T_tile_cache_t cache, parh5D_dataset_t dataset,
+						   struct parh5T_tile_uuid uuid, enum parh5T_access access)
+{
+	/*A sparse read is fetching the tile, its ghost is about to enter A1out*/
+	while (parh5T_sparse_loads(cache, uuid))
+		pthread_cond_wait(&cache->tile_loaded, &cache->lock);
+	struct parh5T_cache_entry *entry = parh5T_lookup(cache, uuid);
+	/*An evicted tile is on its way to Parallax, fetching it now could return an older copy*/
+	while (entry && entry->evicted) {
+		pthread_cond_wait(&cache->tile_stored, &cache->lock);
+		entry = parh5T_lookup(cache, uuid);
+	}
+	bool sparse_hit = parh5T_sparse_holds(cache, uuid);
+	/*After a write the copy of the sparse read buffer is stale*/
+	if (sparse_hit && PARH5T_ACCESS_READ != access)
+		cache->sparse_valid = false;
+	if (entry && PARH5T_A1OUT != entry->queue) {
+#ifdef METRICS_ENABLE
+		parh5M_inc_cache_hits(dataset);
+#endif
+		if (PARH5T_AM == entry->queue) {
+			parh5T_queue_remove(cache, entry);
+			parh5T_queue_push(cache, entry, PARH5T_AM);
+		}
+		/*Tiles become dirty only through an open dataset, its fill tile and pipeline outlive them*/
+		entry->fill_tile = parh5D_get_fill_tile(dataset);
+		entry->pipeline = parh5D_get_pipeline(dataset);
+		entry->zone_type = parh5D_get_zone_type(dataset);
+		entry->bitmap_index = parh5D_get_bitmap_index(dataset);
+		entry->pins++;
+		/*The merge misses delta records still in the put stage, whole tiles stored later would supersede them*/
+		while (entry->loading || (entry->written && PARH5T_ACCESS_READ == access && entry->puts))
+			pthread_cond_wait(entry->loading ? &cache->tile_loaded : &cache->tile_stored, &cache->lock);
+		if (entry->written && PARH5T_ACCESS_READ == access) {
+			entry->loading = true;
+			pthread_mutex_unlock(&cache->lock);
+			parh5T_load_written_tile(cache, dataset, entry);
+			pthread_mutex_lock(&cache->lock);
+			entry->loading = false;
+			pthread_cond_broadcast(&cache->tile_loaded);
+		} else if (entry->written && PARH5T_ACCESS_OVERWRITE == access) {
+			free(entry->written);
+			entry->written = NULL;
+		}
+		return entry;
+	}
+	uint32_t tile_size_in_bytes = parh5T_get_tile_size(dataset);
+	/*Making room may wait for the put stage without the lock, another thread may load the tile meanwhile*/
+	if (!parh5T_make_room(cache, tile_size_in_bytes))
+		return parh5T_get_entry(cache, dataset, uuid, access);
+#ifdef METRICS_ENABLE
+	parh5M_inc_cache_miss(dataset);
+#endif
+	enum parh5T_queue_type queue = PARH5T_A1IN;
+	bool unstored = false;
+	/*Evictions may have trimmed the ghost*/
+	entry = parh5T_lookup(cache, uuid);
+	if (entry) {
+		/*Ghost hit, the tile is referenced again after leaving A1in*/
+		unstored = entry->unstored;
+		parh5T_free_entry(cache, entry);
+		queue = PARH5T_AM;
+	}
+
+	entry = calloc(1UL, sizeof(*entry));
+	entry->uuid = uuid;
+	entry->tile_size_in_bytes = tile_size_in_bytes;
+	entry->elem_size = parh5D_get_elems_size_in_bytes(dataset);
+	entry->delta = parh5D_get_delta_threshold(dataset) > 0;
+	entry->fill_tile = parh5D_get_fill_tile(dataset);
+	entry->pipeline = parh5D_get_pipeline(dataset);
+	entry->zone_type = parh5D_get_zone_type(dataset);
+	entry->bitmap_index = parh5D_get_bitmap_index(dataset);
+	entry->unstored = unstored;
+	/*Whole tiles of delta datasets are stored with their version appended*/
+	entry->tile_buf = calloc(1UL, tile_size_in_bytes + (entry->delta ? sizeof(uint64_t) : 0));
+	uint64_t bucket_id = parh5T_hash(cache, uuid);
+	entry->next = cache->buckets[bucket_id];
+	cache->buckets[bucket_id] = entry;
+	parh5T_queue_push(cache, entry, queue);
+	entry->pins = 1;
+	if (entry->delta && PARH5T_ACCESS_WRITE == access)
+		entry->written = calloc(1UL, (tile_size_in_bytes + 7) / 8);
+	else if (sparse_hit)
+		memcpy(entry->tile_buf, cache->sparse.tile_buf, tile_size_in_bytes);
+	else if (PARH5T_ACCESS_OVERWRITE == access || unstored) {
+		/*Edge tiles keep the fill value outside the dataset, so that they can be elided as well*/
+		if (entry->fill_tile)
+			parh5T_fill_tile(entry->fill_tile, entry->tile_buf, tile_size_in_bytes);
+	} else {
+		entry->loading = true;
+		pthread_mutex_unlock(&cache->lock);
+		bool found = parh5T_fetch_tile(cache, dataset, entry);
+		pthread_mutex_lock(&cache->lock);
+		entry->unstored = !found;
+		entry->loading = false;
+		pthread_cond_broadcast(&cache->tile_loaded);
+	}
+#ifdef METRICS_ENABLE
+	if (PARH5T_ACCESS_WRITE == access && NULL == entry->written && !sparse_hit)
+		parh5M_inc_dset_partially_written_tile(dataset);
+#endif
+	return entry;
+}
+
+/**
+ * @brief Unpins an entry returned by parh5T_get_entry, marking it dirty if
+ * the caller wrote to it. Marking it only now keeps a concurrent flush from
+ * taking the tile for clean while the write is half done.
+ */
+static void parh5T_release_entry(parh5T_tile_cache_t cache, struct parh5T_cache_entry *entry, bool written)
+{
+	pthread_mutex_lock(&cache->lock);
+	if (written)
+		entry->dirty = true;
+	entry->pins--;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+parh5T_tile_cache_t parh5T_init_tile_cache(par_handle par_db, uint64_t capacity_in_bytes)
+{
+	parh5T_tile_cache_t cache = calloc(1UL, sizeof(*cache));
+	cache->par_db = par_db;
+	cache->capacity_in_bytes = capacity_in_bytes;
+	cache->num_buckets = capacity_in_bytes / PARH5T_TYPICAL_TILE_SIZE;
+	if (cache->num_buckets < PARH5T_MIN_NUM_BUCKETS)
+		cache->num_buckets = PARH5T_MIN_NUM_BUCKETS;
+	cache->buckets = calloc(cache->num_buckets, sizeof(*cache->buckets));
+	pthread_mutex_init(&cache->lock, NULL);
+	pthread_cond_init(&cache->tile_loaded, NULL);
+	pthread_cond_init(&cache->put_queued, NULL);
+	pthread_cond_init(&cache->tile_stored, NULL);
+	log_debug("Tile cache capacity: %lu bytes", capacity_in_bytes);
+	return cache;
+}
+
+void parh5T_reserve_tile_cache(parh5T_tile_cache_t cache, uint64_t capacity_in_bytes)
+{
+	pthread_mutex_lock(&cache->lock);
+	if (capacity_in_bytes > cache->capacity_in_bytes) {
+		log_debug("Growing tile cache capacity from %lu to %lu bytes", cache->capacity_in_bytes,
+			  capacity_in_bytes);
+		cache->capacity_in_bytes = capacity_in_bytes;
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * @brief Fetches into the sparse read buffer a tile that is not cached and
+ * remembers it with a ghost entry in A1out. There is a single sparse buffer,
+ * the caller holds the cache lock until it is done with it. The lock is
+ * dropped during the fetch, like on a miss, threads that want the buffer
+ * meanwhile wait for it.
+ * @return the sparse buffer, NULL if the tile is cached or referenced
+ * recently and takes the regular path
+ */
+static const char *parh5T_get_sparse_tile(parh5T_tile_cache_t cache, parh5D_dataset_t dataset,
+					  struct parh5T_tile_uuid uuid)
+{
+	struct parh5T_cache_entry *sparse = &cache->sparse;
+	while (sparse->loading)
+		pthread_cond_wait(&cache->tile_loaded, &cache->lock);
+	if (parh5T_lookup(cache, uuid))
+		return NULL;
+	uint32_t tile_size_in_bytes = parh5T_get_tile_size(dataset);
+	if (parh5T_sparse_holds(cache, uuid)) {
+#ifdef METRICS_ENABLE
+		parh5M_inc_cache_hits(dataset);
+#endif
+		return sparse->tile_buf;
+	}
+#ifdef METRICS_ENABLE
+	parh5M_inc_cache_miss(dataset);
+#endif
+	if (sparse->tile_size_in_bytes != tile_size_in_bytes) {
+		free(sparse->tile_buf);
+		sparse->tile_buf = calloc(1UL, tile_size_in_bytes + sizeof(uint64_t));
+		sparse->tile_size_in_bytes = tile_size_in_bytes;
+	}
+	sparse->uuid = uuid;
+	sparse->delta = parh5D_get_delta_threshold(dataset) > 0;
+	sparse->loading = true;
+	cache->sparse_valid = false;
+	pthread_mutex_unlock(&cache->lock);
+	bool found = parh5T_fetch_tile(cache, dataset, sparse);
+	pthread_mutex_lock(&cache->lock);
+	/*Nothing to write back, consolidation waits for a regular read*/
+	sparse->dirty = false;
+	free(sparse->delta_versions);
+	sparse->delta_versions = NULL;
+	sparse->num_deltas = 0;
+	sparse->loading = false;
+	cache->sparse_valid = true;
+	pthread_cond_broadcast(&cache->tile_loaded);
+
+	/*A ghost entry remembers the tile, if it is read again it enters Am*/
+	struct parh5T_cache_entry *ghost = calloc(1UL, sizeof(*ghost));
+	ghost->uuid = uuid;
+	ghost->tile_size_in_bytes = tile_size_in_bytes;
+	ghost->unstored = !found;
+	uint64_t bucket_id = parh5T_hash(cache, uuid);
+	ghost->next = cache->buckets[bucket_id];
+	cache->buckets[bucket_id] = ghost;
+	parh5T_queue_push(cache, ghost, PARH5T_A1OUT);
+	parh5T_trim_a1out(cache);
+	return sparse->tile_buf;
+}
+
+/**
+ * @brief memcpy with the common element sizes spelled out, so that the
+ * segments of point selections, one element each, compile to plain loads
+ * and stores instead of library calls.
+ */
+static inline void parh5T_copy(char *dst, const char *src, uint32_t size)
+{
+	switch (size) {
+	case 1:
+		*dst = *src;
+		break;
+	case 2:
+		memcpy(dst, src, 2);
+		break;
+	case 4:
+		memcpy(dst, src, 4);
+		break;
+	case 8:
+		memcpy(dst, src, 8);
+		break;
+	case 16:
+		memcpy(dst, src, 16);
+		break;
+	default:
+		memcpy(dst, src, size);
+	}
+}
+
+static bool parh5T_segment_fits(const struct parh5T_segment *segment, uint32_t tile_size_in_bytes)
+{
+	if (segment->offt_in_tile + segment->size <= tile_size_in_bytes)
+		return true;
+	log_warn("Segment crosses tile boundary offt: %lu size: %u tile size: %u", segment->offt_in_tile,
+		 segment->size, tile_size_in_bytes);
+	return false;
+}
+
+bool parh5T_read_segments_from_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset,
+					  struct parh5T_tile_uuid uuid, const struct parh5T_segment segments[],
+					  size_t num_segments, bool sparse)
+{
+	const char *tile_buf = NULL;
+	uint32_t tile_size_in_bytes = 0;
+	struct parh5T_cache_entry *entry = NULL;
+	pthread_mutex_lock(&cache->lock);
+	if (sparse)
+		tile_buf = parh5T_get_sparse_tile(cache, dataset, uuid);
+	if (tile_buf)
+		tile_size_in_bytes = cache->sparse.tile_size_in_bytes;
+	else {
+		entry = parh5T_get_entry(cache, dataset, uuid, PARH5T_ACCESS_READ);
+		pthread_mutex_unlock(&cache->lock);
+		tile_buf = entry->tile_buf;
+		tile_size_in_bytes = entry->tile_size_in_bytes;
+	}
+	bool success = true;
+	for (size_t i = 0; success && i < num_segments; i++) {
+		success = parh5T_segment_fits(&segments[i], tile_size_in_bytes);
+		if (success)
+			parh5T_copy(segments[i].buffer, &tile_buf[segments[i].offt_in_tile], segments[i].size);
+	}
+	if (entry)
+		parh5T_release_entry(cache, entry, false);
+	else
+		pthread_mutex_unlock(&cache->lock);
+	return success;
+}
+
+bool parh5T_write_segments_to_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset,
+					 struct parh5T_tile_uuid uuid, const struct parh5T_segment segments[],
+					 size_t num_segments, bool overwrite)
+{
+	pthread_mutex_lock(&cache->lock);
+	/*The pin keeps an overwritten tile from being evicted, and fetched back, before the segments land*/
+	struct parh5T_cache_entry *entry =
+		parh5T_get_entry(cache, dataset, uuid, overwrite ? PARH5T_ACCESS_OVERWRITE : PARH5T_ACCESS_WRITE);
+	pthread_mutex_unlock(&cache->lock);
+	size_t i = 0;
+	for (; i < num_segments && parh5T_segment_fits(&segments[i], entry->tile_size_in_bytes); i++) {
+		uint32_t offt_in_tile = segments[i].offt_in_tile;
+		parh5T_copy(&entry->tile_buf[offt_in_tile], segments[i].buffer, segments[i].size);
+		if (entry->written)
+			parh5T_mark_written(entry, offt_in_tile, segments[i].size);
+	}
+	parh5T_release_entry(cache, entry, i > 0);
+	return i == num_segments;
+}
+
+bool parh5T_read_from_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, struct parh5T_tile tile,
+				 char *buffer, uint32_t size)
+{
+	struct parh5T_segment segment = { .buffer = buffer, .offt_in_tile = tile.offt_in_tile, .size = size };
+	return parh5T_read_segments_from_tile_cache(cache, dataset, tile.uuid, &segment, 1, false);
+}
+
+bool parh5T_read_sparse_from_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, struct parh5T_tile tile,
+					char *buffer, uint32_t size)
+{
+	struct parh5T_segment segment = { .buffer = buffer, .offt_in_tile = tile.offt_in_tile, .size = size };
+	return parh5T_read_segments_from_tile_cache(cache, dataset, tile.uuid, &segment, 1, true);
+}
+
+bool parh5T_write_to_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, struct parh5T_tile tile,
+				const char *buffer, uint32_t size)
+{
+	struct parh5T_segment segment = { .buffer = (char *)buffer, .offt_in_tile = tile.offt_in_tile, .size = size };
+	return parh5T_write_segments_to_tile_cache(cache, dataset, tile.uuid, &segment, 1, false);
+}
+
+void parh5T_read_tile(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, struct parh5T_tile_uuid uuid,
+		      parh5T_scan_cb read_cb, void *cb_arg)
+{
+	pthread_mutex_lock(&cache->lock);
+	struct parh5T_cache_entry *entry = parh5T_get_entry(cache, dataset, uuid, PARH5T_ACCESS_READ);
+	pthread_mutex_unlock(&cache->lock);
+	read_cb(uuid.tile_id, entry->tile_buf, entry->tile_size_in_bytes, cb_arg);
+	parh5T_release_entry(cache, entry, false);
+}
+
+static int parh5T_cmp_entries(const void *entry_a, const void *entry_b)
+{
+	const struct parh5T_cache_entry *a = *(struct parh5T_cache_entry *const *)entry_a;
+	const struct parh5T_cache_entry *b = *(struct parh5T_cache_entry *const *)entry_b;
+	if (a->uuid.dset_id != b->uuid.dset_id)
+		return a->uuid.dset_id < b->uuid.dset_id ? -1 : 1;
+	return a->uuid.tile_id < b->uuid.tile_id ? -1 : a->uuid.tile_id > b->uuid.tile_id;
+}
+
+static size_t parh5T_collect_dirty(struct parh5T_queue *queue, bool all, uint64_t dset_id,
+				   struct parh5T_cache_entry **dirty, size_t num_dirty)
+{
+	for (struct parh5T_cache_entry *entry = queue->head; entry; entry = entry->q_next) {
+		if (entry->dirty && (all || entry->uuid.dset_id == dset_id))
+			dirty[num_dirty++] = entry;
+	}
+	return num_dirty;
+}
+
+/**
+ * @brief Writes back the dirty tiles of one dataset, or of all datasets, in
+ * key order, which is the order Parallax ingests best. Tiles written by
+ * several datasets, for example through H5Dwrite_multi, reach Parallax in a
+ * single sorted pass. The tiles are copied to the put stage while the put
+ * thread stores the ones before them, the flush returns once all are
+ * stored. The collected tiles are pinned, so they stay cached while the
+ * flush waits for room in the put stage.
+ */
+static void parh5T_flush(parh5T_tile_cache_t cache, bool all, uint64_t dset_id)
+{
+	pthread_mutex_lock(&cache->lock);
+	size_t max_entries = 0;
+	for (struct parh5T_cache_entry *entry = cache->a1in.head; entry; entry = entry->q_next)
+		max_entries++;
+	for (struct parh5T_cache_entry *entry = cache->am.head; entry; entry = entry->q_next)
+		max_entries++;
+	if (0 == max_entries) {
+		parh5T_drain_puts(cache);
+		pthread_mutex_unlock(&cache->lock);
+		return;
+	}
+
+	struct parh5T_cache_entry **dirty = calloc(max_entries, sizeof(*dirty));
+	size_t num_dirty = parh5T_collect_dirty(&cache->a1in, all, dset_id, dirty, 0);
+	num_dirty = parh5T_collect_dirty(&cache->am, all, dset_id, dirty, num_dirty);
+	qsort(dirty, num_dirty, sizeof(*dirty), parh5T_cmp_entries);
+	for (size_t i = 0; i < num_dirty; i++)
+		dirty[i]->pins++;
+	for (size_t i = 0; i < num_dirty; i++) {
+		parh5T_wait_for_put_room(cache, dirty[i]->tile_size_in_bytes);
+		/*A written delta tile being loaded keeps its bytes, they are stored once it is*/
+		while (dirty[i]->loading)
+			pthread_cond_wait(&cache->tile_loaded, &cache->lock);
+		/*Another flush may have stored it while this one waited*/
+		if (dirty[i]->dirty)
+			parh5T_store_tile(cache, dirty[i], false);
+		dirty[i]->pins--;
+	}
+	parh5T_drain_puts(cache);
+	pthread_mutex_unlock(&cache->lock);
+	free(dirty);
+}
+
+void parh5T_scan_tiles(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, uint64_t first_tile_id,
+		       uint64_t last_tile_id, parh5T_scan_cb scan_cb, void *cb_arg)
+{
+	parh5T_flush_dataset_tiles(cache, parh5I_get_inode_num(parh5D_get_inode(dataset)));
+	parh5T_scan_tiles_no_flush(cache, dataset, first_tile_id, last_tile_id, scan_cb, cb_arg);
+}
+
+void parh5T_scan_tiles_no_flush(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, uint64_t first_tile_id,
+				uint64_t last_tile_id, parh5T_scan_cb scan_cb, void *cb_arg)
+{
+	struct parh5T_tile_uuid uuid = { .dset_id = parh5I_get_inode_num(parh5D_get_inode(dataset)),
+					 .tile_id = first_tile_id };
+	par_scanner scanner = parh5T_init_tile_scanner(cache, uuid);
+	uint32_t tile_size_in_bytes = parh5T_get_tile_size(dataset);
+	char *tile_buf = calloc(1UL, tile_size_in_bytes);
+	if (parh5D_get_delta_threshold(dataset) > 0) {
+		uint64_t tile_id = 0;
+		while (parh5T_merge_tile(scanner, dataset, false, &tile_id, tile_buf, NULL) && tile_id <= last_tile_id) {
+#ifdef METRICS_ENABLE
+			parh5M_inc_dset_read_ntiles(dataset);
+#endif
+			scan_cb(tile_id, tile_buf, tile_size_in_bytes, cb_arg);
+		}
+		free(tile_buf);
+		par_close_scanner(scanner);
+		return;
+	}
+
+	char start_key_buffer[PARH5T_TILE_KEY_SIZE];
+	parh5T_construct_tile_key(uuid, start_key_buffer);
+	for (; par_is_valid(scanner); par_get_next(scanner)) {
+		struct par_key tile_key = par_get_key(scanner);
+		/*Dataset ids are the prefix of the key, stop at the first key of another dataset*/
+		if (tile_key.size != PARH5T_TILE_KEY_SIZE ||
+		    memcmp(tile_key.data, start_key_buffer, 1UL + sizeof(uuid.dset_id)))
+			break;
+		uint64_t tile_id = 0;
+		memcpy(&tile_id, &tile_key.data[1 + sizeof(uuid.dset_id)], sizeof(tile_id));
+		tile_id = be64toh(tile_id);
+		if (tile_id > last_tile_id)
+			break;
+		struct par_value tile_value = par_get_value(scanner);
+		parh5T_decode_tile(dataset, tile_id, tile_value.val_buffer, tile_value.val_size, tile_buf);
+#ifdef METRICS_ENABLE
+		parh5M_inc_dset_read_ntiles(dataset);
+#endif
+		scan_cb(tile_id, tile_buf, tile_size_in_bytes, cb_arg);
+	}
+	free(tile_buf);
+	par_close_scanner(scanner);
+}
+
+/**
+ * @brief Streams the values kept under key_prefix next to the tiles of a
+ * dataset, laid out like tile keys, in tile id order. The caller writes the
+ * dirty tiles of the dataset back first.
+ */
+static void parh5T_scan_tile_side_keys(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, char key_prefix,
+				       parh5T_scan_cb scan_cb, void *cb_arg)
+{
+	struct parh5T_tile_uuid uuid = { .dset_id = parh5I_get_inode_num(parh5D_get_inode(dataset)), .tile_id = 0 };
+	char start_key_buffer[PARH5T_TILE_KEY_SIZE];
+	parh5T_construct_tile_key(uuid, start_key_buffer);
+	start_key_buffer[0] = key_prefix;
+	struct par_key start_key = { .size = sizeof(start_key_buffer), .data = start_key_buffer };
+	const char *error = NULL;
+	par_scanner scanner = par_init_scanner(cache->par_db, &start_key, PAR_GREATER_OR_EQUAL, &error);
+	if (error) {
+		log_fatal("Failed to init scanner reason: %s", error);
+		_exit(EXIT_FAILURE);
+	}
+	for (; par_is_valid(scanner); par_get_next(scanner)) {
+		struct par_key side_key = par_get_key(scanner);
+		if (side_key.size != PARH5T_TILE_KEY_SIZE ||
+		    memcmp(side_key.data, start_key_buffer, 1UL + sizeof(uuid.dset_id)))
+			break;
+		uint64_t tile_id = 0;
+		memcpy(&tile_id, &side_key.data[1 + sizeof(uuid.dset_id)], sizeof(tile_id));
+		tile_id = be64toh(tile_id);
+		struct par_value side_value = par_get_value(scanner);
+		scan_cb(tile_id, side_value.val_buffer, side_value.val_size, cb_arg);
+	}
+	par_close_scanner(scanner);
+}
+
+struct parh5T_zone_scan {
+	parh5T_zone_cb zone_cb;
+	void *cb_arg;
+};
+
+static void parh5T_scan_zone(uint64_t tile_id, const char *zone_buf, uint32_t size, void *cb_arg)
+{
+	struct parh5T_zone_scan *scan = cb_arg;
+	struct parh5S_zone zone;
+	/*A zone map of another layout tells nothing of its tile*/
+	if (sizeof(zone) == size)
+		memcpy(&zone, zone_buf, sizeof(zone));
+	else
+		parh5S_set_inexact_zone(&zone);
+	scan->zone_cb(tile_id, &zone, scan->cb_arg);
+}
+
+void parh5T_scan_zones(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, parh5T_zone_cb zone_cb, void *cb_arg)
+{
+	struct parh5T_zone_scan scan = { .zone_cb = zone_cb, .cb_arg = cb_arg };
+	parh5T_scan_tile_side_keys(cache, dataset, PARH5T_ZONE_KEY_PREFIX, parh5T_scan_zone, &scan);
+}
+
+void parh5T_scan_bitmaps(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, parh5T_scan_cb bitmap_cb, void *cb_arg)
+{
+	parh5T_scan_tile_side_keys(cache, dataset, PARH5T_BITMAP_KEY_PREFIX, bitmap_cb, cb_arg);
+}
+
+void parh5T_flush_dataset_tiles(parh5T_tile_cache_t cache, uint64_t dset_id)
+{
+	if (NULL == cache)
+		return;
+	parh5T_flush(cache, false, dset_id);
+}
+
+void parh5T_flush_tile_cache(parh5T_tile_cache_t cache)
+{
+	if (NULL == cache)
+		return;
+	parh5T_flush(cache, true, 0);
+}
+
+void parh5T_wait_for_puts(parh5T_tile_cache_t cache)
+{
+	if (NULL == cache)
+		return;
+	pthread_mutex_lock(&cache->lock);
+	parh5T_drain_puts(cache);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void parh5T_destroy_tile_cache(parh5T_tile_cache_t cache)
+{
+	if (NULL == cache)
+		return;
+	parh5T_flush_tile_cache(cache);
+	pthread_mutex_lock(&cache->lock);
+	cache->put_shutdown = true;
+	pthread_cond_signal(&cache->put_queued);
+	pthread_mutex_unlock(&cache->lock);
+	if (cache->put_thread_started)
+		pthread_join(cache->put_thread, NULL);
+	while (cache->a1in.tail)
+		parh5T_free_entry(cache, cache->a1in.tail);
+	while (cache->am.tail)
+		parh5T_free_entry(cache, cache->am.tail);
+	while (cache->a1out.tail)
+		parh5T_free_entry(cache, cache->a1out.tail);
+	parh5T_drop_tile(&cache->sparse);
+	pthread_cond_destroy(&cache->tile_stored);
+	pthread_cond_destroy(&cache->put_queued);
+	pthread_cond_destroy(&cache->tile_loaded);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->buckets);
+	free(cache);
+}
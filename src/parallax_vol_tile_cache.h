@@ -0,0 +1,214 @@
+#ifndef PARALLAX_VOL_TILE_CACHE_H
+#define PARALLAX_VOL_TILE_CACHE_H
+#include <parallax/structures.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+typedef struct parh5D_dataset *parh5D_dataset_t;
+typedef struct parh5T_tile_cache *parh5T_tile_cache_t;
+struct parh5S_zone;
+
+struct parh5T_tile_uuid {
+	uint64_t dset_id;
+	uint64_t tile_id;
+};
+
+struct parh5T_tile {
+	struct parh5T_tile_uuid uuid;
+	uint64_t offt_in_tile; /*in bytes*/
+};
+
+/**
+ * @brief Creates the tile cache of a file. All datasets of the file share
+ * it. Modified tiles stay in memory and reach Parallax when they are evicted
+ * or the cache is flushed, through a put stage: the thread that evicts or
+ * flushes a tile assembles its value and a thread of the cache issues the
+ * put, so assembling the next tile overlaps storing the last one. The put
+ * stage holds up to a quarter of the budget on top of it. The put thread
+ * also encodes the tiles (see parh5E_encode_tile), or runs them through
+ * the HDF5 filters of their dataset if it has any, behind the lossy codec
+ * of datasets with an error bound (see parh5Q_compress_tile). Tiles that
+ * hold only the fill value of their dataset are not stored. Datasets with
+ * zone maps get the zone map of a tile stored next to it (see
+ * parh5T_scan_zones), datasets with a bitmap index its bitmaps (see
+ * parh5T_scan_bitmaps). Replacement follows the 2Q policy: tiles accessed
+ * once pass through a FIFO queue and only tiles referenced again after
+ * leaving it enter the LRU queue, so large scans do not push out hot tiles.
+ * The workers of a transfer share the cache: lookups are serialized, while
+ * Parallax fetches and copies of different tiles run concurrently. Threads
+ * that write must not touch the same tile at the same time.
+ * @param [in] par_db the Parallax db that hosts the tiles
+ * @param [in] capacity_in_bytes the memory budget of the cache
+ * @return pointer to the cache object
+ */
+parh5T_tile_cache_t parh5T_init_tile_cache(par_handle par_db, uint64_t capacity_in_bytes);
+
+/**
+ * @brief Raises the memory budget of the cache to at least capacity_in_bytes.
+ */
+void parh5T_reserve_tile_cache(parh5T_tile_cache_t cache, uint64_t capacity_in_bytes);
+
+/**
+ * @brief Copies size bytes starting at tile.offt_in_tile into buffer. On a
+ * miss it fetches the tile from Parallax. Tiles never written read as the
+ * fill value of the dataset (see parh5D_get_fill_tile).
+ * @param [in] cache reference to the cache object
+ * @param [in] dataset the dataset the tile belongs to
+ * @param [in] tile the tile and the offset within it
+ * @param [out] buffer where to copy the data
+ * @param [in] size number of bytes, it must not cross the tile boundary
+ * @return true on success false on failure
+ */
+bool parh5T_read_from_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, struct parh5T_tile tile,
+				 char *buffer, uint32_t size);
+
+/**
+ * @brief Like parh5T_read_from_tile_cache for reads that select a small part
+ * of a tile. Parallax has no partial value reads, so a tile that is neither
+ * cached nor referenced recently is fetched into a buffer of its own instead
+ * of the cache. That spares the cache the tiles of point lookups and the
+ * evictions they would cause. The tile is remembered as recently referenced
+ * (2Q ghost), so a second read loads it in the cache.
+ */
+bool parh5T_read_sparse_from_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, struct parh5T_tile tile,
+					char *buffer, uint32_t size);
+
+/**
+ * @brief Copies size bytes from buffer into the tile starting at
+ * tile.offt_in_tile and marks the tile dirty.
+ * @param [in] cache reference to the cache object
+ * @param [in] dataset the dataset the tile belongs to
+ * @param [in] tile the tile and the offset within it
+ * @param [in] buffer the data to write
+ * @param [in] size number of bytes, it must not cross the tile boundary
+ * @return true on success false on failure
+ */
+bool parh5T_write_to_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, struct parh5T_tile tile,
+				const char *buffer, uint32_t size);
+
+/*A piece of a tile and where it goes to, or comes from, in the application buffer*/
+struct parh5T_segment {
+	char *buffer;
+	uint64_t offt_in_tile; /*in bytes*/
+	uint32_t size;
+};
+
+/**
+ * @brief Batched parh5T_read_from_tile_cache for many pieces of one tile,
+ * e.g. the points of an element selection that fall in it. The tile is
+ * looked up, and fetched on a miss, once for all of them.
+ * @param [in] cache reference to the cache object
+ * @param [in] dataset the dataset the tile belongs to
+ * @param [in] uuid the tile
+ * @param [in] segments the pieces to copy, none may cross the tile boundary
+ * @param [in] num_segments the number of segments
+ * @param [in] sparse serve the read like parh5T_read_sparse_from_tile_cache
+ * @return true on success false on failure
+ */
+bool parh5T_read_segments_from_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset,
+					  struct parh5T_tile_uuid uuid, const struct parh5T_segment segments[],
+					  size_t num_segments, bool sparse);
+
+/**
+ * @brief Batched parh5T_write_to_tile_cache for many pieces of one tile.
+ * Segments are applied in array order, a later one overwrites the bytes an
+ * earlier one wrote.
+ * @param [in] overwrite the segments cover every element of the tile, if
+ * it is not cached it enters the cache filled with the fill value, without
+ * a Parallax lookup
+ */
+bool parh5T_write_segments_to_tile_cache(parh5T_tile_cache_t cache, parh5D_dataset_t dataset,
+					 struct parh5T_tile_uuid uuid, const struct parh5T_segment segments[],
+					 size_t num_segments, bool overwrite);
+
+typedef void (*parh5T_scan_cb)(uint64_t tile_id, const char *tile_buf, uint32_t size, void *cb_arg);
+
+/**
+ * @brief Streams with a single Parallax scanner the stored tiles of a
+ * dataset whose ids lie in [first_tile_id, last_tile_id], in id order.
+ * Dirty tiles of the dataset are written back first so that the scan sees
+ * the latest data. Tiles that were never stored are not reported, nor are
+ * tiles that hold only the fill value, they are not stored.
+ * @param [in] cache reference to the cache object
+ * @param [in] dataset the dataset whose tiles are scanned
+ * @param [in] first_tile_id the first tile id of the range
+ * @param [in] last_tile_id the last tile id of the range (inclusive)
+ * @param [in] scan_cb called for every tile found
+ * @param [in] cb_arg passed to scan_cb
+ */
+void parh5T_scan_tiles(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, uint64_t first_tile_id,
+		       uint64_t last_tile_id, parh5T_scan_cb scan_cb, void *cb_arg);
+
+/**
+ * @brief Like parh5T_scan_tiles without writing back the dirty tiles of the
+ * dataset first, for callers that flush once, e.g. with parh5D_flush, and
+ * then scan many ranges or zone maps.
+ */
+void parh5T_scan_tiles_no_flush(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, uint64_t first_tile_id,
+				uint64_t last_tile_id, parh5T_scan_cb scan_cb, void *cb_arg);
+
+typedef void (*parh5T_zone_cb)(uint64_t tile_id, const struct parh5S_zone *zone, void *cb_arg);
+
+/**
+ * @brief Streams the zone maps of the stored tiles of a dataset in tile id
+ * order, without reading the tiles. The caller writes the dirty tiles of the
+ * dataset back first, e.g. with parh5D_flush, so that the zone maps describe
+ * the latest data. Tiles without a zone map are not stored and hold the fill
+ * value.
+ * @param [in] cache reference to the cache object
+ * @param [in] dataset the dataset, it keeps zone maps (see
+ * parh5D_get_zone_type)
+ * @param [in] zone_cb called for every zone map
+ * @param [in] cb_arg passed to zone_cb
+ */
+void parh5T_scan_zones(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, parh5T_zone_cb zone_cb, void *cb_arg);
+
+/**
+ * @brief Streams the bitmaps of the stored tiles of a dataset in tile id
+ * order, like parh5T_scan_zones, without reading the tiles. Every stored
+ * tile has them, a tile without them holds the fill value.
+ * @param [in] cache reference to the cache object
+ * @param [in] dataset the dataset, it keeps a bitmap index (see
+ * parh5D_get_bitmap_index)
+ * @param [in] bitmap_cb called with the bitmaps of every tile (see
+ * parh5B_match_tile), the buffer is valid only during the call
+ * @param [in] cb_arg passed to bitmap_cb
+ */
+void parh5T_scan_bitmaps(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, parh5T_scan_cb bitmap_cb, void *cb_arg);
+
+/**
+ * @brief Passes the contents of a tile to read_cb, fetching the tile on a
+ * miss, so that callers copy many pieces of it with a single lookup.
+ * Tiles never written read as the fill value.
+ * @param [in] cache reference to the cache object
+ * @param [in] dataset the dataset the tile belongs to
+ * @param [in] uuid the tile
+ * @param [in] read_cb called once with the tile, the buffer is valid only
+ * during the call
+ * @param [in] cb_arg passed to read_cb
+ */
+void parh5T_read_tile(parh5T_tile_cache_t cache, parh5D_dataset_t dataset, struct parh5T_tile_uuid uuid,
+		      parh5T_scan_cb read_cb, void *cb_arg);
+
+/**
+ * @brief Writes back to Parallax the dirty tiles of a dataset. Tiles stay
+ * cached.
+ */
+void parh5T_flush_dataset_tiles(parh5T_tile_cache_t cache, uint64_t dset_id);
+
+/**
+ * @brief Writes back to Parallax all dirty tiles. Tiles stay cached.
+ */
+void parh5T_flush_tile_cache(parh5T_tile_cache_t cache);
+
+/**
+ * @brief Waits until the tiles handed to the put stage so far are stored in
+ * Parallax. Writes that evicted tiles call it unless they are buffered.
+ */
+void parh5T_wait_for_puts(parh5T_tile_cache_t cache);
+
+/**
+ * @brief Writes back all dirty tiles and frees the cache.
+ */
+void parh5T_destroy_tile_cache(parh5T_tile_cache_t cache);
+#endif
@@ -0,0 +1,1327 @@
+#include "parallax_vol_transfer.h"
+#include "parallax_vol_convert.h"
+#include "parallax_vol_dataset.h"
+#include "parallax_vol_inode.h"
+#include "parallax_vol_workers.h"
+#include <H5Spublic.h>
+#include <assert.h>
+#include <log.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+/*The AVX2 kernels are compiled for their target only and picked at runtime, the library runs on any x86-64*/
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PARH5X_AVX2
+#include <immintrin.h>
+#endif
+
+#define PARH5X_MIN(X, Y) ((X) < (Y) ? (X) : (Y))
+#define PARH5X_MAX(X, Y) ((X) > (Y) ? (X) : (Y))
+/*Reads that touch fewer tiles than this use point lookups*/
+#define PARH5X_SCAN_MIN_TILES 16
+/*Scan only if at least 1/PARH5X_SCAN_MIN_DENSITY of the scanned tile ids are selected*/
+#define PARH5X_SCAN_MIN_DENSITY 2
+/*Reads that select at most 1/PARH5X_SPARSE_MAX_DENSITY of a tile are sparse*/
+#define PARH5X_SPARSE_MAX_DENSITY 8
+/*Transfers that touch fewer tiles than this stay on the calling thread*/
+#define PARH5X_PARALLEL_MIN_TILES 8
+/*Parallel scan reads split the tile id range in this many scans per worker*/
+#define PARH5X_SCANS_PER_WORKER 2
+
+/**
+ * Walks a single block selection in row-major order as a sequence of runs
+ * of consecutive elements. Trailing dimensions that the block covers fully
+ * are folded into the run so that each run is as long as possible.
+ */
+struct parh5X_run_iter {
+	int ndims;
+	int run_dim; /*the outermost dimension the runs extend over*/
+	hsize_t shape[PARH5D_MAX_DIMENSIONS];
+	hsize_t start[PARH5D_MAX_DIMENSIONS];
+	hsize_t count[PARH5D_MAX_DIMENSIONS];
+	hsize_t coords[PARH5D_MAX_DIMENSIONS];
+	hsize_t run_len;
+	hsize_t runs_left;
+};
+
+static bool parh5X_init_run_iter(struct parh5X_run_iter *iter, hid_t space_id)
+{
+	int ndims = H5Sget_simple_extent_ndims(space_id);
+	if (ndims < 0 || ndims > PARH5D_MAX_DIMENSIONS) {
+		log_warn("Unsupported number of dimensions: %d", ndims);
+		return false;
+	}
+	iter->ndims = ndims;
+	if (0 == ndims) {
+		/*Scalar dataspace, a single element*/
+		iter->ndims = 1;
+		iter->shape[0] = iter->count[0] = 1;
+		iter->start[0] = 0;
+	} else
+		H5Sget_simple_extent_dims(space_id, iter->shape, NULL);
+
+	H5S_sel_type sel_type = H5Sget_select_type(space_id);
+	if (0 == ndims || H5S_SEL_ALL == sel_type) {
+		for (int dim = 0; dim < iter->ndims; dim++) {
+			iter->start[dim] = 0;
+			iter->count[dim] = iter->shape[dim];
+		}
+	} else if (H5S_SEL_HYPERSLABS == sel_type && H5Sis_regular_hyperslab(space_id) > 0) {
+		hsize_t stride[PARH5D_MAX_DIMENSIONS];
+		hsize_t count[PARH5D_MAX_DIMENSIONS];
+		hsize_t block[PARH5D_MAX_DIMENSIONS];
+		if (H5Sget_regular_hyperslab(space_id, iter->start, stride, count, block) < 0) {
+			log_fatal("Failed to get the regular hyperslab");
+			_exit(EXIT_FAILURE);
+		}
+		/*Only hyperslabs whose blocks touch each other form a single box*/
+		for (int dim = 0; dim < iter->ndims; dim++) {
+			if (count[dim] > 1 && stride[dim] != block[dim])
+				return false;
+			iter->count[dim] = count[dim] * block[dim];
+		}
+	} else
+		return false;
+
+	iter->run_dim = iter->ndims - 1;
+	while (iter->run_dim > 0 && 0 == iter->start[iter->run_dim] &&
+	       iter->count[iter->run_dim] == iter->shape[iter->run_dim])
+		iter->run_dim--;
+
+	iter->run_len = iter->count[iter->run_dim];
+	for (int dim = iter->run_dim + 1; dim < iter->ndims; dim++)
+		iter->run_len *= iter->shape[dim];
+
+	iter->runs_left = 1;
+	for (int dim = 0; dim < iter->run_dim; dim++) {
+		iter->runs_left *= iter->count[dim];
+		iter->coords[dim] = iter->start[dim];
+	}
+	return true;
+}
+
+/**
+ * @brief Returns the next run of the selection.
+ * @param [in] iter the run iterator
+ * @param [out] elem_id the row-major id of the first element of the run
+ * @param [out] run_len the number of elements of the run
+ * @return true if a run was returned false if the selection is exhausted
+ */
+static bool parh5X_next_run(struct parh5X_run_iter *iter, hsize_t *elem_id, hsize_t *run_len)
+{
+	if (0 == iter->runs_left)
+		return false;
+
+	hsize_t id = 0;
+	for (int dim = 0; dim < iter->ndims; dim++) {
+		hsize_t coord = 0;
+		if (dim < iter->run_dim)
+			coord = iter->coords[dim];
+		else if (dim == iter->run_dim)
+			coord = iter->start[dim];
+		id = id * iter->shape[dim] + coord;
+	}
+	*elem_id = id;
+	*run_len = iter->run_len;
+
+	if (0 == --iter->runs_left)
+		return true;
+
+	for (int dim = iter->run_dim - 1; dim >= 0; dim--) {
+		if (++iter->coords[dim] < iter->start[dim] + iter->count[dim])
+			break;
+		iter->coords[dim] = iter->start[dim];
+	}
+	return true;
+}
+
+/**
+ * The application side of a transfer. When the memory type differs from
+ * the dataset type, elements go through the converter and the stage buffer
+ * holds them in the dataset type.
+ */
+struct parh5X_mem {
+	char *buf;
+	size_t elem_size;
+	size_t file_elem_size;
+	parh5C_converter_t conv; /*NULL if the types are the same*/
+	char *stage;
+	size_t stage_size;
+};
+
+static char *parh5X_get_stage(struct parh5X_mem *mem, size_t size)
+{
+	if (size > mem->stage_size) {
+		free(mem->stage);
+		mem->stage = calloc(1UL, size);
+		mem->stage_size = size;
+	}
+	return mem->stage;
+}
+
+/**
+ * @brief Copies num_elems elements in the dataset type to memory,
+ * converting them if needed.
+ */
+static void parh5X_copy_to_mem(struct parh5X_mem *mem, const char *src, char *mem_addr, size_t num_elems)
+{
+	if (mem->conv)
+		parh5C_convert(mem->conv, src, mem_addr, num_elems);
+	else
+		memcpy(mem_addr, src, num_elems * mem->file_elem_size);
+}
+
+/**
+ * @brief Returns the num_elems elements at mem_addr in the dataset type,
+ * converted in the stage buffer if needed.
+ */
+static const char *parh5X_copy_from_mem(struct parh5X_mem *mem, const char *mem_addr, size_t num_elems)
+{
+	if (NULL == mem->conv)
+		return mem_addr;
+	char *stage = parh5X_get_stage(mem, num_elems * mem->file_elem_size);
+	parh5C_convert(mem->conv, mem_addr, stage, num_elems);
+	return stage;
+}
+
+/*Copies count elements, src_stride and dst_stride bytes apart*/
+typedef void (*parh5X_copy_fn)(char *dst, size_t dst_stride, const char *src, size_t src_stride, size_t count,
+			       size_t elem_size);
+
+static void parh5X_copy_elems(char *dst, size_t dst_stride, const char *src, size_t src_stride, size_t count,
+			      size_t elem_size)
+{
+	for (size_t i = 0; i < count; i++)
+		memcpy(&dst[i * dst_stride], &src[i * src_stride], elem_size);
+}
+
+/*The element size is a constant, memcpy compiles to a single load and store*/
+#define PARH5X_DEFINE_COPY(SIZE)                                                                                \
+	static void parh5X_copy_##SIZE(char *dst, size_t dst_stride, const char *src, size_t src_stride,        \
+				       size_t count, size_t elem_size)                                          \
+	{                                                                                                       \
+		(void)elem_size;                                                                                \
+		for (size_t i = 0; i < count; i++)                                                              \
+			memcpy(&dst[i * dst_stride], &src[i * src_stride], SIZE);                               \
+	}
+
+PARH5X_DEFINE_COPY(1)
+PARH5X_DEFINE_COPY(2)
+PARH5X_DEFINE_COPY(4)
+PARH5X_DEFINE_COPY(8)
+PARH5X_DEFINE_COPY(16)
+
+#ifdef PARH5X_AVX2
+/**
+ * @brief Gathers a strided column into a contiguous buffer 8 elements at a
+ * time. AVX2 has no scatter, strided destinations take the scalar loop.
+ */
+__attribute__((target("avx2"))) static void parh5X_copy_4_avx2(char *dst, size_t dst_stride, const char *src,
+								size_t src_stride, size_t count, size_t elem_size)
+{
+	(void)elem_size;
+	size_t i = 0;
+	if (sizeof(uint32_t) == dst_stride && src_stride <= INT32_MAX / 8) {
+		int stride = src_stride;
+		__m256i idx = _mm256_setr_epi32(0, stride, 2 * stride, 3 * stride, 4 * stride, 5 * stride, 6 * stride,
+						7 * stride);
+		for (; i + 8 <= count; i += 8) {
+			__m256i elems = _mm256_i32gather_epi32((const int *)&src[i * src_stride], idx, 1);
+			_mm256_storeu_si256((__m256i *)&dst[i * sizeof(uint32_t)], elems);
+		}
+	}
+	for (; i < count; i++)
+		memcpy(&dst[i * dst_stride], &src[i * src_stride], sizeof(uint32_t));
+}
+
+/**
+ * @brief parh5X_copy_4_avx2 for 8 byte elements, 4 at a time.
+ */
+__attribute__((target("avx2"))) static void parh5X_copy_8_avx2(char *dst, size_t dst_stride, const char *src,
+								size_t src_stride, size_t count, size_t elem_size)
+{
+	(void)elem_size;
+	size_t i = 0;
+	if (sizeof(uint64_t) == dst_stride && src_stride <= INT32_MAX / 4) {
+		int stride = src_stride;
+		__m128i idx = _mm_setr_epi32(0, stride, 2 * stride, 3 * stride);
+		for (; i + 4 <= count; i += 4) {
+			__m256i elems = _mm256_i32gather_epi64((const long long *)&src[i * src_stride], idx, 1);
+			_mm256_storeu_si256((__m256i *)&dst[i * sizeof(uint64_t)], elems);
+		}
+	}
+	for (; i < count; i++)
+		memcpy(&dst[i * dst_stride], &src[i * src_stride], sizeof(uint64_t));
+}
+
+static bool parh5X_has_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+static parh5X_copy_fn parh5X_select_copy(size_t elem_size)
+{
+	switch (elem_size) {
+	case 1:
+		return parh5X_copy_1;
+	case 2:
+		return parh5X_copy_2;
+#ifdef PARH5X_AVX2
+	case 4:
+		return parh5X_has_avx2() ? parh5X_copy_4_avx2 : parh5X_copy_4;
+	case 8:
+		return parh5X_has_avx2() ? parh5X_copy_8_avx2 : parh5X_copy_8;
+#else
+	case 4:
+		return parh5X_copy_4;
+	case 8:
+		return parh5X_copy_8;
+#endif
+	case 16:
+		return parh5X_copy_16;
+	default:
+		return parh5X_copy_elems;
+	}
+}
+
+/**
+ * @brief Returns the workers to fan a transfer of num_tiles tiles out to,
+ * NULL if it runs on the calling thread. Small transfers are not worth the
+ * wake ups, and conversions that go through the HDF5 library stay on the
+ * application thread.
+ */
+static parh5W_pool_t parh5X_get_workers(parh5W_pool_t workers, struct parh5X_mem *mem, uint64_t num_tiles)
+{
+	if (parh5W_get_num_workers(workers) < 2 || num_tiles < PARH5X_PARALLEL_MIN_TILES)
+		return NULL;
+	return NULL == mem->conv || parh5C_is_thread_safe(mem->conv) ? workers : NULL;
+}
+
+/**
+ * A transfer between a box of the dataset and a box of the same shape in
+ * memory that walks the tiles of the file box one at a time. Each tile is
+ * visited once, so the tile cache needs room for a single tile per worker.
+ * Workers take whole tiles, each on a copy of the box of its own.
+ */
+struct parh5X_box {
+	parh5D_dataset_t dataset;
+	parh5T_tile_cache_t cache;
+	parh5W_pool_t workers;
+	struct parh5X_mem *mem;
+	size_t elem_size;
+	int ndims;
+	const hsize_t *tile_dims;
+	struct parh5X_run_iter *file_iter;
+	struct parh5X_run_iter *mem_iter;
+	hsize_t first_tile[PARH5D_MAX_DIMENSIONS]; /*tile coordinates of the box corners*/
+	hsize_t last_tile[PARH5D_MAX_DIMENSIONS];
+	uint64_t num_tiles;
+	uint64_t num_scans; /*scan reads: the number of ranges the tile ids are split in*/
+	uint8_t *tiles_found; /*scan reads: one byte per tile of the box*/
+	parh5X_copy_fn copy; /*for rows of a single element, selected once per transfer*/
+	struct parh5T_segment *rows; /*writes: the rows of the current tile, allocated on first use*/
+};
+
+/*What to do with each row of a tile that falls in the box, overwrites cover the whole tile*/
+enum parh5X_row_op { PARH5X_COPY_TO_MEM = 1, PARH5X_ZERO_MEM, PARH5X_WRITE_TO_CACHE, PARH5X_OVERWRITE_CACHE };
+
+static bool parh5X_init_box(struct parh5X_box *box, parh5D_dataset_t dataset, parh5T_tile_cache_t cache,
+			    parh5W_pool_t workers, struct parh5X_run_iter *file_iter, struct parh5X_run_iter *mem_iter,
+			    struct parh5X_mem *mem)
+{
+	if (file_iter->ndims != mem_iter->ndims || (uint32_t)file_iter->ndims != parh5D_get_tile_rank(dataset))
+		return false;
+	for (int dim = 0; dim < file_iter->ndims; dim++) {
+		if (file_iter->count[dim] != mem_iter->count[dim])
+			return false;
+	}
+	box->dataset = dataset;
+	box->cache = cache;
+	box->workers = workers;
+	box->mem = mem;
+	box->elem_size = parh5D_get_elems_size_in_bytes(dataset);
+	box->copy = parh5X_select_copy(box->elem_size);
+	box->ndims = file_iter->ndims;
+	box->tile_dims = parh5D_get_tile_dims(dataset);
+	box->file_iter = file_iter;
+	box->mem_iter = mem_iter;
+	box->num_tiles = 1;
+	for (int dim = 0; dim < box->ndims; dim++) {
+		box->first_tile[dim] = file_iter->start[dim] / box->tile_dims[dim];
+		box->last_tile[dim] = (file_iter->start[dim] + file_iter->count[dim] - 1) / box->tile_dims[dim];
+		box->num_tiles *= box->last_tile[dim] - box->first_tile[dim] + 1;
+	}
+	return true;
+}
+
+/**
+ * @brief Applies op to every row of the part of a tile that falls in the
+ * box. tile_buf is the source of PARH5X_COPY_TO_MEM. Rows that differ only
+ * in the next to last coordinate are a fixed stride apart in the tile and in
+ * memory, they are handled as a group: single element rows, e.g. of a
+ * column, go through the strided copy kernel. Writes pass all the rows of
+ * the tile to the tile cache at once, overwrites without fetching the tile.
+ */
+static void parh5X_tile_rows(struct parh5X_box *box, const hsize_t tile_coords[], enum parh5X_row_op op,
+			     const char *tile_buf)
+{
+	int ndims = box->ndims;
+	struct parh5X_run_iter *file_iter = box->file_iter;
+	struct parh5X_run_iter *mem_iter = box->mem_iter;
+	struct parh5X_mem *mem = box->mem;
+	hsize_t low[PARH5D_MAX_DIMENSIONS];
+	hsize_t high[PARH5D_MAX_DIMENSIONS];
+	for (int dim = 0; dim < ndims; dim++) {
+		hsize_t tile_start = tile_coords[dim] * box->tile_dims[dim];
+		low[dim] = PARH5X_MAX(tile_start, file_iter->start[dim]);
+		high[dim] = PARH5X_MIN(tile_start + box->tile_dims[dim], file_iter->start[dim] + file_iter->count[dim]);
+	}
+
+	struct parh5T_tile_uuid uuid = { .dset_id = parh5I_get_inode_num(parh5D_get_inode(box->dataset)),
+					 .tile_id = parh5D_get_tile_id(box->dataset, tile_coords) };
+	size_t row_elems = high[ndims - 1] - low[ndims - 1];
+	size_t row_size = row_elems * box->elem_size;
+	size_t group_rows = ndims > 1 ? high[ndims - 2] - low[ndims - 2] : 1;
+	size_t tile_stride = ndims > 1 ? box->tile_dims[ndims - 1] * box->elem_size : 0;
+	size_t mem_stride = ndims > 1 ? mem_iter->shape[ndims - 1] * mem->elem_size : 0;
+	bool write = PARH5X_WRITE_TO_CACHE == op || PARH5X_OVERWRITE_CACHE == op;
+	char *stage = NULL;
+	if (write && mem->conv)
+		stage = parh5X_get_stage(mem, parh5D_get_tile_size_in_elems(box->dataset) * box->elem_size);
+	size_t num_rows = 0;
+	if (write && NULL == box->rows)
+		box->rows = calloc(parh5D_get_tile_size_in_elems(box->dataset) / box->tile_dims[ndims - 1],
+				   sizeof(*box->rows));
+	hsize_t coords[PARH5D_MAX_DIMENSIONS];
+	for (int dim = 0; dim < ndims; dim++)
+		coords[dim] = low[dim];
+	for (;;) {
+		hsize_t offt_in_tile = 0;
+		hsize_t mem_elem_id = 0;
+		for (int dim = 0; dim < ndims; dim++) {
+			offt_in_tile = offt_in_tile * box->tile_dims[dim] + coords[dim] % box->tile_dims[dim];
+			mem_elem_id = mem_elem_id * mem_iter->shape[dim] + mem_iter->start[dim] + coords[dim] -
+				      file_iter->start[dim];
+		}
+		char *mem_addr = &mem->buf[mem_elem_id * mem->elem_size];
+		size_t offt = offt_in_tile * box->elem_size;
+		switch (op) {
+		case PARH5X_COPY_TO_MEM:
+			if (1 == row_elems && NULL == mem->conv) {
+				box->copy(mem_addr, mem_stride, &tile_buf[offt], tile_stride, group_rows, box->elem_size);
+				break;
+			}
+			for (size_t row = 0; row < group_rows; row++)
+				parh5X_copy_to_mem(mem, &tile_buf[offt + row * tile_stride], &mem_addr[row * mem_stride],
+						   row_elems);
+			break;
+		case PARH5X_ZERO_MEM:
+			for (size_t row = 0; row < group_rows; row++)
+				memset(&mem_addr[row * mem_stride], 0x00, row_elems * mem->elem_size);
+			break;
+		case PARH5X_WRITE_TO_CACHE:
+		case PARH5X_OVERWRITE_CACHE:
+			for (size_t row = 0; row < group_rows; row++) {
+				struct parh5T_segment *segment = &box->rows[num_rows++];
+				segment->offt_in_tile = offt + row * tile_stride;
+				segment->size = row_size;
+				segment->buffer = &mem_addr[row * mem_stride];
+				if (NULL == stage)
+					continue;
+				/*The converted row takes the place it has in the tile*/
+				parh5C_convert(mem->conv, segment->buffer, &stage[segment->offt_in_tile], row_elems);
+				segment->buffer = &stage[segment->offt_in_tile];
+			}
+			break;
+		}
+
+		int dim = ndims - 3;
+		for (; dim >= 0; dim--) {
+			if (++coords[dim] < high[dim])
+				break;
+			coords[dim] = low[dim];
+		}
+		if (dim < 0)
+			break;
+	}
+
+	if (write && !parh5T_write_segments_to_tile_cache(box->cache, box->dataset, uuid, box->rows, num_rows,
+							   PARH5X_OVERWRITE_CACHE == op)) {
+		log_fatal("Failed to write rows of tile: %lu", uuid.tile_id);
+		_exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @brief Returns the index of a tile among the tiles of the box or -1 if
+ * the tile is outside the box.
+ */
+static int64_t parh5X_box_tile_idx(struct parh5X_box *box, const hsize_t tile_coords[])
+{
+	int64_t idx = 0;
+	for (int dim = 0; dim < box->ndims; dim++) {
+		if (tile_coords[dim] < box->first_tile[dim] || tile_coords[dim] > box->last_tile[dim])
+			return -1;
+		idx = idx * (box->last_tile[dim] - box->first_tile[dim] + 1) + tile_coords[dim] - box->first_tile[dim];
+	}
+	return idx;
+}
+
+/**
+ * @brief Returns the coordinates of the tile_idx-th tile of the box in
+ * row-major order.
+ */
+static void parh5X_get_box_tile(struct parh5X_box *box, uint64_t tile_idx, hsize_t tile_coords[])
+{
+	for (int dim = box->ndims - 1; dim >= 0; dim--) {
+		uint64_t tiles = box->last_tile[dim] - box->first_tile[dim] + 1;
+		tile_coords[dim] = box->first_tile[dim] + tile_idx % tiles;
+		tile_idx /= tiles;
+	}
+}
+
+static struct parh5T_tile_uuid parh5X_get_box_tile_uuid(struct parh5X_box *box, const hsize_t tile_coords[])
+{
+	struct parh5T_tile_uuid uuid = { .dset_id = parh5I_get_inode_num(parh5D_get_inode(box->dataset)),
+					 .tile_id = parh5D_get_tile_id(box->dataset, tile_coords) };
+	return uuid;
+}
+
+/**
+ * @brief Runs task_fn for num_tasks tasks of the box, on the workers if the
+ * box has enough tiles. Each worker gets a copy of the box whose memory side
+ * has stage and row buffers of its own, the rest is shared.
+ */
+static void parh5X_run_box_tasks(struct parh5X_box *box, uint64_t num_tasks, parh5W_task_fn task_fn)
+{
+	parh5W_pool_t workers = parh5X_get_workers(box->workers, box->mem, box->num_tiles);
+	uint32_t num_workers = parh5W_get_num_workers(workers);
+	struct parh5X_box *boxes = calloc(num_workers, sizeof(*boxes));
+	struct parh5X_mem *mems = calloc(num_workers, sizeof(*mems));
+	for (uint32_t worker_id = 0; worker_id < num_workers; worker_id++) {
+		mems[worker_id] = *box->mem;
+		mems[worker_id].stage = NULL;
+		mems[worker_id].stage_size = 0;
+		boxes[worker_id] = *box;
+		boxes[worker_id].mem = &mems[worker_id];
+	}
+	parh5W_run(workers, num_tasks, task_fn, boxes);
+	for (uint32_t worker_id = 0; worker_id < num_workers; worker_id++) {
+		free(mems[worker_id].stage);
+		free(boxes[worker_id].rows);
+	}
+	free(mems);
+	free(boxes);
+}
+
+static void parh5X_read_tile_cb(uint64_t tile_id, const char *tile_buf, uint32_t size, void *cb_arg)
+{
+	(void)size;
+	struct parh5X_box *box = cb_arg;
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS];
+	parh5D_get_tile_coords(box->dataset, tile_id, tile_coords);
+	int64_t idx = parh5X_box_tile_idx(box, tile_coords);
+	if (idx < 0)
+		return;
+	if (box->tiles_found)
+		box->tiles_found[idx] = 1;
+	parh5X_tile_rows(box, tile_coords, PARH5X_COPY_TO_MEM, tile_buf);
+}
+
+/**
+ * @brief Scans one of the num_scans ranges the tile ids of the box are split
+ * in, each with a Parallax scanner of its own. parh5X_scan_read wrote the
+ * dirty tiles of the dataset back before the scans.
+ */
+static void parh5X_scan_task(uint64_t scan, uint32_t worker_id, void *arg)
+{
+	struct parh5X_box *box = &((struct parh5X_box *)arg)[worker_id];
+	uint64_t first_tile_id = parh5D_get_tile_id(box->dataset, box->first_tile);
+	uint64_t num_ids = parh5D_get_tile_id(box->dataset, box->last_tile) - first_tile_id + 1;
+	uint64_t scan_first_id = first_tile_id + num_ids * scan / box->num_scans;
+	uint64_t scan_last_id = first_tile_id + num_ids * (scan + 1) / box->num_scans - 1;
+	parh5T_scan_tiles_no_flush(box->cache, box->dataset, scan_first_id, scan_last_id, parh5X_read_tile_cb, box);
+}
+
+static void parh5X_zero_task(uint64_t tile_idx, uint32_t worker_id, void *arg)
+{
+	struct parh5X_box *box = &((struct parh5X_box *)arg)[worker_id];
+	if (box->tiles_found[tile_idx])
+		return;
+	/*Tiles never written, or holding only the fill value, are not stored and read as the fill value*/
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS];
+	parh5X_get_box_tile(box, tile_idx, tile_coords);
+	const char *fill_tile = parh5D_get_fill_tile(box->dataset);
+	if (fill_tile)
+		parh5X_tile_rows(box, tile_coords, PARH5X_COPY_TO_MEM, fill_tile);
+	else
+		parh5X_tile_rows(box, tile_coords, PARH5X_ZERO_MEM, NULL);
+}
+
+/**
+ * @brief Serves a box read with Parallax range scans, copying each tile to
+ * memory straight from the scanner. It applies when the box covers many
+ * tiles whose ids are mostly consecutive. Workers scan disjoint ranges of
+ * tile ids.
+ * @return true if the read was served false if the caller must use point
+ * lookups
+ */
+static bool parh5X_scan_read(struct parh5X_box *box)
+{
+	/*The corners hold the smallest and largest ids in both row-major and Z-order*/
+	uint64_t first_tile_id = parh5D_get_tile_id(box->dataset, box->first_tile);
+	uint64_t last_tile_id = parh5D_get_tile_id(box->dataset, box->last_tile);
+	if (box->num_tiles < PARH5X_SCAN_MIN_TILES ||
+	    box->num_tiles * PARH5X_SCAN_MIN_DENSITY < last_tile_id - first_tile_id + 1)
+		return false;
+
+	uint32_t num_workers = parh5W_get_num_workers(parh5X_get_workers(box->workers, box->mem, box->num_tiles));
+	box->num_scans = 1;
+	if (num_workers > 1)
+		box->num_scans = PARH5X_MIN(num_workers * PARH5X_SCANS_PER_WORKER, last_tile_id - first_tile_id + 1);
+	box->tiles_found = calloc(box->num_tiles, sizeof(*box->tiles_found));
+	/*One flush for all scans, each would walk the whole cache and drain the put stage*/
+	parh5T_flush_dataset_tiles(box->cache, parh5I_get_inode_num(parh5D_get_inode(box->dataset)));
+	parh5X_run_box_tasks(box, box->num_scans, parh5X_scan_task);
+	parh5X_run_box_tasks(box, box->num_tiles, parh5X_zero_task);
+	free(box->tiles_found);
+	box->tiles_found = NULL;
+	return true;
+}
+
+static void parh5X_box_read_task(uint64_t tile_idx, uint32_t worker_id, void *arg)
+{
+	struct parh5X_box *box = &((struct parh5X_box *)arg)[worker_id];
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS];
+	parh5X_get_box_tile(box, tile_idx, tile_coords);
+	parh5T_read_tile(box->cache, box->dataset, parh5X_get_box_tile_uuid(box, tile_coords), parh5X_read_tile_cb,
+			 box);
+}
+
+/**
+ * @brief Reads a box tile by tile with a lookup per tile instead of one per
+ * row of the tile.
+ */
+static void parh5X_box_read(struct parh5X_box *box)
+{
+	parh5X_run_box_tasks(box, box->num_tiles, parh5X_box_read_task);
+}
+
+static void parh5X_box_write_task(uint64_t tile_idx, uint32_t worker_id, void *arg)
+{
+	struct parh5X_box *box = &((struct parh5X_box *)arg)[worker_id];
+	const hsize_t *dims = parh5D_get_dims(box->dataset);
+	hsize_t tile_coords[PARH5D_MAX_DIMENSIONS];
+	parh5X_get_box_tile(box, tile_idx, tile_coords);
+	bool covered = true;
+	for (int dim = 0; covered && dim < box->ndims; dim++) {
+		hsize_t tile_start = tile_coords[dim] * box->tile_dims[dim];
+		hsize_t tile_end = PARH5X_MIN(tile_start + box->tile_dims[dim], dims[dim]);
+		covered = tile_start >= box->file_iter->start[dim] &&
+			  tile_end <= box->file_iter->start[dim] + box->file_iter->count[dim];
+	}
+	parh5X_tile_rows(box, tile_coords, covered ? PARH5X_OVERWRITE_CACHE : PARH5X_WRITE_TO_CACHE, NULL);
+}
+
+/**
+ * @brief Writes a box tile by tile. Tiles that the box covers completely,
+ * parts of edge tiles beyond the dataset extent aside, are built from the
+ * memory buffer without reading them from Parallax.
+ */
+static void parh5X_box_write(struct parh5X_box *box)
+{
+	parh5X_run_box_tasks(box, box->num_tiles, parh5X_box_write_task);
+}
+
+bool parh5X_is_sparse_read(parh5D_dataset_t dataset, hsize_t num_elems)
+{
+	return num_elems * PARH5X_SPARSE_MAX_DENSITY <= parh5D_get_tile_size_in_elems(dataset);
+}
+
+/**
+ * @brief Copies a segment, a piece of a run that lies in one tile, between
+ * the memory buffer and the tile cache.
+ */
+static void parh5X_copy_segment(parh5D_dataset_t dataset, parh5T_tile_cache_t cache, struct parh5X_mem *mem,
+				struct parh5T_tile tile, char *mem_addr, size_t num_elems, enum parh5X_direction direction,
+				bool sparse)
+{
+	uint32_t segment_size = num_elems * mem->file_elem_size;
+	char *buffer = mem->conv ? parh5X_get_stage(mem, segment_size) : mem_addr;
+	bool success = false;
+	if (PARH5X_WRITE == direction)
+		success = parh5T_write_to_tile_cache(cache, dataset, tile, parh5X_copy_from_mem(mem, mem_addr, num_elems),
+						     segment_size);
+	else if (sparse)
+		success = parh5T_read_sparse_from_tile_cache(cache, dataset, tile, buffer, segment_size);
+	else
+		success = parh5T_read_from_tile_cache(cache, dataset, tile, buffer, segment_size);
+	if (success && PARH5X_READ == direction && mem->conv)
+		parh5X_copy_to_mem(mem, buffer, mem_addr, num_elems);
+	if (!success) {
+		log_fatal("Failed to transfer segment of tile: %lu", tile.uuid.tile_id);
+		_exit(EXIT_FAILURE);
+	}
+}
+
+/*A run of consecutive elements of a selection, in the row-major order of its dataspace*/
+struct parh5X_run {
+	hsize_t elem_id;
+	hsize_t len;
+};
+
+static int parh5X_cmp_runs(const void *run_a, const void *run_b)
+{
+	const struct parh5X_run *a = run_a;
+	const struct parh5X_run *b = run_b;
+	return a->elem_id < b->elem_id ? -1 : a->elem_id > b->elem_id;
+}
+
+static hsize_t parh5X_coords2id(const hsize_t coords[], const hsize_t shape[], int ndims)
+{
+	hsize_t elem_id = 0;
+	for (int dim = 0; dim < ndims; dim++)
+		elem_id = elem_id * shape[dim] + coords[dim];
+	return elem_id;
+}
+
+/**
+ * @brief Merges each run with the next one when they are adjacent.
+ * @return the number of runs left
+ */
+static size_t parh5X_merge_runs(struct parh5X_run *runs, size_t num_runs)
+{
+	if (0 == num_runs)
+		return 0;
+	size_t last = 0;
+	for (size_t i = 1; i < num_runs; i++) {
+		if (runs[last].elem_id + runs[last].len == runs[i].elem_id)
+			runs[last].len += runs[i].len;
+		else
+			runs[++last] = runs[i];
+	}
+	return last + 1;
+}
+
+/**
+ * @brief Splits the blocks of a hyperslab selection, whatever its shape
+ * (strided, union of hyperslabs), into runs in row-major order.
+ */
+static struct parh5X_run *parh5X_get_hyperslab_runs(hid_t space_id, int ndims, const hsize_t shape[],
+						    size_t *num_runs)
+{
+	hssize_t num_blocks = H5Sget_select_hyper_nblocks(space_id);
+	if (num_blocks < 0) {
+		log_fatal("Failed to get the number of hyperslab blocks");
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t *blocks = calloc(num_blocks * 2UL * ndims + 1, sizeof(*blocks));
+	if (H5Sget_select_hyper_blocklist(space_id, 0, num_blocks, blocks) < 0) {
+		log_fatal("Failed to get the hyperslab blocks");
+		_exit(EXIT_FAILURE);
+	}
+
+	size_t max_runs = 0;
+	for (hssize_t block = 0; block < num_blocks; block++) {
+		const hsize_t *start = &blocks[block * 2 * ndims];
+		const hsize_t *end = &start[ndims];
+		size_t rows = 1;
+		for (int dim = 0; dim < ndims - 1; dim++)
+			rows *= end[dim] - start[dim] + 1;
+		max_runs += rows;
+	}
+
+	struct parh5X_run *runs = calloc(max_runs + 1, sizeof(*runs));
+	size_t idx = 0;
+	for (hssize_t block = 0; block < num_blocks; block++) {
+		const hsize_t *start = &blocks[block * 2 * ndims];
+		const hsize_t *end = &start[ndims];
+		hsize_t coords[PARH5D_MAX_DIMENSIONS];
+		for (int dim = 0; dim < ndims; dim++)
+			coords[dim] = start[dim];
+		for (;;) {
+			runs[idx].elem_id = parh5X_coords2id(coords, shape, ndims);
+			runs[idx++].len = end[ndims - 1] - start[ndims - 1] + 1;
+			int dim = ndims - 2;
+			for (; dim >= 0; dim--) {
+				if (++coords[dim] <= end[dim])
+					break;
+				coords[dim] = start[dim];
+			}
+			if (dim < 0)
+				break;
+		}
+	}
+	free(blocks);
+
+	/*HDF5 pairs the elements of hyperslab selections in row-major order, blocks may interleave*/
+	qsort(runs, idx, sizeof(*runs), parh5X_cmp_runs);
+	*num_runs = parh5X_merge_runs(runs, idx);
+	return runs;
+}
+
+/**
+ * @brief Decomposes any selection into runs, in the order HDF5 pairs the
+ * elements of the file and the memory selections: the order of the list
+ * for point selections, row-major for the rest.
+ * @param [in] space_id the selection
+ * @param [out] num_runs the number of runs
+ * @return array of runs the caller frees, NULL if the selection is not
+ * supported
+ */
+static struct parh5X_run *parh5X_get_runs(hid_t space_id, size_t *num_runs)
+{
+	*num_runs = 0;
+	int ndims = H5Sget_simple_extent_ndims(space_id);
+	if (ndims < 0 || ndims > PARH5D_MAX_DIMENSIONS) {
+		log_warn("Unsupported number of dimensions: %d", ndims);
+		return NULL;
+	}
+	hsize_t shape[PARH5D_MAX_DIMENSIONS] = { 1 };
+	if (0 == ndims)
+		ndims = 1; /*Scalar dataspace, a single element*/
+	else
+		H5Sget_simple_extent_dims(space_id, shape, NULL);
+
+	struct parh5X_run *runs = NULL;
+	switch (H5Sget_select_type(space_id)) {
+	case H5S_SEL_NONE:
+		return calloc(1UL, sizeof(*runs));
+	case H5S_SEL_ALL:
+		runs = calloc(1UL, sizeof(*runs));
+		runs->len = 1;
+		for (int dim = 0; dim < ndims; dim++)
+			runs->len *= shape[dim];
+		*num_runs = 1;
+		return runs;
+	case H5S_SEL_POINTS: {
+		hssize_t num_points = H5Sget_select_elem_npoints(space_id);
+		if (num_points < 0) {
+			log_fatal("Failed to get the number of points");
+			_exit(EXIT_FAILURE);
+		}
+		hsize_t *coords = calloc(num_points * (size_t)ndims + 1, sizeof(*coords));
+		if (H5Sget_select_elem_pointlist(space_id, 0, num_points, coords) < 0) {
+			log_fatal("Failed to get the point list");
+			_exit(EXIT_FAILURE);
+		}
+		runs = calloc(num_points + 1UL, sizeof(*runs));
+		for (hssize_t point = 0; point < num_points; point++) {
+			runs[point].elem_id = parh5X_coords2id(&coords[point * ndims], shape, ndims);
+			runs[point].len = 1;
+		}
+		free(coords);
+		*num_runs = parh5X_merge_runs(runs, num_points);
+		return runs;
+	}
+	case H5S_SEL_HYPERSLABS:
+		return parh5X_get_hyperslab_runs(space_id, ndims, shape, num_runs);
+	default:
+		log_warn("Unsupported selection type");
+		return NULL;
+	}
+}
+
+/*A piece of a run that lies in a single tile*/
+struct parh5X_segment {
+	struct parh5T_tile_uuid uuid;
+	uint64_t offt_in_tile; /*in bytes*/
+	hsize_t mem_elem_id;
+	uint32_t num_elems;
+};
+
+/*LSD radix sort digits: the 4 bytes of the offset in the tile, then the 8 bytes of the tile id*/
+#define PARH5X_RADIX_OFFT_DIGITS 4
+#define PARH5X_RADIX_DIGITS (PARH5X_RADIX_OFFT_DIGITS + 8)
+
+static inline uint8_t parh5X_segment_digit(const struct parh5X_segment *segment, int digit)
+{
+	if (digit < PARH5X_RADIX_OFFT_DIGITS)
+		return segment->offt_in_tile >> (8 * digit);
+	return segment->uuid.tile_id >> (8 * (digit - PARH5X_RADIX_OFFT_DIGITS));
+}
+
+/**
+ * @brief Sorts the segments by (tile id, offset in the tile) with an LSD
+ * radix sort. One pass builds the histograms of all digits, digits every
+ * segment shares are skipped. The sort is stable, segments that hit the
+ * same bytes keep their selection order.
+ * @param [in,out] segments the array to sort, it may be replaced by the
+ * scratch array
+ * @param [in] num_segments the number of segments
+ */
+static void parh5X_radix_sort_segments(struct parh5X_segment **segments, size_t num_segments)
+{
+	if (num_segments < 2)
+		return;
+	size_t(*histograms)[256] = calloc(PARH5X_RADIX_DIGITS, sizeof(*histograms));
+	for (size_t i = 0; i < num_segments; i++)
+		for (int digit = 0; digit < PARH5X_RADIX_DIGITS; digit++)
+			histograms[digit][parh5X_segment_digit(&(*segments)[i], digit)]++;
+
+	struct parh5X_segment *src = *segments;
+	struct parh5X_segment *dst = calloc(num_segments, sizeof(*dst));
+	for (int digit = 0; digit < PARH5X_RADIX_DIGITS; digit++) {
+		size_t *histogram = histograms[digit];
+		if (histogram[parh5X_segment_digit(&src[0], digit)] == num_segments)
+			continue;
+		size_t position = 0;
+		for (int value = 0; value < 256; value++) {
+			size_t count = histogram[value];
+			histogram[value] = position;
+			position += count;
+		}
+		for (size_t i = 0; i < num_segments; i++)
+			dst[histogram[parh5X_segment_digit(&src[i], digit)]++] = src[i];
+		struct parh5X_segment *tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+	free(dst);
+	free(histograms);
+	*segments = src;
+}
+
+/*Access plans cached per dataset*/
+#define PARH5X_NUM_PLANS 4
+/*Plans keep their segments up to this many, larger transfers amortize the planning anyway*/
+#define PARH5X_PLAN_MAX_SEGMENTS (1UL << 18)
+
+/*The shape of a selection that is its whole dataspace or a regular hyperslab*/
+struct parh5X_shape {
+	H5S_sel_type sel_type;
+	int ndims;
+	hsize_t dims[PARH5D_MAX_DIMENSIONS];
+	hsize_t start[PARH5D_MAX_DIMENSIONS];
+	hsize_t stride[PARH5D_MAX_DIMENSIONS];
+	hsize_t count[PARH5D_MAX_DIMENSIONS];
+	hsize_t block[PARH5D_MAX_DIMENSIONS];
+};
+
+/**
+ * A compiled transfer between two selections. File runs are relative to
+ * the start of the file selection, so a plan serves every file selection
+ * of its shape. Segments, the runs paired, mapped to tiles and sorted, are
+ * kept for the file offset they were mapped at and serve the calls that
+ * repeat it.
+ */
+struct parh5X_plan {
+	struct parh5X_shape file_shape; /*its start is not part of the key*/
+	struct parh5X_shape mem_shape;
+	struct parh5X_run *file_runs;
+	size_t num_file_runs;
+	struct parh5X_run *mem_runs;
+	size_t num_mem_runs;
+	struct parh5X_segment *segments;
+	size_t num_segments;
+	hsize_t num_elems;
+	hsize_t segments_offset; /*row-major id of the file selection start the segments were mapped at*/
+	bool segments_valid;
+	uint64_t last_use;
+};
+
+struct parh5X_plans {
+	struct parh5X_plan plans[PARH5X_NUM_PLANS];
+	uint64_t clock;
+};
+
+static void parh5X_free_plan(struct parh5X_plan *plan)
+{
+	free(plan->file_runs);
+	free(plan->mem_runs);
+	free(plan->segments);
+	memset(plan, 0x00, sizeof(*plan));
+}
+
+struct parh5X_plans *parh5X_create_plans(void)
+{
+	return calloc(1UL, sizeof(struct parh5X_plans));
+}
+
+void parh5X_destroy_plans(struct parh5X_plans *plans)
+{
+	if (NULL == plans)
+		return;
+	for (int i = 0; i < PARH5X_NUM_PLANS; i++)
+		parh5X_free_plan(&plans->plans[i]);
+	free(plans);
+}
+
+/**
+ * @brief Describes a selection by its shape.
+ * @return false if the selection is neither all of its dataspace nor a
+ * regular hyperslab, such selections are not planned
+ */
+static bool parh5X_get_shape(hid_t space_id, struct parh5X_shape *shape)
+{
+	memset(shape, 0x00, sizeof(*shape));
+	shape->ndims = H5Sget_simple_extent_ndims(space_id);
+	if (shape->ndims <= 0 || shape->ndims > PARH5D_MAX_DIMENSIONS)
+		return false;
+	H5Sget_simple_extent_dims(space_id, shape->dims, NULL);
+	shape->sel_type = H5Sget_select_type(space_id);
+	if (H5S_SEL_ALL == shape->sel_type)
+		return true;
+	if (H5S_SEL_HYPERSLABS != shape->sel_type || H5Sis_regular_hyperslab(space_id) <= 0)
+		return false;
+	if (H5Sget_regular_hyperslab(space_id, shape->start, shape->stride, shape->count, shape->block) < 0) {
+		log_fatal("Failed to get the regular hyperslab");
+		_exit(EXIT_FAILURE);
+	}
+	return true;
+}
+
+static bool parh5X_same_shape(const struct parh5X_shape *a, const struct parh5X_shape *b, bool same_start)
+{
+	size_t size = a->ndims * sizeof(hsize_t);
+	return a->sel_type == b->sel_type && a->ndims == b->ndims && 0 == memcmp(a->dims, b->dims, size) &&
+	       0 == memcmp(a->stride, b->stride, size) && 0 == memcmp(a->count, b->count, size) &&
+	       0 == memcmp(a->block, b->block, size) && (!same_start || 0 == memcmp(a->start, b->start, size));
+}
+
+/**
+ * @brief Returns the plan for a pair of selections, compiling it if the
+ * dataset has none for their shapes. The least recently used plan makes
+ * room for the new one.
+ * @param [in] plans the plans of the dataset
+ * @param [in] file_space_id the file selection
+ * @param [in] mem_space_id the memory selection
+ * @param [out] file_offset row-major id of the start of the file selection
+ * @return the plan, NULL if the selections are not planned
+ */
+static struct parh5X_plan *parh5X_get_plan(struct parh5X_plans *plans, hid_t file_space_id, hid_t mem_space_id,
+					   hsize_t *file_offset)
+{
+	struct parh5X_shape file_shape;
+	struct parh5X_shape mem_shape;
+	if (!parh5X_get_shape(file_space_id, &file_shape) || !parh5X_get_shape(mem_space_id, &mem_shape))
+		return NULL;
+	*file_offset = parh5X_coords2id(file_shape.start, file_shape.dims, file_shape.ndims);
+
+	struct parh5X_plan *victim = &plans->plans[0];
+	for (int i = 0; i < PARH5X_NUM_PLANS; i++) {
+		struct parh5X_plan *plan = &plans->plans[i];
+		if (plan->file_runs && parh5X_same_shape(&plan->file_shape, &file_shape, false) &&
+		    parh5X_same_shape(&plan->mem_shape, &mem_shape, true)) {
+			plan->last_use = ++plans->clock;
+			return plan;
+		}
+		if (plan->last_use < victim->last_use)
+			victim = plan;
+	}
+
+	parh5X_free_plan(victim);
+	victim->file_runs = parh5X_get_runs(file_space_id, &victim->num_file_runs);
+	victim->mem_runs = parh5X_get_runs(mem_space_id, &victim->num_mem_runs);
+	if (NULL == victim->file_runs || NULL == victim->mem_runs) {
+		parh5X_free_plan(victim);
+		return NULL;
+	}
+	for (size_t i = 0; i < victim->num_file_runs; i++)
+		victim->file_runs[i].elem_id -= *file_offset;
+	victim->file_shape = file_shape;
+	victim->mem_shape = mem_shape;
+	victim->last_use = ++plans->clock;
+	return victim;
+}
+
+/**
+ * @brief Pairs the runs of a plan with the file selection at file_offset,
+ * splits them at tile boundaries and sorts the segments by (tile id, offset
+ * in the tile).
+ */
+static void parh5X_map_segments(parh5D_dataset_t dataset, struct parh5X_plan *plan, hsize_t file_offset)
+{
+	size_t max_segments = plan->num_file_runs + plan->num_mem_runs;
+	free(plan->segments);
+	plan->segments = calloc(max_segments + 1, sizeof(*plan->segments));
+	plan->num_segments = 0;
+	plan->num_elems = 0;
+	size_t file_idx = 0;
+	size_t mem_idx = 0;
+	struct parh5X_run file_run = { 0 };
+	struct parh5X_run mem_run = { 0 };
+	for (;;) {
+		if (0 == file_run.len && file_idx < plan->num_file_runs) {
+			file_run = plan->file_runs[file_idx++];
+			file_run.elem_id += file_offset;
+		}
+		if (0 == mem_run.len && mem_idx < plan->num_mem_runs)
+			mem_run = plan->mem_runs[mem_idx++];
+		if (0 == file_run.len || 0 == mem_run.len)
+			break;
+
+		hsize_t tile_left = parh5D_get_tile_run_len(dataset, file_run.elem_id);
+		hsize_t segment_len = PARH5X_MIN(PARH5X_MIN(file_run.len, mem_run.len), tile_left);
+		if (plan->num_segments == max_segments) {
+			max_segments *= 2;
+			plan->segments = realloc(plan->segments, max_segments * sizeof(*plan->segments));
+		}
+		struct parh5T_tile tile = parh5D_map_id2tile(dataset, file_run.elem_id);
+		struct parh5X_segment *segment = &plan->segments[plan->num_segments++];
+		segment->uuid = tile.uuid;
+		segment->offt_in_tile = tile.offt_in_tile;
+		segment->mem_elem_id = mem_run.elem_id;
+		segment->num_elems = segment_len;
+		assert(segment_len * parh5D_get_elems_size_in_bytes(dataset) <= UINT32_MAX);
+		plan->num_elems += segment_len;
+
+		file_run.elem_id += segment_len;
+		file_run.len -= segment_len;
+		mem_run.elem_id += segment_len;
+		mem_run.len -= segment_len;
+	}
+	parh5X_radix_sort_segments(&plan->segments, plan->num_segments);
+	plan->segments_offset = file_offset;
+	plan->segments_valid = true;
+}
+
+/*The segments of a selection transfer grouped by tile, a group per task*/
+struct parh5X_selection_job {
+	parh5D_dataset_t dataset;
+	parh5T_tile_cache_t cache;
+	struct parh5X_mem *mem;
+	enum parh5X_direction direction;
+	bool sparse;
+	const struct parh5X_segment *segments;
+	struct parh5T_segment *pieces; /*one per segment, pointing to memory or to a slice of the stage buffer*/
+	size_t *group_starts; /*the first segment of each group and the number of segments at the end*/
+};
+
+static void parh5X_selection_task(uint64_t group, uint32_t worker_id, void *arg)
+{
+	(void)worker_id;
+	struct parh5X_selection_job *job = arg;
+	struct parh5X_mem *mem = job->mem;
+	size_t first = job->group_starts[group];
+	size_t num_pieces = job->group_starts[group + 1] - first;
+	const struct parh5X_segment *segments = &job->segments[first];
+	struct parh5T_segment *pieces = &job->pieces[first];
+	for (size_t i = 0; mem->conv && PARH5X_WRITE == job->direction && i < num_pieces; i++)
+		parh5C_convert(mem->conv, &mem->buf[segments[i].mem_elem_id * mem->elem_size], pieces[i].buffer,
+			       segments[i].num_elems);
+
+	struct parh5T_tile_uuid uuid = segments[0].uuid;
+	bool success = false;
+	if (PARH5X_WRITE == job->direction)
+		success = parh5T_write_segments_to_tile_cache(job->cache, job->dataset, uuid, pieces, num_pieces,
+							      false);
+	else
+		success = parh5T_read_segments_from_tile_cache(job->cache, job->dataset, uuid, pieces, num_pieces,
+							       job->sparse);
+	if (!success) {
+		log_fatal("Failed to transfer segments of tile: %lu", uuid.tile_id);
+		_exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; mem->conv && PARH5X_READ == job->direction && i < num_pieces; i++)
+		parh5C_convert(mem->conv, pieces[i].buffer, &mem->buf[segments[i].mem_elem_id * mem->elem_size],
+			       segments[i].num_elems);
+}
+
+/**
+ * A transfer ready to run. Preparing it asks HDF5 everything the transfer
+ * needs to know about the selections, running it does not call into the
+ * library, so it may run on a thread of the connector.
+ */
+struct parh5X_op {
+	parh5D_dataset_t dataset;
+	parh5T_tile_cache_t cache;
+	parh5W_pool_t workers;
+	enum parh5X_direction direction;
+	struct parh5X_mem mem;
+	bool single_block; /*both selections are single blocks, walked by file_iter and mem_iter*/
+	struct parh5X_run_iter file_iter;
+	struct parh5X_run_iter mem_iter;
+	struct parh5X_plan *plan; /*selections of other shapes, one of the dataset plans or own_plan*/
+	struct parh5X_plan own_plan;
+	hsize_t file_offset;
+};
+
+/**
+ * @brief Finds the plan of a transfer between selections of any shape.
+ * Regular hyperslabs go through the access plans of the dataset, unless the
+ * transfer is detached: detached transfers may run while other calls use the
+ * dataset plans, so they compile a plan of their own.
+ * @return false if a selection has more than PARH5D_MAX_DIMENSIONS
+ * dimensions
+ */
+static bool parh5X_plan_selection(struct parh5X_op *op, hid_t file_space_id, hid_t mem_space_id, bool detached)
+{
+	if (!detached)
+		op->plan = parh5X_get_plan(parh5D_get_access_plans(op->dataset), file_space_id, mem_space_id,
+					   &op->file_offset);
+	if (op->plan)
+		return true;
+	op->plan = &op->own_plan;
+	op->file_offset = 0;
+	op->plan->file_runs = parh5X_get_runs(file_space_id, &op->plan->num_file_runs);
+	op->plan->mem_runs = parh5X_get_runs(mem_space_id, &op->plan->num_mem_runs);
+	return op->plan->file_runs && op->plan->mem_runs;
+}
+
+/**
+ * @brief Transfers selections of any shape. It pairs the runs of the two
+ * selections, splits them at tile boundaries and sorts the segments by
+ * (tile id, offset in the tile), so that all the blocks or points of a tile
+ * are copied in one tile cache operation. Each segment keeps its position
+ * in the memory buffer, and segments hitting the same element keep their
+ * selection order, a point selected twice by a write gets the last value.
+ * Selections that are regular hyperslabs go through the access plans of
+ * the dataset, repeated shapes skip the decomposition and repeated offsets
+ * skip the tile mapping as well. The tiles are spread over the workers.
+ */
+static void parh5X_transfer_selection(struct parh5X_op *op)
+{
+	struct parh5X_plan *plan = op->plan;
+	struct parh5X_mem *mem = &op->mem;
+	if (!plan->segments_valid || plan->segments_offset != op->file_offset)
+		parh5X_map_segments(op->dataset, plan, op->file_offset);
+
+	struct parh5X_selection_job job = { .dataset = op->dataset,
+					    .cache = op->cache,
+					    .mem = mem,
+					    .direction = op->direction,
+					    .segments = plan->segments };
+	size_t elem_size = mem->file_elem_size;
+	size_t num_segments = plan->num_segments;
+	/*Segments in the dataset type get consecutive slices of the stage buffer*/
+	char *stage = mem->conv ? parh5X_get_stage(mem, plan->num_elems * elem_size) : NULL;
+	job.sparse = PARH5X_READ == op->direction && parh5X_is_sparse_read(op->dataset, plan->num_elems);
+	job.pieces = calloc(num_segments + 1, sizeof(*job.pieces));
+	job.group_starts = calloc(num_segments + 1, sizeof(*job.group_starts));
+	uint64_t num_groups = 0;
+	for (size_t i = 0; i < num_segments; i++) {
+		if (0 == i || plan->segments[i].uuid.tile_id != plan->segments[i - 1].uuid.tile_id)
+			job.group_starts[num_groups++] = i;
+		struct parh5T_segment *piece = &job.pieces[i];
+		piece->offt_in_tile = plan->segments[i].offt_in_tile;
+		piece->size = plan->segments[i].num_elems * elem_size;
+		piece->buffer = &mem->buf[plan->segments[i].mem_elem_id * mem->elem_size];
+		if (NULL == stage)
+			continue;
+		piece->buffer = stage;
+		stage += piece->size;
+	}
+	job.group_starts[num_groups] = num_segments;
+	parh5W_run(parh5X_get_workers(op->workers, mem, num_groups), num_groups, parh5X_selection_task, &job);
+	free(job.group_starts);
+	free(job.pieces);
+
+	if (plan != &op->own_plan && num_segments > PARH5X_PLAN_MAX_SEGMENTS) {
+		free(plan->segments);
+		plan->segments = NULL;
+		plan->segments_valid = false;
+	}
+}
+
+/**
+ * @brief Transfers two single block selections, a box at a time if they
+ * have the same shape, run by run otherwise. Sparse box reads also go run by
+ * run, to keep the tiles they touch out of the cache.
+ */
+static void parh5X_transfer_runs(struct parh5X_op *op)
+{
+	parh5D_dataset_t dataset = op->dataset;
+	struct parh5X_run_iter *file_iter = &op->file_iter;
+	struct parh5X_run_iter *mem_iter = &op->mem_iter;
+	struct parh5X_mem *mem = &op->mem;
+	enum parh5X_direction direction = op->direction;
+	assert(mem->file_elem_size && parh5D_get_tile_size_in_elems(dataset));
+	hsize_t num_elems = 1;
+	for (int dim = 0; dim < file_iter->ndims; dim++)
+		num_elems *= file_iter->count[dim];
+	bool sparse = PARH5X_READ == direction && parh5X_is_sparse_read(dataset, num_elems);
+
+	struct parh5X_box box = { 0 };
+	if (parh5X_init_box(&box, dataset, op->cache, op->workers, file_iter, mem_iter, mem)) {
+		if (PARH5X_WRITE == direction) {
+			parh5X_box_write(&box);
+			return;
+		}
+		if (parh5X_scan_read(&box))
+			return;
+		if (!sparse) {
+			parh5X_box_read(&box);
+			return;
+		}
+	}
+
+	hsize_t file_elem_id = 0;
+	hsize_t file_left = 0;
+	hsize_t mem_elem_id = 0;
+	hsize_t mem_left = 0;
+	for (;;) {
+		if (0 == file_left && !parh5X_next_run(file_iter, &file_elem_id, &file_left))
+			break;
+		if (0 == mem_left && !parh5X_next_run(mem_iter, &mem_elem_id, &mem_left))
+			break;
+
+		struct parh5T_tile tile = parh5D_map_id2tile(dataset, file_elem_id);
+		hsize_t tile_left = parh5D_get_tile_run_len(dataset, file_elem_id);
+		hsize_t segment_len = PARH5X_MIN(PARH5X_MIN(file_left, mem_left), tile_left);
+		parh5X_copy_segment(dataset, op->cache, mem, tile, &mem->buf[mem_elem_id * mem->elem_size],
+				    segment_len, direction, sparse);
+
+		file_elem_id += segment_len;
+		file_left -= segment_len;
+		mem_elem_id += segment_len;
+		mem_left -= segment_len;
+	}
+}
+
+parh5X_op_t parh5X_prepare(parh5D_dataset_t dataset, parh5T_tile_cache_t cache, parh5W_pool_t workers,
+			   hid_t file_space_id, hid_t mem_space_id, parh5C_converter_t conv, char *mem_buf,
+			   enum parh5X_direction direction, bool detached)
+{
+	parh5X_op_t op = calloc(1UL, sizeof(*op));
+	op->dataset = dataset;
+	op->cache = cache;
+	op->workers = workers;
+	op->direction = direction;
+	op->mem.buf = mem_buf;
+	op->mem.file_elem_size = parh5D_get_elems_size_in_bytes(dataset);
+	op->mem.conv = conv;
+	op->mem.elem_size = op->mem.file_elem_size;
+	if (conv)
+		op->mem.elem_size = PARH5X_READ == direction ? parh5C_get_dst_size(conv) : parh5C_get_src_size(conv);
+
+	op->single_block = parh5X_init_run_iter(&op->file_iter, file_space_id) &&
+			   parh5X_init_run_iter(&op->mem_iter, mem_space_id);
+	if (op->single_block || parh5X_plan_selection(op, file_space_id, mem_space_id, detached))
+		return op;
+	parh5X_destroy_op(op);
+	return NULL;
+}
+
+void parh5X_run_op(parh5X_op_t op)
+{
+	if (op->single_block)
+		parh5X_transfer_runs(op);
+	else
+		parh5X_transfer_selection(op);
+}
+
+void parh5X_destroy_op(parh5X_op_t op)
+{
+	if (NULL == op)
+		return;
+	parh5X_free_plan(&op->own_plan);
+	free(op->mem.stage);
+	free(op);
+}
+
+bool parh5X_transfer(parh5D_dataset_t dataset, parh5T_tile_cache_t cache, parh5W_pool_t workers, hid_t file_space_id,
+		     hid_t mem_space_id, parh5C_converter_t conv, char *mem_buf, enum parh5X_direction direction)
+{
+	parh5X_op_t op =
+		parh5X_prepare(dataset, cache, workers, file_space_id, mem_space_id, conv, mem_buf, direction, false);
+	if (NULL == op)
+		return false;
+	parh5X_run_op(op);
+	parh5X_destroy_op(op);
+	return true;
+}
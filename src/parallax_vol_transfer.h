@@ -0,0 +1,84 @@
+#ifndef PARALLAX_VOL_TRANSFER_H
+#define PARALLAX_VOL_TRANSFER_H
+#include "parallax_vol_convert.h"
+#include "parallax_vol_tile_cache.h"
+#include "parallax_vol_workers.h"
+#include <H5Ipublic.h>
+#include <stdbool.h>
+typedef struct parh5D_dataset *parh5D_dataset_t;
+typedef struct parh5X_op *parh5X_op_t;
+
+enum parh5X_direction { PARH5X_READ = 1, PARH5X_WRITE };
+
+/**
+ * @brief Creates an empty set of access plans. A dataset keeps one, its
+ * transfers compile the runs of each regular hyperslab shape once and
+ * reuse them for every selection of that shape.
+ */
+struct parh5X_plans *parh5X_create_plans(void);
+
+/**
+ * @brief Frees the access plans, plans may be NULL.
+ */
+void parh5X_destroy_plans(struct parh5X_plans *plans);
+
+/**
+ * @brief A read is sparse if it selects only a small part of a tile. Sparse
+ * reads do not load into the tile cache the tiles they touch for the first
+ * time (see parh5T_read_sparse_from_tile_cache).
+ * @param [in] dataset the dataset to read from
+ * @param [in] num_elems the number of elements the read selects
+ */
+bool parh5X_is_sparse_read(parh5D_dataset_t dataset, hsize_t num_elems);
+
+/**
+ * @brief Moves the selected elements between the memory buffer and the
+ * tiles of the dataset. It splits both selections into maximal contiguous
+ * runs, intersects them with the tile boundaries and copies each resulting
+ * segment with a single tile cache operation. Selections of any shape are
+ * supported: point lists and hyperslab unions are decomposed from their
+ * point and block lists and their segments grouped by tile. Transfers that
+ * touch many tiles spread them over the workers, each tile is fetched,
+ * copied and written by a single worker.
+ * @param [in] dataset the dataset to read from or write to
+ * @param [in] cache the tile cache serving the transfer
+ * @param [in] workers the worker pool of the file, NULL to transfer on the
+ * calling thread
+ * @param [in] file_space_id the file selection (not H5S_ALL)
+ * @param [in] mem_space_id the memory selection (not H5S_ALL)
+ * @param [in] conv converts the elements between the dataset and the memory
+ * type in the direction of the transfer, NULL if the types are the same
+ * @param [in,out] mem_buf the application buffer
+ * @param [in] direction PARH5X_READ or PARH5X_WRITE
+ * @return true if the transfer was performed, false if a selection has more
+ * than PARH5D_MAX_DIMENSIONS dimensions.
+ */
+bool parh5X_transfer(parh5D_dataset_t dataset, parh5T_tile_cache_t cache, parh5W_pool_t workers, hid_t file_space_id,
+		     hid_t mem_space_id, parh5C_converter_t conv, char *mem_buf, enum parh5X_direction direction);
+
+/**
+ * @brief The first half of parh5X_transfer: it decomposes the selections
+ * and returns a transfer that parh5X_run_op performs later, possibly on
+ * another thread. All the HDF5 calls of a transfer happen here, the
+ * selections may be closed as soon as it returns.
+ * @param [in] detached true if the transfer may run while other transfers
+ * of the dataset run, it does not share the access plans of the dataset
+ * @return the transfer, NULL if a selection has more than
+ * PARH5D_MAX_DIMENSIONS dimensions. See parh5X_transfer for the rest.
+ */
+parh5X_op_t parh5X_prepare(parh5D_dataset_t dataset, parh5T_tile_cache_t cache, parh5W_pool_t workers,
+			   hid_t file_space_id, hid_t mem_space_id, parh5C_converter_t conv, char *mem_buf,
+			   enum parh5X_direction direction, bool detached);
+
+/**
+ * @brief Performs a prepared transfer. It does not call into HDF5, the
+ * converter of the transfer has to be thread-safe if it runs on a thread
+ * other than the application thread.
+ */
+void parh5X_run_op(parh5X_op_t op);
+
+/**
+ * @brief Frees a prepared transfer, op may be NULL.
+ */
+void parh5X_destroy_op(parh5X_op_t op);
+#endif
@@ -0,0 +1,137 @@
+#include "parallax_vol_workers.h"
+#include <log.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+/*More threads than this per file are a configuration error*/
+#define PARH5W_MAX_WORKERS 1024U
+
+struct parh5W_worker {
+	struct parh5W_pool *pool;
+	uint32_t worker_id;
+	pthread_t thread;
+};
+
+struct parh5W_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t job_posted; /*a new job or the shutdown*/
+	pthread_cond_t job_done; /*the last thread left the current job*/
+	struct parh5W_worker *workers; /*the threads, worker 0 is the caller and has no entry*/
+	uint32_t num_workers;
+	/*The current job, written under the lock before job_id moves on*/
+	parh5W_task_fn task_fn;
+	void *arg;
+	uint64_t num_tasks;
+	uint64_t next_task; /*claimed with atomic increments*/
+	uint64_t job_id;
+	uint32_t busy; /*threads still working on the current job*/
+	bool shutdown;
+};
+
+static void parh5W_work(struct parh5W_pool *pool, uint32_t worker_id)
+{
+	for (;;) {
+		uint64_t task_id = __sync_fetch_and_add(&pool->next_task, 1);
+		if (task_id >= pool->num_tasks)
+			return;
+		pool->task_fn(task_id, worker_id, pool->arg);
+	}
+}
+
+static void *parh5W_worker_main(void *thread_arg)
+{
+	struct parh5W_worker *worker = thread_arg;
+	struct parh5W_pool *pool = worker->pool;
+	uint64_t last_job_id = 0;
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->shutdown && pool->job_id == last_job_id)
+			pthread_cond_wait(&pool->job_posted, &pool->lock);
+		if (pool->shutdown)
+			break;
+		last_job_id = pool->job_id;
+		pthread_mutex_unlock(&pool->lock);
+		parh5W_work(pool, worker->worker_id);
+		pthread_mutex_lock(&pool->lock);
+		if (0 == --pool->busy)
+			pthread_cond_signal(&pool->job_done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+parh5W_pool_t parh5W_create_pool(uint32_t num_workers)
+{
+	if (0 == num_workers)
+		num_workers = 1;
+	if (num_workers > PARH5W_MAX_WORKERS) {
+		log_warn("Capping %u transfer threads to %u", num_workers, PARH5W_MAX_WORKERS);
+		num_workers = PARH5W_MAX_WORKERS;
+	}
+	parh5W_pool_t pool = calloc(1UL, sizeof(*pool));
+	pool->num_workers = num_workers;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->job_posted, NULL);
+	pthread_cond_init(&pool->job_done, NULL);
+	pool->workers = calloc(num_workers, sizeof(*pool->workers));
+	for (uint32_t worker_id = 1; worker_id < num_workers; worker_id++) {
+		struct parh5W_worker *worker = &pool->workers[worker_id];
+		worker->pool = pool;
+		worker->worker_id = worker_id;
+		if (pthread_create(&worker->thread, NULL, parh5W_worker_main, worker)) {
+			log_fatal("Failed to start transfer thread %u", worker_id);
+			_exit(EXIT_FAILURE);
+		}
+	}
+	log_debug("Started %u transfer threads", num_workers - 1);
+	return pool;
+}
+
+uint32_t parh5W_get_num_workers(parh5W_pool_t pool)
+{
+	return pool ? pool->num_workers : 1;
+}
+
+void parh5W_run(parh5W_pool_t pool, uint64_t num_tasks, parh5W_task_fn task_fn, void *arg)
+{
+	if (NULL == pool || pool->num_workers < 2 || num_tasks < 2) {
+		for (uint64_t task_id = 0; task_id < num_tasks; task_id++)
+			task_fn(task_id, 0, arg);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->task_fn = task_fn;
+	pool->arg = arg;
+	pool->num_tasks = num_tasks;
+	pool->next_task = 0;
+	pool->busy = pool->num_workers - 1;
+	pool->job_id++;
+	pthread_cond_broadcast(&pool->job_posted);
+	pthread_mutex_unlock(&pool->lock);
+
+	parh5W_work(pool, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy)
+		pthread_cond_wait(&pool->job_done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void parh5W_destroy_pool(parh5W_pool_t pool)
+{
+	if (NULL == pool)
+		return;
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = true;
+	pthread_cond_broadcast(&pool->job_posted);
+	pthread_mutex_unlock(&pool->lock);
+	for (uint32_t worker_id = 1; worker_id < pool->num_workers; worker_id++)
+		pthread_join(pool->workers[worker_id].thread, NULL);
+	pthread_cond_destroy(&pool->job_done);
+	pthread_cond_destroy(&pool->job_posted);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->workers);
+	free(pool);
+}
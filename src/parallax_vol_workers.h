@@ -0,0 +1,40 @@
+#ifndef PARALLAX_VOL_WORKERS_H
+#define PARALLAX_VOL_WORKERS_H
+#include <stdint.h>
+typedef struct parh5W_pool *parh5W_pool_t;
+
+/*Runs one task, worker_id is in [0, number of workers) and the calling thread is worker 0*/
+typedef void (*parh5W_task_fn)(uint64_t task_id, uint32_t worker_id, void *arg);
+
+/**
+ * @brief Creates a pool of workers that transfers fan their tiles out to.
+ * The thread that runs a job works on it too, so the pool starts
+ * num_workers - 1 threads.
+ * @param [in] num_workers the number of workers, 0 and 1 mean the jobs run
+ * on the calling thread alone
+ * @return pointer to the pool object
+ */
+parh5W_pool_t parh5W_create_pool(uint32_t num_workers);
+
+/**
+ * @brief Returns the number of workers of the pool, 1 if pool is NULL.
+ */
+uint32_t parh5W_get_num_workers(parh5W_pool_t pool);
+
+/**
+ * @brief Runs task_fn for every task id in [0, num_tasks) and returns when
+ * all of them are done. Workers claim the next unclaimed task as soon as they
+ * finish one, so tasks of uneven cost balance out. A NULL pool runs the tasks
+ * in order on the calling thread.
+ * @param [in] pool the pool to run the job on, may be NULL
+ * @param [in] num_tasks the number of tasks
+ * @param [in] task_fn called once per task
+ * @param [in] arg passed to task_fn
+ */
+void parh5W_run(parh5W_pool_t pool, uint64_t num_tasks, parh5W_task_fn task_fn, void *arg);
+
+/**
+ * @brief Stops the threads of the pool and frees it, pool may be NULL.
+ */
+void parh5W_destroy_pool(parh5W_pool_t pool);
+#endif
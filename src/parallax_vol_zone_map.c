@@ -0,0 +1,322 @@
+#include "parallax_vol_zone_map.h"
+#include <hdf5.h>
+#include <math.h>
+#include <string.h>
+/*The AVX2 kernels are compiled for their target only and picked at runtime, the library runs on any x86-64*/
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PARH5S_AVX2
+#include <immintrin.h>
+#endif
+
+typedef void (*parh5S_summarize_fn)(const char *tile_buf, uint32_t num_elems, struct parh5S_zone *zone);
+typedef void (*parh5S_histogram_fn)(const char *tile_buf, uint32_t num_elems, double lower, double upper,
+				    double scale, size_t num_bins, uint64_t bins[]);
+
+/*Integers of smaller magnitude are doubles exactly*/
+#define PARH5S_EXACT_INT_LIMIT 0x1p53
+
+/**
+ * Zone bounds are kept as doubles. 64-bit integers beyond 2^53 round on the
+ * way, so their bounds step outwards to stay around the elements.
+ */
+#define PARH5S_DEFINE_SUMMARIZE(TYPE, SUFFIX, WIDEN)                                                              \
+	static void parh5S_summarize_##SUFFIX(const char *tile_buf, uint32_t num_elems, struct parh5S_zone *zone) \
+	{                                                                                                         \
+		TYPE min = 0;                                                                                     \
+		TYPE max = 0;                                                                                     \
+		double sum = 0;                                                                                   \
+		uint64_t count = 0;                                                                               \
+		for (uint32_t i = 0; i < num_elems; i++) {                                                        \
+			TYPE value;                                                                               \
+			memcpy(&value, &tile_buf[i * sizeof(TYPE)], sizeof(TYPE));                                \
+			if (isnan((double)value))                                                                 \
+				continue;                                                                         \
+			sum += (double)value;                                                                     \
+			if (0 == count++ || value < min)                                                          \
+				min = value;                                                                      \
+			if (1 == count || value > max)                                                            \
+				max = value;                                                                      \
+		}                                                                                                 \
+		zone->count = count;                                                                              \
+		zone->null_count = num_elems - count;                                                             \
+		zone->inexact = 0;                                                                                \
+		zone->sum = sum;                                                                                  \
+		zone->min = count ? (double)min : INFINITY;                                                       \
+		zone->max = count ? (double)max : -INFINITY;                                                      \
+		if (WIDEN && count && fabs(zone->min) >= PARH5S_EXACT_INT_LIMIT)                                  \
+			zone->min = nextafter(zone->min, -INFINITY);                                              \
+		if (WIDEN && count && fabs(zone->max) >= PARH5S_EXACT_INT_LIMIT)                                  \
+			zone->max = nextafter(zone->max, INFINITY);                                               \
+	}
+
+/*Elements are binned as doubles, the last bin includes upper*/
+#define PARH5S_DEFINE_HISTOGRAM(TYPE, SUFFIX)                                                               \
+	static void parh5S_histogram_##SUFFIX(const char *tile_buf, uint32_t num_elems, double lower,       \
+					      double upper, double scale, size_t num_bins, uint64_t bins[]) \
+	{                                                                                                   \
+		for (uint32_t i = 0; i < num_elems; i++) {                                                  \
+			TYPE value;                                                                         \
+			memcpy(&value, &tile_buf[i * sizeof(TYPE)], sizeof(TYPE));                          \
+			double elem = (double)value;                                                        \
+			if (!(elem >= lower && elem <= upper))                                              \
+				continue;                                                                   \
+			size_t bin = (elem - lower) * scale;                                                \
+			bins[bin < num_bins ? bin : num_bins - 1]++;                                        \
+		}                                                                                           \
+	}
+
+PARH5S_DEFINE_SUMMARIZE(int8_t, int8, false)
+PARH5S_DEFINE_SUMMARIZE(uint8_t, uint8, false)
+PARH5S_DEFINE_SUMMARIZE(int16_t, int16, false)
+PARH5S_DEFINE_SUMMARIZE(uint16_t, uint16, false)
+PARH5S_DEFINE_SUMMARIZE(int32_t, int32, false)
+PARH5S_DEFINE_SUMMARIZE(uint32_t, uint32, false)
+PARH5S_DEFINE_SUMMARIZE(int64_t, int64, true)
+PARH5S_DEFINE_SUMMARIZE(uint64_t, uint64, true)
+PARH5S_DEFINE_SUMMARIZE(float, float, false)
+PARH5S_DEFINE_SUMMARIZE(double, double, false)
+
+#ifdef PARH5S_AVX2
+/**
+ * @brief Summarizes doubles 4 at a time. min and max return their second
+ * operand when either is NaN, so NaN elements leave the bounds alone, and
+ * they are masked out of the sum.
+ */
+__attribute__((target("avx2"))) static void parh5S_summarize_double_avx2(const char *tile_buf, uint32_t num_elems,
+									  struct parh5S_zone *zone)
+{
+	__m256d min = _mm256_set1_pd(INFINITY);
+	__m256d max = _mm256_set1_pd(-INFINITY);
+	__m256d sum = _mm256_setzero_pd();
+	uint64_t count = 0;
+	uint32_t i = 0;
+	for (; i + 4 <= num_elems; i += 4) {
+		__m256d elems = _mm256_loadu_pd((const double *)&tile_buf[i * sizeof(double)]);
+		__m256d ordered = _mm256_cmp_pd(elems, elems, _CMP_ORD_Q);
+		min = _mm256_min_pd(elems, min);
+		max = _mm256_max_pd(elems, max);
+		sum = _mm256_add_pd(sum, _mm256_and_pd(elems, ordered));
+		count += __builtin_popcount(_mm256_movemask_pd(ordered));
+	}
+	double lanes_min[4];
+	double lanes_max[4];
+	double lanes_sum[4];
+	_mm256_storeu_pd(lanes_min, min);
+	_mm256_storeu_pd(lanes_max, max);
+	_mm256_storeu_pd(lanes_sum, sum);
+	zone->min = fmin(fmin(lanes_min[0], lanes_min[1]), fmin(lanes_min[2], lanes_min[3]));
+	zone->max = fmax(fmax(lanes_max[0], lanes_max[1]), fmax(lanes_max[2], lanes_max[3]));
+	zone->sum = (lanes_sum[0] + lanes_sum[1]) + (lanes_sum[2] + lanes_sum[3]);
+	for (; i < num_elems; i++) {
+		double value;
+		memcpy(&value, &tile_buf[i * sizeof(double)], sizeof(double));
+		if (isnan(value))
+			continue;
+		zone->min = fmin(zone->min, value);
+		zone->max = fmax(zone->max, value);
+		zone->sum += value;
+		count++;
+	}
+	zone->count = count;
+	zone->null_count = num_elems - count;
+	zone->inexact = 0;
+}
+
+/**
+ * @brief parh5S_summarize_double_avx2 for floats, 8 at a time. The sum is
+ * kept in doubles like the one of the scalar loop.
+ */
+__attribute__((target("avx2"))) static void parh5S_summarize_float_avx2(const char *tile_buf, uint32_t num_elems,
+									 struct parh5S_zone *zone)
+{
+	__m256 min = _mm256_set1_ps(INFINITY);
+	__m256 max = _mm256_set1_ps(-INFINITY);
+	__m256d sum = _mm256_setzero_pd();
+	uint64_t count = 0;
+	uint32_t i = 0;
+	for (; i + 8 <= num_elems; i += 8) {
+		__m256 elems = _mm256_loadu_ps((const float *)&tile_buf[i * sizeof(float)]);
+		__m256 ordered = _mm256_cmp_ps(elems, elems, _CMP_ORD_Q);
+		__m256 masked = _mm256_and_ps(elems, ordered);
+		min = _mm256_min_ps(elems, min);
+		max = _mm256_max_ps(elems, max);
+		sum = _mm256_add_pd(sum, _mm256_cvtps_pd(_mm256_castps256_ps128(masked)));
+		sum = _mm256_add_pd(sum, _mm256_cvtps_pd(_mm256_extractf128_ps(masked, 1)));
+		count += __builtin_popcount(_mm256_movemask_ps(ordered));
+	}
+	float lanes_min[8];
+	float lanes_max[8];
+	double lanes_sum[4];
+	_mm256_storeu_ps(lanes_min, min);
+	_mm256_storeu_ps(lanes_max, max);
+	_mm256_storeu_pd(lanes_sum, sum);
+	zone->min = INFINITY;
+	zone->max = -INFINITY;
+	for (int lane = 0; lane < 8; lane++) {
+		zone->min = fmin(zone->min, lanes_min[lane]);
+		zone->max = fmax(zone->max, lanes_max[lane]);
+	}
+	zone->sum = (lanes_sum[0] + lanes_sum[1]) + (lanes_sum[2] + lanes_sum[3]);
+	for (; i < num_elems; i++) {
+		float value;
+		memcpy(&value, &tile_buf[i * sizeof(float)], sizeof(float));
+		if (isnan(value))
+			continue;
+		zone->min = fmin(zone->min, value);
+		zone->max = fmax(zone->max, value);
+		zone->sum += value;
+		count++;
+	}
+	zone->count = count;
+	zone->null_count = num_elems - count;
+	zone->inexact = 0;
+}
+
+static bool parh5S_has_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+PARH5S_DEFINE_HISTOGRAM(int8_t, int8)
+PARH5S_DEFINE_HISTOGRAM(uint8_t, uint8)
+PARH5S_DEFINE_HISTOGRAM(int16_t, int16)
+PARH5S_DEFINE_HISTOGRAM(uint16_t, uint16)
+PARH5S_DEFINE_HISTOGRAM(int32_t, int32)
+PARH5S_DEFINE_HISTOGRAM(uint32_t, uint32)
+PARH5S_DEFINE_HISTOGRAM(int64_t, int64)
+PARH5S_DEFINE_HISTOGRAM(uint64_t, uint64)
+PARH5S_DEFINE_HISTOGRAM(float, float)
+PARH5S_DEFINE_HISTOGRAM(double, double)
+
+static const parh5S_summarize_fn parh5S_summarize_fns[] = {
+	[PARH5S_INT8] = parh5S_summarize_int8,	   [PARH5S_UINT8] = parh5S_summarize_uint8,
+	[PARH5S_INT16] = parh5S_summarize_int16,   [PARH5S_UINT16] = parh5S_summarize_uint16,
+	[PARH5S_INT32] = parh5S_summarize_int32,   [PARH5S_UINT32] = parh5S_summarize_uint32,
+	[PARH5S_INT64] = parh5S_summarize_int64,   [PARH5S_UINT64] = parh5S_summarize_uint64,
+	[PARH5S_FLOAT] = parh5S_summarize_float,   [PARH5S_DOUBLE] = parh5S_summarize_double,
+};
+
+static const parh5S_histogram_fn parh5S_histogram_fns[] = {
+	[PARH5S_INT8] = parh5S_histogram_int8,	   [PARH5S_UINT8] = parh5S_histogram_uint8,
+	[PARH5S_INT16] = parh5S_histogram_int16,   [PARH5S_UINT16] = parh5S_histogram_uint16,
+	[PARH5S_INT32] = parh5S_histogram_int32,   [PARH5S_UINT32] = parh5S_histogram_uint32,
+	[PARH5S_INT64] = parh5S_histogram_int64,   [PARH5S_UINT64] = parh5S_histogram_uint64,
+	[PARH5S_FLOAT] = parh5S_histogram_float,   [PARH5S_DOUBLE] = parh5S_histogram_double,
+};
+
+enum parh5S_elem_type parh5S_get_elem_type(hid_t type_id)
+{
+	const struct {
+		hid_t native_type_id;
+		enum parh5S_elem_type elem_type;
+	} native_types[] = {
+		{ H5T_NATIVE_INT8, PARH5S_INT8 },   { H5T_NATIVE_UINT8, PARH5S_UINT8 },
+		{ H5T_NATIVE_INT16, PARH5S_INT16 }, { H5T_NATIVE_UINT16, PARH5S_UINT16 },
+		{ H5T_NATIVE_INT32, PARH5S_INT32 }, { H5T_NATIVE_UINT32, PARH5S_UINT32 },
+		{ H5T_NATIVE_INT64, PARH5S_INT64 }, { H5T_NATIVE_UINT64, PARH5S_UINT64 },
+		{ H5T_NATIVE_FLOAT, PARH5S_FLOAT }, { H5T_NATIVE_DOUBLE, PARH5S_DOUBLE },
+	};
+	for (size_t i = 0; i < sizeof(native_types) / sizeof(native_types[0]); i++) {
+		if (H5Tequal(type_id, native_types[i].native_type_id) > 0)
+			return native_types[i].elem_type;
+	}
+	return PARH5S_NONE;
+}
+
+void parh5S_summarize_tile(enum parh5S_elem_type elem_type, const char *tile_buf, uint32_t num_elems,
+			   struct parh5S_zone *zone)
+{
+	if (PARH5S_NONE == elem_type || elem_type > PARH5S_DOUBLE) {
+		parh5S_set_inexact_zone(zone);
+		return;
+	}
+#ifdef PARH5S_AVX2
+	if (PARH5S_FLOAT == elem_type && parh5S_has_avx2()) {
+		parh5S_summarize_float_avx2(tile_buf, num_elems, zone);
+		return;
+	}
+	if (PARH5S_DOUBLE == elem_type && parh5S_has_avx2()) {
+		parh5S_summarize_double_avx2(tile_buf, num_elems, zone);
+		return;
+	}
+#endif
+	parh5S_summarize_fns[elem_type](tile_buf, num_elems, zone);
+}
+
+void parh5S_set_inexact_zone(struct parh5S_zone *zone)
+{
+	zone->min = -INFINITY;
+	zone->max = INFINITY;
+	zone->sum = 0;
+	zone->count = 0;
+	zone->null_count = 0;
+	zone->inexact = 1;
+}
+
+bool parh5S_zone_may_match(const struct parh5S_zone *zone, double lower, double upper)
+{
+	if (zone->inexact)
+		return true;
+	return zone->count > 0 && zone->max >= lower && zone->min <= upper;
+}
+
+bool parh5S_zone_is_exact(enum parh5S_elem_type elem_type, const struct parh5S_zone *zone)
+{
+	if (zone->inexact)
+		return false;
+	if (PARH5S_INT64 != elem_type && PARH5S_UINT64 != elem_type)
+		return true;
+	/*Widened bounds step past the limit, or land just below it*/
+	return 0 == zone->count ||
+	       (fabs(zone->min) < PARH5S_EXACT_INT_LIMIT - 1 && fabs(zone->max) < PARH5S_EXACT_INT_LIMIT - 1);
+}
+
+void parh5S_merge_zone(struct parh5S_zone *zone, const struct parh5S_zone *other)
+{
+	zone->min = fmin(zone->min, other->min);
+	zone->max = fmax(zone->max, other->max);
+	zone->sum += other->sum;
+	zone->count += other->count;
+	zone->null_count += other->null_count;
+	zone->inexact |= other->inexact;
+}
+
+/**
+ * @brief The factor that maps the distance of an element from lower to its
+ * bin. An empty range has a single value, it falls in the first bin.
+ */
+static double parh5S_bin_scale(double lower, double upper, size_t num_bins)
+{
+	return upper > lower ? (double)num_bins / (upper - lower) : 0;
+}
+
+void parh5S_histogram(enum parh5S_elem_type elem_type, const char *tile_buf, uint32_t num_elems, double lower,
+		      double upper, size_t num_bins, uint64_t bins[])
+{
+	if (PARH5S_NONE == elem_type || elem_type > PARH5S_DOUBLE || 0 == num_bins)
+		return;
+	parh5S_histogram_fns[elem_type](tile_buf, num_elems, lower, upper, parh5S_bin_scale(lower, upper, num_bins),
+					num_bins, bins);
+}
+
+bool parh5S_histogram_zone(const struct parh5S_zone *zone, double lower, double upper, size_t num_bins,
+			   uint64_t bins[])
+{
+	if (zone->inexact)
+		return false;
+	if (0 == num_bins || 0 == zone->count || zone->max < lower || zone->min > upper)
+		return true;
+	if (zone->min < lower || zone->max > upper)
+		return false;
+	double scale = parh5S_bin_scale(lower, upper, num_bins);
+	size_t min_bin = (zone->min - lower) * scale;
+	size_t max_bin = (zone->max - lower) * scale;
+	min_bin = min_bin < num_bins ? min_bin : num_bins - 1;
+	max_bin = max_bin < num_bins ? max_bin : num_bins - 1;
+	if (min_bin != max_bin)
+		return false;
+	bins[min_bin] += zone->count;
+	return true;
+}
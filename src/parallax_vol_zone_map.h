@@ -0,0 +1,90 @@
+#ifndef PARALLAX_VOL_ZONE_MAP_H
+#define PARALLAX_VOL_ZONE_MAP_H
+#include <H5Ipublic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*The element types zone maps summarize, the native integers and floats*/
+enum parh5S_elem_type {
+	PARH5S_NONE = 0,
+	PARH5S_INT8,
+	PARH5S_UINT8,
+	PARH5S_INT16,
+	PARH5S_UINT16,
+	PARH5S_INT32,
+	PARH5S_UINT32,
+	PARH5S_INT64,
+	PARH5S_UINT64,
+	PARH5S_FLOAT,
+	PARH5S_DOUBLE
+};
+
+/**
+ * The zone map of a tile, a summary of its elements stored next to it. The
+ * bounds are doubles, widened by a step where 64-bit integers do not fit a
+ * double exactly, so they always enclose the elements.
+ */
+struct parh5S_zone {
+	double min;
+	double max;
+	double sum; /*of the elements that are not NaN, in doubles*/
+	uint64_t count; /*elements that are not NaN*/
+	uint64_t null_count; /*NaN elements*/
+	uint64_t inexact; /*nonzero if nothing is known of the tile, e.g. it has delta records*/
+};
+
+/**
+ * @brief Returns the zone map type of the elements of type_id, PARH5S_NONE
+ * if they are not native integers or floats.
+ */
+enum parh5S_elem_type parh5S_get_elem_type(hid_t type_id);
+
+/**
+ * @brief Summarizes num_elems elements of elem_type into zone.
+ */
+void parh5S_summarize_tile(enum parh5S_elem_type elem_type, const char *tile_buf, uint32_t num_elems,
+			   struct parh5S_zone *zone);
+
+/**
+ * @brief Sets zone to the one of a tile nothing is known of, it matches
+ * every predicate.
+ */
+void parh5S_set_inexact_zone(struct parh5S_zone *zone);
+
+/**
+ * @brief Returns false if no element the zone summarizes is in [lower,
+ * upper], true if some may be. NaNs are in no range.
+ */
+bool parh5S_zone_may_match(const struct parh5S_zone *zone, double lower, double upper);
+
+/**
+ * @brief Returns true if the bounds of the zone are the minimum and the
+ * maximum of its elements, false if the zone is inexact or its 64-bit
+ * integer bounds were widened around elements a double does not hold.
+ */
+bool parh5S_zone_is_exact(enum parh5S_elem_type elem_type, const struct parh5S_zone *zone);
+
+/**
+ * @brief Adds the elements other summarizes to zone. A zone that has
+ * summarized nothing yet has min INFINITY, max -INFINITY and zero counts.
+ */
+void parh5S_merge_zone(struct parh5S_zone *zone, const struct parh5S_zone *other);
+
+/**
+ * @brief Counts num_elems elements of elem_type into num_bins bins of equal
+ * width that split [lower, upper]. The last bin includes upper, elements
+ * outside the range and NaNs are not counted.
+ */
+void parh5S_histogram(enum parh5S_elem_type elem_type, const char *tile_buf, uint32_t num_elems, double lower,
+		      double upper, size_t num_bins, uint64_t bins[]);
+
+/**
+ * @brief Counts into the bins of parh5S_histogram the elements a zone
+ * summarizes, if the zone tells which bin each falls in: all of them fall
+ * in the same bin, or none in the range.
+ * @return true if the elements were counted, false if the tile has to be
+ * read to count them.
+ */
+bool parh5S_histogram_zone(const struct parh5S_zone *zone, double lower, double upper, size_t num_bins,
+			   uint64_t bins[]);
+#endif
@@ -0,0 +1,139 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5VLconnector.h>
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-aggregate.h5"
+#define PAR_TEST_DATASET_NAME "aggregate"
+#define PAR_TEST_ROWS 200
+#define PAR_TEST_COLS 300
+#define PAR_TEST_CHUNK 64
+#define PAR_TEST_NUM_BINS 10
+
+static int parh5_test_value(int row, int col)
+{
+	return (row / 16) * 100 + col % 50;
+}
+
+/**
+ * Runs PARH5_AGGREGATE_OP over a hyperslab of the dataset and checks its
+ * results against the ones computed from the values written.
+ */
+static void parh5_test_aggregate_hyperslab(hid_t dataset_id, int op_type, const hsize_t start[],
+					   const hsize_t count[])
+{
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL);
+	uint64_t histogram[PAR_TEST_NUM_BINS] = { 0 };
+	struct parh5_aggregate_args aggregate = { .file_space_id = space_id,
+						  .hist_lower = 0,
+						  .hist_upper = 1000,
+						  .num_bins = PAR_TEST_NUM_BINS,
+						  .histogram = histogram };
+	H5VL_optional_args_t args = { .op_type = op_type, .args = &aggregate };
+	if (H5VLdataset_optional_op(dataset_id, &args, H5P_DEFAULT, H5ES_NONE) < 0) {
+		log_fatal("Failed to aggregate the dataset");
+		_exit(EXIT_FAILURE);
+	}
+
+	uint64_t expected_histogram[PAR_TEST_NUM_BINS] = { 0 };
+	double sum = 0;
+	int min = parh5_test_value(start[0], start[1]);
+	int max = min;
+	for (hsize_t row = start[0]; row < start[0] + count[0]; row++) {
+		for (hsize_t col = start[1]; col < start[1] + count[1]; col++) {
+			int value = parh5_test_value(row, col);
+			sum += value;
+			min = value < min ? value : min;
+			max = value > max ? value : max;
+			int bin = value / 100 < PAR_TEST_NUM_BINS ? value / 100 : PAR_TEST_NUM_BINS - 1;
+			if (value <= 1000)
+				expected_histogram[bin]++;
+		}
+	}
+	if (aggregate.count != count[0] * count[1] || aggregate.null_count || aggregate.sum != sum ||
+	    aggregate.min != min || aggregate.max != max) {
+		log_fatal("Aggregate count %lu sum %g min %g max %g whereas it should have been %llu %g %d %d",
+			  aggregate.count, aggregate.sum, aggregate.min, aggregate.max, count[0] * count[1], sum, min,
+			  max);
+		_exit(EXIT_FAILURE);
+	}
+	for (int bin = 0; bin < PAR_TEST_NUM_BINS; bin++) {
+		if (histogram[bin] == expected_histogram[bin])
+			continue;
+		log_fatal("Bin %d holds %lu elements whereas it should have held %lu", bin, histogram[bin],
+			  expected_histogram[bin]);
+		_exit(EXIT_FAILURE);
+	}
+	H5Sclose(space_id);
+}
+
+/**
+ * Creates an int dataset with zone maps, writes it whole and aggregates
+ * hyperslabs of it: the whole dataset, one that covers some tiles whole
+ * and one inside a single tile.
+ */
+static void parh5_test_aggregate(void)
+{
+	int op_type = 0;
+	if (H5VLfind_opt_operation(H5VL_SUBCLS_DATASET, PARH5_AGGREGATE_OP, &op_type) < 0) {
+		log_fatal("Operation %s is not registered", PARH5_AGGREGATE_OP);
+		_exit(EXIT_FAILURE);
+	}
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hsize_t chunk[2] = { PAR_TEST_CHUNK, PAR_TEST_CHUNK };
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(dcpl_id, 2, chunk);
+	unsigned int zone_maps = 1;
+	if (H5Pinsert2(dcpl_id, PARH5_ZONE_MAPS, sizeof(zone_maps), &zone_maps, NULL, NULL, NULL, NULL, NULL, NULL) <
+	    0) {
+		log_fatal("Failed to turn on zone maps");
+		_exit(EXIT_FAILURE);
+	}
+	hid_t dataset_id = H5Dcreate2(file_id, PAR_TEST_DATASET_NAME, H5T_NATIVE_INT, space_id, H5P_DEFAULT, dcpl_id,
+				      H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to create dataset");
+		_exit(EXIT_FAILURE);
+	}
+
+	int *values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*values));
+	for (int row = 0; row < PAR_TEST_ROWS; row++) {
+		for (int col = 0; col < PAR_TEST_COLS; col++)
+			values[row * PAR_TEST_COLS + col] = parh5_test_value(row, col);
+	}
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to write dataset");
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t whole_start[2] = { 0, 0 };
+	parh5_test_aggregate_hyperslab(dataset_id, op_type, whole_start, dims);
+	hsize_t tiles_start[2] = { 0, 10 };
+	hsize_t tiles_count[2] = { 2 * PAR_TEST_CHUNK, 3 * PAR_TEST_CHUNK };
+	parh5_test_aggregate_hyperslab(dataset_id, op_type, tiles_start, tiles_count);
+	hsize_t inner_start[2] = { 70, 70 };
+	hsize_t inner_count[2] = { 20, 30 };
+	parh5_test_aggregate_hyperslab(dataset_id, op_type, inner_start, inner_count);
+	log_info("TEST aggregate SUCCESS!");
+
+	free(values);
+	H5Pclose(dcpl_id);
+	H5Sclose(space_id);
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+}
+
+int main(void)
+{
+	parh5_test_aggregate();
+	return 0;
+}
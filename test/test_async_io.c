@@ -0,0 +1,109 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-async.h5"
+#define PAR_TEST_DATASET_NAME "async"
+#define PAR_TEST_ROWS 256
+#define PAR_TEST_COLS 512
+#define PAR_TEST_ROWS_PER_WRITE 16
+
+static void parh5_test_wait(hid_t es_id, const char *what)
+{
+	size_t num_in_progress = 0;
+	hbool_t op_failed = false;
+	if (H5ESwait(es_id, H5ES_WAIT_FOREVER, &num_in_progress, &op_failed) < 0 || num_in_progress || op_failed) {
+		log_fatal("Asynchronous %s failed", what);
+		_exit(EXIT_FAILURE);
+	}
+}
+
+static void parh5_test_verify(const int64_t *values, const char *what)
+{
+	for (int64_t elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++) {
+		if (values[elem] == elem)
+			continue;
+		log_fatal("%s: element %ld = %ld whereas it should have been %ld", what, elem, values[elem], elem);
+		_exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Writes a dataset a band of rows at a time with H5Dwrite_async, all the
+ * writes in flight in one event set, and reads it back with H5Dread_async
+ * through a memory type the connector converts in the background.
+ */
+static void parh5_test_async_io(void)
+{
+	hid_t es_id = H5EScreate();
+	hid_t file_id = H5Fcreate_async(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT, es_id);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	hid_t dataset_id = H5Dcreate_async(file_id, PAR_TEST_DATASET_NAME, H5T_NATIVE_INT, space_id, H5P_DEFAULT,
+					   H5P_DEFAULT, H5P_DEFAULT, es_id);
+	int *ints = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*ints));
+	for (int elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++)
+		ints[elem] = elem;
+
+	hsize_t band[2] = { PAR_TEST_ROWS_PER_WRITE, PAR_TEST_COLS };
+	hid_t mem_space_id = H5Screate_simple(2, band, NULL);
+	for (hsize_t row = 0; row < PAR_TEST_ROWS; row += PAR_TEST_ROWS_PER_WRITE) {
+		hsize_t start[2] = { row, 0 };
+		hid_t file_space_id = H5Scopy(space_id);
+		H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, start, NULL, band, NULL);
+		/*The connector is done with the selections when the call returns*/
+		if (H5Dwrite_async(dataset_id, H5T_NATIVE_INT, mem_space_id, file_space_id, H5P_DEFAULT,
+				   &ints[row * PAR_TEST_COLS], es_id) < 0) {
+			log_fatal("Failed to write rows %lu", row);
+			_exit(EXIT_FAILURE);
+		}
+		H5Sclose(file_space_id);
+	}
+	parh5_test_wait(es_id, "writes");
+
+	int64_t *values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*values));
+	if (H5Dread_async(dataset_id, H5T_NATIVE_INT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, values, es_id) < 0) {
+		log_fatal("Failed to read dataset");
+		_exit(EXIT_FAILURE);
+	}
+	parh5_test_wait(es_id, "read");
+	parh5_test_verify(values, "Asynchronous read");
+
+	/*Synchronous calls see the asynchronous writes before them*/
+	for (int elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++)
+		ints[elem] = -elem;
+	if (H5Dwrite_async(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, ints, es_id) < 0 ||
+	    H5Dread(dataset_id, H5T_NATIVE_INT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to overwrite dataset");
+		_exit(EXIT_FAILURE);
+	}
+	parh5_test_wait(es_id, "overwrite");
+	for (int64_t elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++)
+		values[elem] = -values[elem];
+	parh5_test_verify(values, "Synchronous read");
+	log_info("TEST asynchronous I/O SUCCESS!");
+
+	free(values);
+	free(ints);
+	H5Sclose(mem_space_id);
+	H5Sclose(space_id);
+	H5Dclose_async(dataset_id, es_id);
+	H5Fclose_async(file_id, es_id);
+	parh5_test_wait(es_id, "close");
+	H5ESclose(es_id);
+}
+
+int main(void)
+{
+	parh5_test_async_io();
+	return 0;
+}
@@ -0,0 +1,131 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5VLconnector.h>
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-bitmap_index.h5"
+#define PAR_TEST_DATASET_NAME "bitmap_index"
+#define PAR_TEST_ROWS 200
+#define PAR_TEST_COLS 300
+#define PAR_TEST_CHUNK 64
+#define PAR_TEST_MAX_VALUE 1000
+#define PAR_TEST_NUM_BINS 20
+
+static int parh5_test_value(int row, int col)
+{
+	return (row * 7 + col) % PAR_TEST_MAX_VALUE;
+}
+
+/**
+ * Runs PARH5_QUERY_ELEMENTS_OP on the dataset and checks that it returns
+ * exactly the elements whose values are in [lower, upper], with their
+ * values.
+ */
+static void parh5_test_query(hid_t dataset_id, int op_type, int lower, int upper)
+{
+	struct parh5_query_elements_args query = { .lower = lower, .upper = upper, .read_values = 1 };
+	H5VL_optional_args_t args = { .op_type = op_type, .args = &query };
+	if (H5VLdataset_optional_op(dataset_id, &args, H5P_DEFAULT, H5ES_NONE) < 0) {
+		log_fatal("Failed to query the elements of the dataset");
+		_exit(EXIT_FAILURE);
+	}
+	size_t num_elems = 0;
+	for (int row = 0; row < PAR_TEST_ROWS; row++) {
+		for (int col = 0; col < PAR_TEST_COLS; col++) {
+			int value = parh5_test_value(row, col);
+			num_elems += value >= lower && value <= upper;
+		}
+	}
+	if (query.num_elems != num_elems) {
+		log_fatal("Query [%d, %d] returned %zu elements whereas it should have returned %zu", lower, upper,
+			  query.num_elems, num_elems);
+		_exit(EXIT_FAILURE);
+	}
+	const int *values = query.values;
+	for (size_t i = 0; i < query.num_elems; i++) {
+		hsize_t row = query.coords[2 * i];
+		hsize_t col = query.coords[2 * i + 1];
+		if (row < PAR_TEST_ROWS && col < PAR_TEST_COLS && values[i] == parh5_test_value(row, col) &&
+		    values[i] >= lower && values[i] <= upper)
+			continue;
+		log_fatal("Query [%d, %d] returned element (%llu, %llu) of value %d that is not in range", lower,
+			  upper, (unsigned long long)row, (unsigned long long)col, values[i]);
+		_exit(EXIT_FAILURE);
+	}
+	free(query.coords);
+	free(query.values);
+}
+
+/**
+ * Creates a dataset with a bitmap index, writes it whole, and queries value
+ * ranges before and after reopening the file: ranges within a bin, across
+ * bins, over the whole index and outside it.
+ */
+static void parh5_test_bitmap_index(void)
+{
+	int op_type = 0;
+	if (H5VLfind_opt_operation(H5VL_SUBCLS_DATASET, PARH5_QUERY_ELEMENTS_OP, &op_type) < 0) {
+		log_fatal("Operation %s is not registered", PARH5_QUERY_ELEMENTS_OP);
+		_exit(EXIT_FAILURE);
+	}
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hsize_t chunk[2] = { PAR_TEST_CHUNK, PAR_TEST_CHUNK };
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(dcpl_id, 2, chunk);
+	struct parh5_bitmap_index bitmap = { .lower = 0, .upper = PAR_TEST_MAX_VALUE, .num_bins = PAR_TEST_NUM_BINS };
+	if (H5Pinsert2(dcpl_id, PARH5_BITMAP_INDEX, sizeof(bitmap), &bitmap, NULL, NULL, NULL, NULL, NULL, NULL) < 0) {
+		log_fatal("Failed to turn on the bitmap index");
+		_exit(EXIT_FAILURE);
+	}
+	hid_t dataset_id = H5Dcreate2(file_id, PAR_TEST_DATASET_NAME, H5T_NATIVE_INT, space_id, H5P_DEFAULT, dcpl_id,
+				      H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to create dataset");
+		_exit(EXIT_FAILURE);
+	}
+
+	int *values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*values));
+	for (int row = 0; row < PAR_TEST_ROWS; row++) {
+		for (int col = 0; col < PAR_TEST_COLS; col++)
+			values[row * PAR_TEST_COLS + col] = parh5_test_value(row, col);
+	}
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to write dataset");
+		_exit(EXIT_FAILURE);
+	}
+	parh5_test_query(dataset_id, op_type, 110, 120);
+	parh5_test_query(dataset_id, op_type, 90, 610);
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+
+	file_id = H5Fopen(PAR_TEST_FILE_NAME, H5F_ACC_RDONLY, H5P_DEFAULT);
+	dataset_id = H5Dopen2(file_id, PAR_TEST_DATASET_NAME, H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to open dataset");
+		_exit(EXIT_FAILURE);
+	}
+	parh5_test_query(dataset_id, op_type, 0, PAR_TEST_MAX_VALUE);
+	parh5_test_query(dataset_id, op_type, 999, 2000);
+	parh5_test_query(dataset_id, op_type, -10, -1);
+	log_info("TEST bitmap index SUCCESS!");
+
+	free(values);
+	H5Pclose(dcpl_id);
+	H5Sclose(space_id);
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+}
+
+int main(void)
+{
+	parh5_test_bitmap_index();
+	return 0;
+}
@@ -0,0 +1,197 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-fill.h5"
+#define PAR_TEST_DATASET_NAME "fill"
+#define PAR_TEST_DELTA_DATASET_NAME "fill_delta"
+#define PAR_TEST_ROWS 200
+#define PAR_TEST_COLS 300
+#define PAR_TEST_CHUNK 32
+#define PAR_TEST_FILL_VALUE -7
+#define PAR_TEST_ROW 100
+
+static void parh5_test_read(hid_t dataset_id, hid_t mem_type_id, void *buf)
+{
+	if (H5Dread(dataset_id, mem_type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf) < 0) {
+		log_fatal("Failed to read dataset");
+		_exit(EXIT_FAILURE);
+	}
+}
+
+static void parh5_test_verify(const int *values, int written_row, const char *what)
+{
+	for (int row = 0; row < PAR_TEST_ROWS; row++) {
+		for (int col = 0; col < PAR_TEST_COLS; col++) {
+			int expected = row == written_row ? col : PAR_TEST_FILL_VALUE;
+			if (values[row * PAR_TEST_COLS + col] == expected)
+				continue;
+			log_fatal("%s: element (%d, %d) = %d whereas it should have been %d", what, row, col,
+				  values[row * PAR_TEST_COLS + col], expected);
+			_exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * Creates a chunked dataset with a fill value, reads it before any write,
+ * writes it whole with the fill value everywhere but one row, and reads it
+ * back after reopening the file. Tiles that hold only the fill value are
+ * not stored, they must read as the fill value nonetheless, also through a
+ * memory type the connector converts to.
+ */
+static void parh5_test_fill_value(void)
+{
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hsize_t chunk[2] = { PAR_TEST_CHUNK, PAR_TEST_CHUNK };
+	int fill_value = PAR_TEST_FILL_VALUE;
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(dcpl_id, 2, chunk);
+	H5Pset_fill_value(dcpl_id, H5T_NATIVE_INT, &fill_value);
+	hid_t dataset_id = H5Dcreate2(file_id, PAR_TEST_DATASET_NAME, H5T_NATIVE_INT, space_id, H5P_DEFAULT, dcpl_id,
+				      H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to create dataset");
+		_exit(EXIT_FAILURE);
+	}
+
+	int *values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*values));
+	parh5_test_read(dataset_id, H5T_NATIVE_INT, values);
+	parh5_test_verify(values, -1, "Unwritten dataset");
+
+	long long *wide_values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*wide_values));
+	parh5_test_read(dataset_id, H5T_NATIVE_LLONG, wide_values);
+	for (int elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++)
+		values[elem] = (int)wide_values[elem];
+	parh5_test_verify(values, -1, "Unwritten dataset converted");
+
+	for (int elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++)
+		values[elem] = PAR_TEST_FILL_VALUE;
+	for (int col = 0; col < PAR_TEST_COLS; col++)
+		values[PAR_TEST_ROW * PAR_TEST_COLS + col] = col;
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to write dataset");
+		_exit(EXIT_FAILURE);
+	}
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+
+	file_id = H5Fopen(PAR_TEST_FILE_NAME, H5F_ACC_RDONLY, H5P_DEFAULT);
+	dataset_id = H5Dopen2(file_id, PAR_TEST_DATASET_NAME, H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to open dataset");
+		_exit(EXIT_FAILURE);
+	}
+	parh5_test_read(dataset_id, H5T_NATIVE_INT, values);
+	parh5_test_verify(values, PAR_TEST_ROW, "Reopened dataset");
+	log_info("TEST fill value SUCCESS!");
+
+	free(wide_values);
+	free(values);
+	H5Pclose(dcpl_id);
+	H5Sclose(space_id);
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+}
+
+static hid_t parh5_test_reopen(hid_t file_id, hid_t dataset_id, hid_t *reopened_dataset_id)
+{
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+	file_id = H5Fopen(PAR_TEST_FILE_NAME, H5F_ACC_RDWR, H5P_DEFAULT);
+	*reopened_dataset_id = H5Dopen2(file_id, PAR_TEST_DELTA_DATASET_NAME, H5P_DEFAULT);
+	if (*reopened_dataset_id < 0) {
+		log_fatal("Failed to open dataset");
+		_exit(EXIT_FAILURE);
+	}
+	return file_id;
+}
+
+/**
+ * Creates a dataset with a fill value and delta updates, writes it whole,
+ * updates a few rows partially so that its tiles get delta records, and
+ * then overwrites it whole with the fill value. The tiles are not stored
+ * then, and their delta records must go with them: after reopening the
+ * file the dataset reads as the fill value everywhere.
+ */
+static void parh5_test_fill_over_deltas(void)
+{
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hsize_t chunk[2] = { PAR_TEST_CHUNK, PAR_TEST_CHUNK };
+	int fill_value = PAR_TEST_FILL_VALUE;
+	unsigned int delta_threshold = 8;
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(dcpl_id, 2, chunk);
+	H5Pset_fill_value(dcpl_id, H5T_NATIVE_INT, &fill_value);
+	if (H5Pinsert2(dcpl_id, PARH5_DELTA_UPDATES, sizeof(delta_threshold), &delta_threshold, NULL, NULL, NULL, NULL,
+		       NULL, NULL) < 0) {
+		log_fatal("Failed to turn on delta updates");
+		_exit(EXIT_FAILURE);
+	}
+	hid_t dataset_id = H5Dcreate2(file_id, PAR_TEST_DELTA_DATASET_NAME, H5T_NATIVE_INT, space_id, H5P_DEFAULT,
+				      dcpl_id, H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to create dataset");
+		_exit(EXIT_FAILURE);
+	}
+	int *values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*values));
+	for (int elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++)
+		values[elem] = elem;
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to write dataset");
+		_exit(EXIT_FAILURE);
+	}
+	file_id = parh5_test_reopen(file_id, dataset_id, &dataset_id);
+
+	/*Partial rows of tiles that are not cached become delta records*/
+	hsize_t start[2] = { PAR_TEST_ROW, 3 };
+	hsize_t count[2] = { 1, PAR_TEST_COLS - 10 };
+	hid_t file_space_id = H5Screate_simple(2, dims, NULL);
+	H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, start, NULL, count, NULL);
+	hid_t mem_space_id = H5Screate_simple(2, count, NULL);
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, mem_space_id, file_space_id, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to update dataset");
+		_exit(EXIT_FAILURE);
+	}
+	H5Sclose(mem_space_id);
+	H5Sclose(file_space_id);
+	file_id = parh5_test_reopen(file_id, dataset_id, &dataset_id);
+
+	for (int elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++)
+		values[elem] = PAR_TEST_FILL_VALUE;
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to overwrite dataset");
+		_exit(EXIT_FAILURE);
+	}
+	file_id = parh5_test_reopen(file_id, dataset_id, &dataset_id);
+	parh5_test_read(dataset_id, H5T_NATIVE_INT, values);
+	parh5_test_verify(values, -1, "Dataset overwritten with the fill value");
+	log_info("TEST fill value over delta records SUCCESS!");
+
+	free(values);
+	H5Pclose(dcpl_id);
+	H5Sclose(space_id);
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+}
+
+int main(void)
+{
+	parh5_test_fill_value();
+	parh5_test_fill_over_deltas();
+	return 0;
+}
@@ -0,0 +1,96 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-filters.h5"
+#define PAR_TEST_DATASET_NAME "filtered"
+#define PAR_TEST_ROWS 200
+#define PAR_TEST_COLS 300
+#define PAR_TEST_CHUNK 32
+#define PAR_TEST_DEFLATE_LEVEL 6
+/*An id no filter is registered with, the dataset is written without it since it is optional*/
+#define PAR_TEST_UNKNOWN_FILTER 32123
+
+static int parh5_test_value(int row, int col)
+{
+	return row * PAR_TEST_COLS + col / 4;
+}
+
+/**
+ * Creates a chunked dataset with shuffle, deflate and fletcher32, plus an
+ * optional filter that is not available, writes it whole and reads it back
+ * after reopening the file. Tiles pass through the filters on their way to
+ * and from Parallax and must read back unchanged.
+ */
+static void parh5_test_filters(void)
+{
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hsize_t chunk[2] = { PAR_TEST_CHUNK, PAR_TEST_CHUNK };
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(dcpl_id, 2, chunk);
+	H5Pset_shuffle(dcpl_id);
+	H5Pset_deflate(dcpl_id, PAR_TEST_DEFLATE_LEVEL);
+	H5Pset_fletcher32(dcpl_id);
+	H5Pset_filter(dcpl_id, PAR_TEST_UNKNOWN_FILTER, H5Z_FLAG_OPTIONAL, 0, NULL);
+	hid_t dataset_id = H5Dcreate2(file_id, PAR_TEST_DATASET_NAME, H5T_NATIVE_INT, space_id, H5P_DEFAULT, dcpl_id,
+				      H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to create dataset");
+		_exit(EXIT_FAILURE);
+	}
+
+	int *values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*values));
+	for (int row = 0; row < PAR_TEST_ROWS; row++) {
+		for (int col = 0; col < PAR_TEST_COLS; col++)
+			values[row * PAR_TEST_COLS + col] = parh5_test_value(row, col);
+	}
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to write dataset");
+		_exit(EXIT_FAILURE);
+	}
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+
+	file_id = H5Fopen(PAR_TEST_FILE_NAME, H5F_ACC_RDONLY, H5P_DEFAULT);
+	dataset_id = H5Dopen2(file_id, PAR_TEST_DATASET_NAME, H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to open dataset");
+		_exit(EXIT_FAILURE);
+	}
+	int *read_values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*read_values));
+	if (H5Dread(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, read_values) < 0) {
+		log_fatal("Failed to read dataset");
+		_exit(EXIT_FAILURE);
+	}
+	for (int row = 0; row < PAR_TEST_ROWS; row++) {
+		for (int col = 0; col < PAR_TEST_COLS; col++) {
+			if (read_values[row * PAR_TEST_COLS + col] == parh5_test_value(row, col))
+				continue;
+			log_fatal("Element (%d, %d) = %d whereas it should have been %d", row, col,
+				  read_values[row * PAR_TEST_COLS + col], parh5_test_value(row, col));
+			_exit(EXIT_FAILURE);
+		}
+	}
+	log_info("TEST filters SUCCESS!");
+
+	free(read_values);
+	free(values);
+	H5Pclose(dcpl_id);
+	H5Sclose(space_id);
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+}
+
+int main(void)
+{
+	parh5_test_filters();
+	return 0;
+}
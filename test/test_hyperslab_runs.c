@@ -0,0 +1,184 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-runs.h5"
+#define PAR_TEST_DATASET_NAME "par_dataset"
+
+#define PAR_TEST_ROWS 64
+#define PAR_TEST_COLS 1000
+#define PAR_TEST_BLOCK_ROW 5
+#define PAR_TEST_BLOCK_COL 300
+#define PAR_TEST_BLOCK_ROWS 10
+#define PAR_TEST_BLOCK_COLS 500
+#define PAR_TEST_COLUMN 777
+#define PAR_TEST_OVERWRITE_VALUE -1
+#define PAR_TEST_STRIDE 3
+#define PAR_TEST_STRIDED_COUNT 20
+#define PAR_TEST_STRIDED_READS 4
+#define PAR_TEST_NUM_POINTS 4
+
+static int parh5_test_value(hsize_t row, hsize_t col)
+{
+	return row * PAR_TEST_COLS + col;
+}
+
+static void parh5_test_read_block(hid_t dataset_id, hid_t file_space_id, hsize_t start[2], hsize_t count[2], int *buf)
+{
+	hid_t mem_space_id = H5Screate_simple(2, count, NULL);
+	H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, start, NULL, count, NULL);
+	if (H5Dread(dataset_id, H5T_NATIVE_INT, mem_space_id, file_space_id, H5P_DEFAULT, buf) < 0) {
+		log_fatal("Failed to read block");
+		_exit(EXIT_FAILURE);
+	}
+	H5Sclose(mem_space_id);
+}
+
+static void parh5_test_hyperslab_runs(void)
+{
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hid_t file_space_id = H5Screate_simple(2, dims, NULL);
+	hid_t dataset_id = H5Dcreate2(file_id, PAR_TEST_DATASET_NAME, H5T_NATIVE_INT, file_space_id, H5P_DEFAULT,
+				      H5P_DEFAULT, H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to create dataset");
+		_exit(EXIT_FAILURE);
+	}
+
+	int *array = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(int));
+	for (hsize_t row = 0; row < PAR_TEST_ROWS; row++)
+		for (hsize_t col = 0; col < PAR_TEST_COLS; col++)
+			array[row * PAR_TEST_COLS + col] = parh5_test_value(row, col);
+
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, array) < 0) {
+		log_fatal("Failed to write the whole array");
+		_exit(EXIT_FAILURE);
+	}
+
+	log_debug("Reading a sub-block of the array...");
+	int *block = calloc(PAR_TEST_BLOCK_ROWS * PAR_TEST_BLOCK_COLS, sizeof(int));
+	hsize_t block_start[2] = { PAR_TEST_BLOCK_ROW, PAR_TEST_BLOCK_COL };
+	hsize_t block_count[2] = { PAR_TEST_BLOCK_ROWS, PAR_TEST_BLOCK_COLS };
+	parh5_test_read_block(dataset_id, file_space_id, block_start, block_count, block);
+	for (hsize_t row = 0; row < PAR_TEST_BLOCK_ROWS; row++) {
+		for (hsize_t col = 0; col < PAR_TEST_BLOCK_COLS; col++) {
+			int expected = parh5_test_value(PAR_TEST_BLOCK_ROW + row, PAR_TEST_BLOCK_COL + col);
+			if (block[row * PAR_TEST_BLOCK_COLS + col] == expected)
+				continue;
+			log_fatal("Corrupted block element [%lu][%lu] = %d whereas it should have been %d", row, col,
+				  block[row * PAR_TEST_BLOCK_COLS + col], expected);
+			_exit(EXIT_FAILURE);
+		}
+	}
+
+	log_debug("Reading a column of the array...");
+	int column[PAR_TEST_ROWS] = { 0 };
+	hsize_t column_start[2] = { 0, PAR_TEST_COLUMN };
+	hsize_t column_count[2] = { PAR_TEST_ROWS, 1 };
+	parh5_test_read_block(dataset_id, file_space_id, column_start, column_count, column);
+	for (hsize_t row = 0; row < PAR_TEST_ROWS; row++) {
+		if (column[row] == parh5_test_value(row, PAR_TEST_COLUMN))
+			continue;
+		log_fatal("Corrupted column element [%lu] = %d whereas it should have been %d", row, column[row],
+			  parh5_test_value(row, PAR_TEST_COLUMN));
+		_exit(EXIT_FAILURE);
+	}
+
+	log_debug("Reading a strided selection of the array at shifted offsets...");
+	int strided[PAR_TEST_STRIDED_COUNT * PAR_TEST_STRIDED_COUNT] = { 0 };
+	hsize_t strided_stride[2] = { PAR_TEST_STRIDE, PAR_TEST_STRIDE };
+	hsize_t strided_count[2] = { PAR_TEST_STRIDED_COUNT, PAR_TEST_STRIDED_COUNT };
+	hid_t strided_space_id = H5Screate_simple(2, strided_count, NULL);
+	/*The same shape again and at another offset, the later reads reuse the access plan of the first*/
+	for (hsize_t shift = 0; shift < PAR_TEST_STRIDED_READS; shift++) {
+		hsize_t strided_start[2] = { 1 + shift / 2, PAR_TEST_COLUMN - PAR_TEST_STRIDE * PAR_TEST_STRIDED_COUNT };
+		H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, strided_start, strided_stride, strided_count, NULL);
+		if (H5Dread(dataset_id, H5T_NATIVE_INT, strided_space_id, file_space_id, H5P_DEFAULT, strided) < 0) {
+			log_fatal("Failed to read strided selection");
+			_exit(EXIT_FAILURE);
+		}
+		for (hsize_t row = 0; row < PAR_TEST_STRIDED_COUNT; row++) {
+			for (hsize_t col = 0; col < PAR_TEST_STRIDED_COUNT; col++) {
+				int expected = parh5_test_value(strided_start[0] + row * PAR_TEST_STRIDE,
+								strided_start[1] + col * PAR_TEST_STRIDE);
+				if (strided[row * PAR_TEST_STRIDED_COUNT + col] == expected)
+					continue;
+				log_fatal("Corrupted strided element [%lu][%lu] = %d whereas it should have been %d",
+					  row, col, strided[row * PAR_TEST_STRIDED_COUNT + col], expected);
+				_exit(EXIT_FAILURE);
+			}
+		}
+	}
+	H5Sclose(strided_space_id);
+
+	log_debug("Reading a point selection of the array...");
+	hsize_t points[PAR_TEST_NUM_POINTS][2] = {
+		{ PAR_TEST_ROWS - 1, PAR_TEST_COLS - 1 }, { 0, 0 }, { PAR_TEST_ROWS / 2, PAR_TEST_COLUMN }, { 0, 0 }
+	};
+	int point_values[PAR_TEST_NUM_POINTS] = { 0 };
+	hsize_t num_points = PAR_TEST_NUM_POINTS;
+	hid_t points_space_id = H5Screate_simple(1, &num_points, NULL);
+	H5Sselect_elements(file_space_id, H5S_SELECT_SET, PAR_TEST_NUM_POINTS, &points[0][0]);
+	if (H5Dread(dataset_id, H5T_NATIVE_INT, points_space_id, file_space_id, H5P_DEFAULT, point_values) < 0) {
+		log_fatal("Failed to read point selection");
+		_exit(EXIT_FAILURE);
+	}
+	H5Sclose(points_space_id);
+	for (int i = 0; i < PAR_TEST_NUM_POINTS; i++) {
+		if (point_values[i] == parh5_test_value(points[i][0], points[i][1]))
+			continue;
+		log_fatal("Corrupted point %d = %d whereas it should have been %d", i, point_values[i],
+			  parh5_test_value(points[i][0], points[i][1]));
+		_exit(EXIT_FAILURE);
+	}
+
+	log_debug("Overwriting the sub-block and verifying the whole array...");
+	for (hsize_t i = 0; i < PAR_TEST_BLOCK_ROWS * PAR_TEST_BLOCK_COLS; i++)
+		block[i] = PAR_TEST_OVERWRITE_VALUE;
+	hid_t mem_space_id = H5Screate_simple(2, block_count, NULL);
+	H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, block_start, NULL, block_count, NULL);
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, mem_space_id, file_space_id, H5P_DEFAULT, block) < 0) {
+		log_fatal("Failed to write block");
+		_exit(EXIT_FAILURE);
+	}
+	H5Sclose(mem_space_id);
+
+	if (H5Dread(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, array) < 0) {
+		log_fatal("Failed to read the whole array");
+		_exit(EXIT_FAILURE);
+	}
+	for (hsize_t row = 0; row < PAR_TEST_ROWS; row++) {
+		for (hsize_t col = 0; col < PAR_TEST_COLS; col++) {
+			bool in_block = row >= PAR_TEST_BLOCK_ROW && row < PAR_TEST_BLOCK_ROW + PAR_TEST_BLOCK_ROWS &&
+					col >= PAR_TEST_BLOCK_COL && col < PAR_TEST_BLOCK_COL + PAR_TEST_BLOCK_COLS;
+			int expected = in_block ? PAR_TEST_OVERWRITE_VALUE : parh5_test_value(row, col);
+			if (array[row * PAR_TEST_COLS + col] == expected)
+				continue;
+			log_fatal("Corrupted array element [%lu][%lu] = %d whereas it should have been %d", row, col,
+				  array[row * PAR_TEST_COLS + col], expected);
+			_exit(EXIT_FAILURE);
+		}
+	}
+	log_info("TEST hyperslab runs SUCCESS!");
+
+	free(block);
+	free(array);
+	H5Dclose(dataset_id);
+	H5Sclose(file_space_id);
+	H5Fclose(file_id);
+}
+
+int main(void)
+{
+	parh5_test_hyperslab_runs();
+	return 0;
+}
@@ -0,0 +1,100 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-lossy.h5"
+#define PAR_TEST_DATASET_NAME "lossy"
+#define PAR_TEST_ROWS 200
+#define PAR_TEST_COLS 300
+#define PAR_TEST_CHUNK 64
+#define PAR_TEST_ERROR_BOUND 1e-3
+
+static double parh5_test_value(int row, int col)
+{
+	return 100 * sin(row * 0.05) * cos(col * 0.03);
+}
+
+/**
+ * Creates a double dataset with an error bound, writes it whole and reads
+ * it back after reopening the file. Every element must read back within the
+ * bound, except the NaN and the infinity which must read back as they are.
+ */
+static void parh5_test_lossy(void)
+{
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hsize_t chunk[2] = { PAR_TEST_CHUNK, PAR_TEST_CHUNK };
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(dcpl_id, 2, chunk);
+	double error_bound = PAR_TEST_ERROR_BOUND;
+	if (H5Pinsert2(dcpl_id, PARH5_LOSSY_ERROR_BOUND, sizeof(error_bound), &error_bound, NULL, NULL, NULL, NULL,
+		       NULL, NULL) < 0) {
+		log_fatal("Failed to set the error bound");
+		_exit(EXIT_FAILURE);
+	}
+	hid_t dataset_id = H5Dcreate2(file_id, PAR_TEST_DATASET_NAME, H5T_NATIVE_DOUBLE, space_id, H5P_DEFAULT, dcpl_id,
+				      H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to create dataset");
+		_exit(EXIT_FAILURE);
+	}
+
+	double *values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*values));
+	for (int row = 0; row < PAR_TEST_ROWS; row++) {
+		for (int col = 0; col < PAR_TEST_COLS; col++)
+			values[row * PAR_TEST_COLS + col] = parh5_test_value(row, col);
+	}
+	values[PAR_TEST_COLS + 1] = NAN;
+	values[2 * PAR_TEST_COLS + 2] = INFINITY;
+	if (H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to write dataset");
+		_exit(EXIT_FAILURE);
+	}
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+
+	file_id = H5Fopen(PAR_TEST_FILE_NAME, H5F_ACC_RDONLY, H5P_DEFAULT);
+	dataset_id = H5Dopen2(file_id, PAR_TEST_DATASET_NAME, H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to open dataset");
+		_exit(EXIT_FAILURE);
+	}
+	double *read_values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*read_values));
+	if (H5Dread(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, read_values) < 0) {
+		log_fatal("Failed to read dataset");
+		_exit(EXIT_FAILURE);
+	}
+	for (int idx = 0; idx < PAR_TEST_ROWS * PAR_TEST_COLS; idx++) {
+		double value = values[idx];
+		double read_value = read_values[idx];
+		if (isnan(value) ? isnan(read_value) :
+		    isinf(value) ? value == read_value :
+				   fabs(value - read_value) <= PAR_TEST_ERROR_BOUND)
+			continue;
+		log_fatal("Element (%d, %d) = %g whereas it should have been %g within %g", idx / PAR_TEST_COLS,
+			  idx % PAR_TEST_COLS, read_value, value, PAR_TEST_ERROR_BOUND);
+		_exit(EXIT_FAILURE);
+	}
+	log_info("TEST lossy SUCCESS!");
+
+	free(read_values);
+	free(values);
+	H5Pclose(dcpl_id);
+	H5Sclose(space_id);
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+}
+
+int main(void)
+{
+	parh5_test_lossy();
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-multi.h5"
+#define PAR_TEST_NUM_DATASETS 24
+#define PAR_TEST_NUM_TIMESTEPS 4
+#define PAR_TEST_ELEMS 500
+
+static int parh5_test_value(int dataset, int timestep, int elem)
+{
+	return (dataset * PAR_TEST_NUM_TIMESTEPS + timestep) * PAR_TEST_ELEMS + elem;
+}
+
+/**
+ * Writes one small dataset per variable each timestep with a single
+ * H5Dwrite_multi call, like simulation codes do, and reads them back with
+ * H5Dread_multi.
+ */
+static void parh5_test_multi_datasets(void)
+{
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+
+	hsize_t dims[1] = { PAR_TEST_ELEMS };
+	hid_t space_id = H5Screate_simple(1, dims, NULL);
+	hid_t dataset_ids[PAR_TEST_NUM_DATASETS];
+	hid_t mem_type_ids[PAR_TEST_NUM_DATASETS];
+	hid_t mem_space_ids[PAR_TEST_NUM_DATASETS];
+	hid_t file_space_ids[PAR_TEST_NUM_DATASETS];
+	for (int i = 0; i < PAR_TEST_NUM_DATASETS; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "variable_%d", i);
+		dataset_ids[i] =
+			H5Dcreate2(file_id, name, H5T_NATIVE_INT, space_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+		if (dataset_ids[i] < 0) {
+			log_fatal("Failed to create dataset %s", name);
+			_exit(EXIT_FAILURE);
+		}
+		mem_type_ids[i] = H5T_NATIVE_INT;
+		mem_space_ids[i] = H5S_ALL;
+		file_space_ids[i] = H5S_ALL;
+	}
+
+	int(*data)[PAR_TEST_ELEMS] = calloc(PAR_TEST_NUM_DATASETS, sizeof(*data));
+	const void *write_bufs[PAR_TEST_NUM_DATASETS];
+	void *read_bufs[PAR_TEST_NUM_DATASETS];
+	for (int timestep = 0; timestep < PAR_TEST_NUM_TIMESTEPS; timestep++) {
+		for (int i = 0; i < PAR_TEST_NUM_DATASETS; i++) {
+			for (int elem = 0; elem < PAR_TEST_ELEMS; elem++)
+				data[i][elem] = parh5_test_value(i, timestep, elem);
+			write_bufs[i] = data[i];
+			read_bufs[i] = data[i];
+		}
+		if (H5Dwrite_multi(PAR_TEST_NUM_DATASETS, dataset_ids, mem_type_ids, mem_space_ids, file_space_ids,
+				   H5P_DEFAULT, write_bufs) < 0) {
+			log_fatal("Failed to write timestep %d", timestep);
+			_exit(EXIT_FAILURE);
+		}
+
+		for (int i = 0; i < PAR_TEST_NUM_DATASETS; i++)
+			for (int elem = 0; elem < PAR_TEST_ELEMS; elem++)
+				data[i][elem] = -1;
+		if (H5Dread_multi(PAR_TEST_NUM_DATASETS, dataset_ids, mem_type_ids, mem_space_ids, file_space_ids,
+				  H5P_DEFAULT, read_bufs) < 0) {
+			log_fatal("Failed to read timestep %d", timestep);
+			_exit(EXIT_FAILURE);
+		}
+		for (int i = 0; i < PAR_TEST_NUM_DATASETS; i++) {
+			for (int elem = 0; elem < PAR_TEST_ELEMS; elem++) {
+				if (data[i][elem] == parh5_test_value(i, timestep, elem))
+					continue;
+				log_fatal("Corrupted element %d of dataset %d = %d whereas it should have been %d", elem,
+					  i, data[i][elem], parh5_test_value(i, timestep, elem));
+				_exit(EXIT_FAILURE);
+			}
+		}
+	}
+	log_info("TEST multi datasets SUCCESS!");
+
+	free(data);
+	for (int i = 0; i < PAR_TEST_NUM_DATASETS; i++)
+		H5Dclose(dataset_ids[i]);
+	H5Sclose(space_id);
+	H5Fclose(file_id);
+}
+
+int main(void)
+{
+	parh5_test_multi_datasets();
+	return 0;
+}
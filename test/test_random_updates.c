@@ -1,3 +1,4 @@
+#include "../src/parallax_vol_connector.h"
 #include <hdf5.h>
 #include <log.h>
 #include <stdio.h>
@@ -18,6 +19,8 @@
 
 const char *filename = "super_duper_dataset";
 const char *dset_name = "my_dataset";
+/*Number of delta records per tile before they are folded, 0 disables delta updates*/
+unsigned int delta_threshold = 0;
 
 static void hdf5_create_and_write_array(const char *filename)
 {
@@ -39,6 +42,9 @@ static void hdf5_create_and_write_array(const char *filename)
 	hid_t cparms = H5Pcreate(H5P_DATASET_CREATE);
 	hsize_t chunk_dims[2] = { 1, SUBCOLS }; // Chunk dimensions
 	H5Pset_chunk(cparms, 2, chunk_dims);
+	if (delta_threshold)
+		CHECK_ERROR(H5Pinsert2(cparms, PARH5_DELTA_UPDATES, sizeof(delta_threshold), &delta_threshold, NULL, NULL,
+				       NULL, NULL, NULL, NULL))
 	hid_t dataset_id =
 		H5Dcreate2(file_id, dset_name, H5T_NATIVE_INT, dataspace_id, H5P_DEFAULT, cparms, H5P_DEFAULT);
 	CHECK_ERROR(dataset_id)
@@ -122,6 +128,9 @@ int main(int argc, char **argv)
 		if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
 			operation = argv[i + 1];
 			i++; // skip the next argument since we've just processed it
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			delta_threshold = strtoul(argv[i + 1], NULL, 10);
+			i++;
 		}
 	}
 
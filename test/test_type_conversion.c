@@ -0,0 +1,90 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-conversion.h5"
+#define PAR_TEST_ROWS 100
+#define PAR_TEST_COLS 300
+
+static void parh5_test_write(hid_t dataset_id, hid_t mem_type_id, const void *buf)
+{
+	if (H5Dwrite(dataset_id, mem_type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf) < 0) {
+		log_fatal("Failed to write dataset");
+		_exit(EXIT_FAILURE);
+	}
+}
+
+static void parh5_test_read(hid_t dataset_id, hid_t mem_type_id, void *buf)
+{
+	if (H5Dread(dataset_id, mem_type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf) < 0) {
+		log_fatal("Failed to read dataset");
+		_exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Reads and writes datasets with a memory type other than the dataset type:
+ * a float dataset through double buffers, a big-endian dataset through
+ * native int buffers, and a short dataset through double buffers, which has
+ * no conversion loop of its own in the connector.
+ */
+static void parh5_test_type_conversion(void)
+{
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	hid_t file_types[] = { H5T_NATIVE_FLOAT, H5T_STD_I32BE, H5T_NATIVE_SHORT };
+	hid_t mem_types[] = { H5T_NATIVE_DOUBLE, H5T_NATIVE_INT, H5T_NATIVE_DOUBLE };
+	const char *names[] = { "float_as_double", "big_endian", "short_as_double" };
+	double *doubles = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*doubles));
+	int *ints = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*ints));
+
+	for (size_t i = 0; i < sizeof(file_types) / sizeof(file_types[0]); i++) {
+		hid_t dataset_id =
+			H5Dcreate2(file_id, names[i], file_types[i], space_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+		if (dataset_id < 0) {
+			log_fatal("Failed to create dataset %s", names[i]);
+			_exit(EXIT_FAILURE);
+		}
+		bool use_ints = H5Tequal(mem_types[i], H5T_NATIVE_INT) > 0;
+		for (int elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++) {
+			ints[elem] = elem % 30000 - 15000;
+			doubles[elem] = ints[elem];
+		}
+		parh5_test_write(dataset_id, mem_types[i], use_ints ? (void *)ints : (void *)doubles);
+		H5Dclose(dataset_id);
+
+		dataset_id = H5Dopen2(file_id, names[i], H5P_DEFAULT);
+		int *values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*values));
+		parh5_test_read(dataset_id, H5T_NATIVE_INT, values);
+		for (int elem = 0; elem < PAR_TEST_ROWS * PAR_TEST_COLS; elem++) {
+			if (values[elem] == ints[elem])
+				continue;
+			log_fatal("Dataset %s element %d = %d whereas it should have been %d", names[i], elem, values[elem],
+				  ints[elem]);
+			_exit(EXIT_FAILURE);
+		}
+		free(values);
+		H5Dclose(dataset_id);
+	}
+	log_info("TEST type conversion SUCCESS!");
+
+	free(doubles);
+	free(ints);
+	H5Sclose(space_id);
+	H5Fclose(file_id);
+}
+
+int main(void)
+{
+	parh5_test_type_conversion();
+	return 0;
+}
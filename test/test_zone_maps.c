@@ -0,0 +1,128 @@
+#include "../src/parallax_vol_connector.h"
+#include <H5VLconnector.h>
+#include <H5public.h>
+#include <hdf5.h>
+#include <log.h>
+#include <stdlib.h>
+#include <unistd.h>
+#define PAR_TEST_FILE_NAME "par_test-zone_maps.h5"
+#define PAR_TEST_DATASET_NAME "zone_maps"
+#define PAR_TEST_ROWS 256
+#define PAR_TEST_COLS 256
+#define PAR_TEST_CHUNK 64
+#define PAR_TEST_TILES_PER_DIM (PAR_TEST_ROWS / PAR_TEST_CHUNK)
+
+static int parh5_test_value(int row, int col)
+{
+	return row * PAR_TEST_COLS + col;
+}
+
+/**
+ * Runs PARH5_QUERY_TILES_OP on the dataset and checks that it lists exactly
+ * the tiles that hold values in [lower, upper].
+ */
+static void parh5_test_query(hid_t dataset_id, int op_type, int lower, int upper)
+{
+	struct parh5_query_tiles_args query = { .lower = lower, .upper = upper };
+	H5VL_optional_args_t args = { .op_type = op_type, .args = &query };
+	if (H5VLdataset_optional_op(dataset_id, &args, H5P_DEFAULT, H5ES_NONE) < 0) {
+		log_fatal("Failed to query the tiles of the dataset");
+		_exit(EXIT_FAILURE);
+	}
+	size_t num_tiles = 0;
+	for (int tile_row = 0; tile_row < PAR_TEST_TILES_PER_DIM; tile_row++) {
+		for (int tile_col = 0; tile_col < PAR_TEST_TILES_PER_DIM; tile_col++) {
+			int min = parh5_test_value(tile_row * PAR_TEST_CHUNK, tile_col * PAR_TEST_CHUNK);
+			int max = parh5_test_value((tile_row + 1) * PAR_TEST_CHUNK - 1, (tile_col + 1) * PAR_TEST_CHUNK - 1);
+			num_tiles += max >= lower && min <= upper;
+		}
+	}
+	if (query.num_tiles != num_tiles) {
+		log_fatal("Query [%d, %d] listed %zu tiles whereas it should have listed %zu", lower, upper,
+			  query.num_tiles, num_tiles);
+		_exit(EXIT_FAILURE);
+	}
+	for (size_t i = 0; i < query.num_tiles; i++) {
+		hsize_t row = query.tile_starts[2 * i];
+		hsize_t col = query.tile_starts[2 * i + 1];
+		int max = parh5_test_value(row + query.tile_dims[0] - 1, col + query.tile_dims[1] - 1);
+		if (max >= lower && parh5_test_value(row, col) <= upper)
+			continue;
+		log_fatal("Query [%d, %d] listed tile (%llu, %llu) that holds no value in range", lower, upper,
+			  (unsigned long long)row, (unsigned long long)col);
+		_exit(EXIT_FAILURE);
+	}
+	free(query.tile_starts);
+}
+
+/**
+ * Creates a dataset with zone maps, writes it whole, and queries value
+ * ranges before and after reopening the file. Values grow along the rows,
+ * so each range holds the values of a band of tiles.
+ */
+static void parh5_test_zone_maps(void)
+{
+	int op_type = 0;
+	if (H5VLfind_opt_operation(H5VL_SUBCLS_DATASET, PARH5_QUERY_TILES_OP, &op_type) < 0) {
+		log_fatal("Operation %s is not registered", PARH5_QUERY_TILES_OP);
+		_exit(EXIT_FAILURE);
+	}
+	hid_t file_id = H5Fcreate(PAR_TEST_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file_id <= 0) {
+		log_fatal("File creation failed");
+		_exit(EXIT_FAILURE);
+	}
+	hsize_t dims[2] = { PAR_TEST_ROWS, PAR_TEST_COLS };
+	hsize_t chunk[2] = { PAR_TEST_CHUNK, PAR_TEST_CHUNK };
+	hid_t space_id = H5Screate_simple(2, dims, NULL);
+	hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(dcpl_id, 2, chunk);
+	unsigned int zone_maps = 1;
+	if (H5Pinsert2(dcpl_id, PARH5_ZONE_MAPS, sizeof(zone_maps), &zone_maps, NULL, NULL, NULL, NULL, NULL, NULL) <
+	    0) {
+		log_fatal("Failed to turn on zone maps");
+		_exit(EXIT_FAILURE);
+	}
+	hid_t dataset_id = H5Dcreate2(file_id, PAR_TEST_DATASET_NAME, H5T_NATIVE_INT, space_id, H5P_DEFAULT, dcpl_id,
+				      H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to create dataset");
+		_exit(EXIT_FAILURE);
+	}
+
+	int *values = calloc(PAR_TEST_ROWS * PAR_TEST_COLS, sizeof(*values));
+	for (int row = 0; row < PAR_TEST_ROWS; row++) {
+		for (int col = 0; col < PAR_TEST_COLS; col++)
+			values[row * PAR_TEST_COLS + col] = parh5_test_value(row, col);
+	}
+	if (H5Dwrite(dataset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values) < 0) {
+		log_fatal("Failed to write dataset");
+		_exit(EXIT_FAILURE);
+	}
+	parh5_test_query(dataset_id, op_type, parh5_test_value(100, 0), parh5_test_value(100, 10));
+	parh5_test_query(dataset_id, op_type, parh5_test_value(200, 0), PAR_TEST_ROWS * PAR_TEST_COLS);
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+
+	file_id = H5Fopen(PAR_TEST_FILE_NAME, H5F_ACC_RDONLY, H5P_DEFAULT);
+	dataset_id = H5Dopen2(file_id, PAR_TEST_DATASET_NAME, H5P_DEFAULT);
+	if (dataset_id < 0) {
+		log_fatal("Failed to open dataset");
+		_exit(EXIT_FAILURE);
+	}
+	parh5_test_query(dataset_id, op_type, parh5_test_value(10, 70), parh5_test_value(130, 0));
+	parh5_test_query(dataset_id, op_type, -10, -1);
+	log_info("TEST zone maps SUCCESS!");
+
+	free(values);
+	H5Pclose(dcpl_id);
+	H5Sclose(space_id);
+	H5Dclose(dataset_id);
+	H5Fclose(file_id);
+}
+
+int main(void)
+{
+	parh5_test_zone_maps();
+	return 0;
+}